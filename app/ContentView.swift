@@ -427,6 +427,9 @@ struct ContentView: View {
             HStack {
               Text(task.name)
               Spacer()
+              Text("\(task.tabCount)")
+                .font(.caption)
+                .foregroundColor(.secondary)
               RoundedRectangle(cornerRadius: 2)
                 .fill(Color.fromName(task.color))
                 .frame(width: 12, height: 12)
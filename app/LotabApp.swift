@@ -137,7 +137,7 @@ class AppDelegate: NSObject, NSApplicationDelegate {
       if !tm.multiSelection.isEmpty { return nil }
       if let selectedId = Lotab.shared.selection {
         if let client = self.udsClient {
-          lotab_client_send_tab_selected(client, Int64(selectedId))
+          lotab_client_send_tab_selected(client, UInt32(selectedId))
         }
         self.hideUI()
         return nil
@@ -220,7 +220,7 @@ class AppDelegate: NSObject, NSApplicationDelegate {
         let taskId = tm.tasks[selection - 1].id
         let idsToAssoc = Array(tm.multiSelection)
         if !idsToAssoc.isEmpty, let client = self.udsClient {
-          let cIds = idsToAssoc.map { Int64($0) }
+          let cIds = idsToAssoc.map { UInt32($0) }
           cIds.withUnsafeBufferPointer { buffer in
             lotab_client_send_associate_tabs(
               client, buffer.baseAddress, Int(buffer.count), Int64(taskId))
@@ -238,7 +238,7 @@ class AppDelegate: NSObject, NSApplicationDelegate {
       if !name.isEmpty, let client = self.udsClient {
         name.withCString { taskNamePtr in
           if !idsToAssoc.isEmpty {
-            let cIds = idsToAssoc.map { Int64($0) }
+            let cIds = idsToAssoc.map { UInt32($0) }
             cIds.withUnsafeBufferPointer { buffer in
               lotab_client_send_create_task_and_associate(
                 client, taskNamePtr, buffer.baseAddress, Int(buffer.count))
@@ -340,7 +340,7 @@ class AppDelegate: NSObject, NSApplicationDelegate {
           let title = String(cString: cTab.title)
           newTabs.append(
             BrowserTab(
-              id: Int(cTab.id), title: title, active: cTab.active,
+              id: Int(cTab.handle), tabId: Int(cTab.id), title: title, active: cTab.active,
               taskId: Int(cTab.task_id)))
         }
       }
@@ -377,7 +377,8 @@ class AppDelegate: NSObject, NSApplicationDelegate {
           let cTask = buffer[i]
           let name = String(cString: cTask.name)
           let color = String(cString: cTask.color)
-          newTasks.append(Task(id: Int(cTask.id), name: name, color: color))
+          newTasks.append(
+            Task(id: Int(cTask.id), name: name, color: color, tabCount: Int(cTask.tab_count)))
         }
       }
 
@@ -423,7 +424,9 @@ class AppDelegate: NSObject, NSApplicationDelegate {
 }
 
 struct BrowserTab: Identifiable, Hashable {
+  // The daemon's handle for the tab; what commands to the daemon name it by.
   let id: Int
+  let tabId: Int
   let title: String
   let active: Bool
   let taskId: Int
@@ -433,6 +436,7 @@ struct Task: Identifiable, Hashable {
   let id: Int
   let name: String
   let color: String
+  let tabCount: Int
 }
 
 class Lotab: ObservableObject {
@@ -542,7 +546,7 @@ class Lotab: ObservableObject {
     if !idsToClose.isEmpty {
       // Use C client to send close_tabs
       if let client = udsClient {
-        let cIds = idsToClose.map { Int64($0) }
+        let cIds = idsToClose.map { UInt32($0) }
         cIds.withUnsafeBufferPointer { buffer in
           lotab_client_send_close_tabs(
             client, buffer.baseAddress, Int(buffer.count))
@@ -557,7 +561,8 @@ class Lotab: ObservableObject {
     guard let path = self.manifestPath else { return }
     let tabsData = self.tabs.map {
       [
-        "id": $0.id,
+        "id": $0.tabId,
+        "handle": $0.id,
         "title": $0.title,
         "active": $0.active,
         "taskId": $0.taskId,
@@ -569,6 +574,7 @@ class Lotab: ObservableObject {
         "id": $0.id,
         "name": $0.name,
         "color": $0.color,
+        "tabCount": $0.tabCount,
       ] as [String: Any]
     }
 
@@ -0,0 +1,121 @@
+#include "arena.h"
+
+#include <stdlib.h>
+
+// Size of the first chunk, and the smallest one kept across resets.
+#define ARENA_CHUNK_MIN (64 * 1024)
+// Largest chunk kept across resets; a message needing more pays for its chunks again every time.
+#define ARENA_KEEP_MAX (4 * 1024 * 1024)
+// What malloc() guarantees, and cJSON (doubles, pointers) relies on.
+#define ARENA_ALIGN 16
+
+struct ArenaChunk {
+  ArenaChunk* prev;
+  size_t cap;
+  size_t used;
+};
+
+// Chunk headers are padded so that the data after them starts aligned.
+#define ARENA_HEADER ((sizeof(ArenaChunk) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+static _Thread_local Arena* arena_current;
+
+static char* arena_chunk_data(const ArenaChunk* c) {
+  return (char*)c + ARENA_HEADER;
+}
+
+static ArenaChunk* arena_chunk_push(Arena* a, size_t cap) {
+  ArenaChunk* c = malloc(ARENA_HEADER + cap);
+  if (!c)
+    return NULL;
+  c->prev = a->head;
+  c->cap = cap;
+  c->used = 0;
+  a->head = c;
+  a->nb_chunk_allocs++;
+  return c;
+}
+
+static void arena_free_chunks(Arena* a) {
+  while (a->head) {
+    ArenaChunk* prev = a->head->prev;
+    free(a->head);
+    a->head = prev;
+  }
+}
+
+void* arena_alloc(Arena* a, size_t size) {
+  if (size > SIZE_MAX / 2)
+    return NULL;
+  // Zero-byte requests still get a pointer of their own, as from malloc().
+  size = size ? (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1) : ARENA_ALIGN;
+  ArenaChunk* c = a->head;
+  if (!c || c->cap - c->used < size) {
+    size_t cap = c ? c->cap * 2 : ARENA_CHUNK_MIN;
+    while (cap < size)
+      cap *= 2;
+    c = arena_chunk_push(a, cap);
+    if (!c)
+      return NULL;
+  }
+  void* p = arena_chunk_data(c) + c->used;
+  c->used += size;
+  a->in_use += size;
+  if (a->in_use > a->peak)
+    a->peak = a->in_use;
+  return p;
+}
+
+int arena_owns(const Arena* a, const void* p) {
+  uintptr_t addr = (uintptr_t)p;
+  for (const ArenaChunk* c = a->head; c; c = c->prev) {
+    uintptr_t data = (uintptr_t)arena_chunk_data(c);
+    if (addr >= data && addr < data + c->cap)
+      return 1;
+  }
+  return 0;
+}
+
+void arena_reset(Arena* a) {
+  // One chunk that fits the largest message so far (allocations in a single chunk pack without gaps).
+  size_t keep = ARENA_CHUNK_MIN;
+  while (keep < a->peak && keep < ARENA_KEEP_MAX)
+    keep *= 2;
+  if (a->head && (a->head->prev || a->head->cap != keep)) {
+    arena_free_chunks(a);
+    arena_chunk_push(a, keep);
+  } else if (a->head) {
+    a->head->used = 0;
+  }
+  a->in_use = 0;
+}
+
+void arena_destroy(Arena* a) {
+  arena_free_chunks(a);
+  a->in_use = 0;
+  a->peak = 0;
+}
+
+void arena_enter(Arena* a) {
+  if (a->depth++ == 0)
+    arena_current = a;
+}
+
+void arena_leave(Arena* a) {
+  if (--a->depth == 0) {
+    arena_current = NULL;
+    arena_reset(a);
+  }
+}
+
+void* arena_malloc(size_t size) {
+  Arena* a = arena_current;
+  return a ? arena_alloc(a, size) : malloc(size);
+}
+
+void arena_free(void* p) {
+  Arena* a = arena_current;
+  if (a && arena_owns(a, p))
+    return;
+  free(p);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#ifndef DAEMON_ARENA_H_
+#define DAEMON_ARENA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bump-pointer allocator for memory that lives exactly as long as one message: everything is released
+// at once when the message is done. A zeroed Arena is ready to use.
+//
+// Handling a message:
+//
+//   arena_enter(&sc->ws_arena);
+//   ... cJSON_Parse(), handlers, cJSON_PrintUnformatted() ...
+//   arena_leave(&sc->ws_arena);  // Resets the arena.
+//
+// While a thread is inside arena_enter()/arena_leave(), arena_malloc() (and so cJSON, whose hooks the
+// engine points at arena_malloc()/arena_free()) allocates from that thread's arena. Nothing allocated
+// there may outlive the message: copy it out with the system allocator first.
+typedef struct ArenaChunk ArenaChunk;
+
+typedef struct Arena {
+  ArenaChunk* head;  // Chunk being bumped; older chunks of the same message are chained behind it.
+  size_t in_use;     // Bytes handed out since the last reset, over all chunks.
+  size_t peak;       // Largest `in_use` seen, which sizes the chunk kept across resets.
+  int depth;         // arena_enter() nesting.
+  uint64_t nb_chunk_allocs;  // Trips to the system allocator, for tests and benchmarks.
+} Arena;
+
+// @returns `size` bytes aligned for any type, or NULL if the system is out of memory.
+void* arena_alloc(Arena* a, size_t size);
+// @returns whether `p` points into one of `a`'s chunks.
+int arena_owns(const Arena* a, const void* p);
+// Releases everything allocated since the last reset. Keeps one chunk large enough for the biggest
+// message so far (up to a cap), so that steady-state traffic never reaches the system allocator.
+void arena_reset(Arena* a);
+// Frees all chunks; the arena is empty and usable again afterwards.
+void arena_destroy(Arena* a);
+
+// Makes `a` the calling thread's message arena. Nests: only the outermost arena_leave() resets.
+void arena_enter(Arena* a);
+void arena_leave(Arena* a);
+
+// malloc()/free() for message-scoped data: the calling thread's arena if it is inside arena_enter(),
+// the system allocator otherwise. arena_free() hands pointers it does not own to free(), so data
+// allocated outside a message may be released inside one.
+void* arena_malloc(size_t size);
+void arena_free(void* p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // DAEMON_ARENA_H_
@@ -1,16 +1,20 @@
 #include "client.h"
 #include <stdatomic.h>
+#include "client_events.h"
+#include "jscan.h"
+#include "jwrite.h"
 #include "util.h"
 
 #include <assert.h>
-#include <cJSON.h>
 #include <ctype.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <unistd.h>
 
@@ -24,12 +28,23 @@ struct ClientContext {
   int server_fd;
   int active_client_fd;
   atomic_bool should_stop;
+  // The engine's lists as of its last push, which TabsDelta/TasksDelta apply to. A version of 0 means
+  // there is no list to apply to until the next full push.
+  LotabTabList tabs;
+  LotabTaskList tasks;
+  uint64_t tabs_version;
+  uint64_t tasks_version;
+  bool snapshot_requested;  // Since the last full push.
+  // Outbound messages are written here, frame header first, and sent from it. The GUI sends from its own
+  // thread while the run loop asks for snapshots, so both are under send_mutex.
+  pthread_mutex_t send_mutex;
+  JWrite out;
 };
 
 static struct EngClass CLIENT_CLS = {.name = "uds_client"};
 
 ClientContext* lotab_client_new(const char* socket_path, ClientCallbacks callbacks, void* user_data) {
-  ClientContext* ctx = (ClientContext*)malloc(sizeof(ClientContext));
+  ClientContext* ctx = (ClientContext*)calloc(1, sizeof(ClientContext));
   if (!ctx)
     return NULL;
 
@@ -41,15 +56,24 @@ ClientContext* lotab_client_new(const char* socket_path, ClientCallbacks callbac
   ctx->active_client_fd = -1;
   atomic_init(&ctx->should_stop, false);
   ctx->cls = &CLIENT_CLS;
+  pthread_mutex_init(&ctx->send_mutex, NULL);
+  jwrite_init(&ctx->out, JWRITE_FRAME_HEAD);
 
   return ctx;
 }
 
+static void free_tab_list(LotabTabList* list);
+static void free_task_list(LotabTaskList* list);
+static JWrite* send_begin(ClientContext* ctx, const char* event);
+static void send_end(ClientContext* ctx);
+
 void lotab_client_destroy(ClientContext* ctx) {
   if (!ctx)
     return;
 
   lotab_client_stop(ctx);
+  free_tab_list(&ctx->tabs);
+  free_task_list(&ctx->tasks);
 
   if (ctx->active_client_fd >= 0) {
     close(ctx->active_client_fd);
@@ -61,6 +85,8 @@ void lotab_client_destroy(ClientContext* ctx) {
     unlink(ctx->socket_path);
     free(ctx->socket_path);
   }
+  jwrite_free(&ctx->out);
+  pthread_mutex_destroy(&ctx->send_mutex);
   free(ctx);
 }
 
@@ -108,85 +134,464 @@ static void free_task_list(LotabTaskList* list) {
   free(list->tasks);
 }
 
-void lotab_client_process_message(ClientContext* ctx, const char* json_str) {
-  cJSON* json = cJSON_Parse(json_str);
-  if (!json) {
-    vlog(LOG_LEVEL_ERROR, ctx, "Failed to parse JSON message: %s\n", json_str);
-    return;
+// Copies a string value out with the system allocator, or `fallback` if the value is not a string.
+static char* scan_strdup(JScan* js, const char* fallback) {
+  JScanStr s;
+  if (jscan_peek(js) != JSCAN_STRING) {
+    jscan_skip(js);
+    return strdup(fallback);
   }
+  char* out = jscan_string(js, &s) ? malloc(s.len + 1) : NULL;
+  if (out)
+    jscan_unescape(&s, out, s.len + 1);
+  return out;
+}
 
-  cJSON* event = cJSON_GetObjectItemCaseSensitive(json, "event");
-  if (!cJSON_IsString(event) || !event->valuestring) {
-    cJSON_Delete(json);
-    return;
-  }
+// Reads an integer value exactly; anything else is skipped and leaves `out` alone.
+static void scan_int64(JScan* js, int64_t* out) {
+  if (jscan_peek(js) == JSCAN_NUMBER)
+    jscan_int64(js, out);
+  else
+    jscan_skip(js);
+}
 
-  vlog(LOG_LEVEL_TRACE, ctx, "uds-event: %s\n", event->valuestring);
-
-  if (strcmp(event->valuestring, "Daemon::UDS::TabsUpdate") == 0) {
-    // Parse tabs
-    cJSON* data = cJSON_GetObjectItem(json, "data");
-    cJSON* tabs_json = cJSON_GetObjectItem(data, "tabs");
-
-    if (cJSON_IsArray(tabs_json)) {
-      int count = cJSON_GetArraySize(tabs_json);
-      LotabTabList list = {0};
-      list.count = (size_t)count;
-      list.tabs = calloc(list.count, sizeof(LotabTab));
-
-      for (int i = 0; i < count; i++) {
-        cJSON* item = cJSON_GetArrayItem(tabs_json, i);
-        cJSON* id = cJSON_GetObjectItem(item, "id");
-        cJSON* title = cJSON_GetObjectItem(item, "title");
-        cJSON* active = cJSON_GetObjectItem(item, "active");
-        cJSON* task_id = cJSON_GetObjectItem(item, "task_id");
-
-        list.tabs[i].id = cJSON_IsNumber(id) ? (int64_t)id->valuedouble : 0;
-        list.tabs[i].title = (cJSON_IsString(title) && title->valuestring) ? strdup(title->valuestring) : strdup("");
-        list.tabs[i].active = cJSON_IsBool(active) ? cJSON_IsTrue(active) : false;
-        list.tabs[i].task_id = cJSON_IsNumber(task_id) ? (int64_t)task_id->valuedouble : -1;
+// Counts the elements of the array under the scanner without consuming it.
+static size_t scan_array_count(const JScan* js) {
+  JScan counter = *js;
+  size_t count = 0;
+  if (!jscan_array_begin(&counter))
+    return 0;
+  while (jscan_array_next(&counter) && jscan_skip(&counter))
+    ++count;
+  return counter.error ? 0 : count;
+}
+
+// A record of a delta and the key of the record it follows, if any.
+typedef struct DeltaLink {
+  int has_after;
+  int64_t after;
+} DeltaLink;
+
+// Reads a record's "after" into `link`, if there is one to fill.
+static void scan_link(JScan* js, DeltaLink* link) {
+  if (link && jscan_peek(js) == JSCAN_NUMBER && jscan_int64(js, &link->after))
+    link->has_after = 1;
+  else
+    jscan_skip(js);
+}
+
+static void scan_tab(JScan* js, LotabTab* tab, DeltaLink* link) {
+  JScanStr key;
+  int64_t handle = -1;
+  tab->task_id = -1;
+  if (jscan_peek(js) != JSCAN_OBJECT) {
+    jscan_skip(js);
+  } else {
+    jscan_object_begin(js);
+    while (jscan_object_next(js, &key)) {
+      if (jscan_key_is(&key, "h")) {
+        scan_int64(js, &handle);
+      } else if (jscan_key_is(&key, "id")) {
+        scan_int64(js, &tab->id);
+      } else if (jscan_key_is(&key, "title") && !tab->title) {
+        tab->title = scan_strdup(js, "");
+      } else if (jscan_key_is(&key, "active")) {
+        tab->active = jscan_peek(js) == JSCAN_TRUE;
+        jscan_skip(js);
+      } else if (jscan_key_is(&key, "task_id")) {
+        scan_int64(js, &tab->task_id);
+      } else if (jscan_key_is(&key, "after")) {
+        scan_link(js, link);
+      } else {
+        jscan_skip(js);
       }
+    }
+  }
+  tab->handle = handle >= 0 && handle < UINT32_MAX ? (uint32_t)handle : UINT32_MAX;
+  if (!tab->title)
+    tab->title = strdup("");
+}
 
-      if (ctx->callbacks.on_tabs_update) {
-        ctx->callbacks.on_tabs_update(ctx->user_data, &list);
+static void scan_task(JScan* js, LotabTask* task, DeltaLink* link) {
+  JScanStr key;
+  if (jscan_peek(js) != JSCAN_OBJECT) {
+    jscan_skip(js);
+  } else {
+    jscan_object_begin(js);
+    while (jscan_object_next(js, &key)) {
+      if (jscan_key_is(&key, "id")) {
+        scan_int64(js, &task->id);
+      } else if (jscan_key_is(&key, "name") && !task->name) {
+        task->name = scan_strdup(js, "");
+      } else if (jscan_key_is(&key, "color") && !task->color) {
+        task->color = scan_strdup(js, "grey");
+      } else if (jscan_key_is(&key, "tab_count")) {
+        scan_int64(js, &task->tab_count);
+      } else if (jscan_key_is(&key, "after")) {
+        scan_link(js, link);
       } else {
-        vlog(LOG_LEVEL_WARN, ctx, "on_tabs_update callback is NULL\n");
+        jscan_skip(js);
       }
+    }
+  }
+  if (!task->name)
+    task->name = strdup("");
+  if (!task->color)
+    task->color = strdup("grey");
+}
 
-      free_tab_list(&list);
+// A full list push (TabsUpdate/TasksUpdate) or a delta on top of one (TabsDelta/TasksDelta), located in
+// the message's "data".
+typedef struct ListPush {
+  int64_t base;  // Version the delta applies to; 0 for a full list.
+  int64_t version;
+  JScan list;     // On the "tabs"/"tasks" array.
+  JScan removed;  // On the "removed" array.
+  int has_list;
+  int has_removed;
+} ListPush;
+
+static void scan_push(JScan* js, const char* list_key, ListPush* push) {
+  JScanStr key;
+  memset(push, 0, sizeof(*push));
+  if (jscan_peek(js) != JSCAN_OBJECT)
+    return;
+  jscan_object_begin(js);
+  while (jscan_object_next(js, &key)) {
+    if (jscan_key_is(&key, "base")) {
+      scan_int64(js, &push->base);
+    } else if (jscan_key_is(&key, "version")) {
+      scan_int64(js, &push->version);
+    } else if (jscan_key_is(&key, list_key) && jscan_peek(js) == JSCAN_ARRAY && !push->has_list) {
+      push->list = *js;
+      push->has_list = 1;
+      jscan_skip(js);
+    } else if (jscan_key_is(&key, "removed") && jscan_peek(js) == JSCAN_ARRAY && !push->has_removed) {
+      push->removed = *js;
+      push->has_removed = 1;
+      jscan_skip(js);
+    } else {
+      jscan_skip(js);
     }
-  } else if (strcmp(event->valuestring, "Daemon::UDS::TasksUpdate") == 0) {
-    // Parse tasks
-    cJSON* data = cJSON_GetObjectItem(json, "data");
-    cJSON* tasks_json = cJSON_GetObjectItem(data, "tasks");
-
-    if (cJSON_IsArray(tasks_json)) {
-      int count = cJSON_GetArraySize(tasks_json);
-      LotabTaskList list = {0};
-      list.count = (size_t)count;
-      list.tasks = calloc(list.count, sizeof(LotabTask));
-
-      for (int i = 0; i < count; i++) {
-        cJSON* item = cJSON_GetArrayItem(tasks_json, i);
-        cJSON* id = cJSON_GetObjectItem(item, "id");
-        cJSON* name = cJSON_GetObjectItem(item, "name");
-        cJSON* color = cJSON_GetObjectItem(item, "color");
-
-        list.tasks[i].id = cJSON_IsNumber(id) ? (int64_t)id->valuedouble : 0;
-        list.tasks[i].name = (cJSON_IsString(name) && name->valuestring) ? strdup(name->valuestring) : strdup("");
-        list.tasks[i].color =
-            (cJSON_IsString(color) && color->valuestring) ? strdup(color->valuestring) : strdup("grey");
-      }
+  }
+}
+
+// Reads the integers of the array under the scanner into a new array. @returns NULL on OOM or if empty.
+static int64_t* scan_int64_array(JScan* js, size_t* out_count) {
+  size_t count = scan_array_count(js);
+  int64_t* values = count ? malloc(count * sizeof(*values)) : NULL;
+  size_t i = 0;
+  if (values && jscan_array_begin(js)) {
+    while (jscan_array_next(js) && i < count) {
+      values[i] = INT64_MIN;
+      scan_int64(js, &values[i++]);
+    }
+  }
+  *out_count = values ? i : 0;
+  return values;
+}
 
-      if (ctx->callbacks.on_tasks_update) {
-        ctx->callbacks.on_tasks_update(ctx->user_data, &list);
+// Open-addressing map from record keys (tab handles, task ids) to 1-based indexes, sized for one delta.
+typedef struct KeyMap {
+  int64_t* keys;
+  uint32_t* vals;  // 0 marks an empty bucket.
+  uint32_t mask;
+} KeyMap;
+
+static int key_map_init(KeyMap* m, size_t nb_keys) {
+  uint32_t cap = 8;
+  while (cap < 2 * nb_keys)
+    cap *= 2;
+  m->keys = malloc(cap * sizeof(*m->keys));
+  m->vals = calloc(cap, sizeof(*m->vals));
+  m->mask = cap - 1;
+  return m->keys && m->vals;
+}
+
+static void key_map_free(KeyMap* m) {
+  free(m->keys);
+  free(m->vals);
+}
+
+static uint32_t key_map_probe(const KeyMap* m, int64_t key) {
+  uint64_t h = (uint64_t)key * 0x9e3779b97f4a7c15ULL;
+  uint32_t i = (uint32_t)(h >> 32) & m->mask;
+  while (m->vals[i] && m->keys[i] != key)
+    i = (i + 1) & m->mask;
+  return i;
+}
+
+static void key_map_put(KeyMap* m, int64_t key, uint32_t val) {
+  uint32_t i = key_map_probe(m, key);
+  m->keys[i] = key;
+  m->vals[i] = val;
+}
+
+static uint32_t key_map_get(const KeyMap* m, int64_t key) {
+  return m->vals[key_map_probe(m, key)];
+}
+
+// How take_list_push() and list_apply_delta() handle one record type.
+typedef struct ListOps {
+  size_t size;
+  void (*scan)(JScan* js, void* item, DeltaLink* link);
+  int64_t (*key)(const void* item);
+  void (*release)(void* item);
+} ListOps;
+
+#define KEY_MAP_REMOVED UINT32_MAX
+
+// The list list_apply_delta() is building.
+typedef struct ListMerge {
+  const ListOps* ops;
+  char* out;
+  size_t count;
+  const char* upserts;
+  uint8_t* placed;
+  size_t nb_placed;
+  KeyMap followers;  // Key of a record -> 1-based index of the upsert that follows it.
+} ListMerge;
+
+// Appends the upsert `next` (1-based; 0 for none), then the one that follows it, and so on.
+static void list_place_chain(ListMerge* lm, uint32_t next) {
+  while (next && !lm->placed[next - 1]) {
+    const char* item = lm->upserts + (next - 1) * lm->ops->size;
+    memcpy(lm->out + lm->count++ * lm->ops->size, item, lm->ops->size);
+    lm->placed[next - 1] = 1;
+    lm->nb_placed++;
+    next = key_map_get(&lm->followers, lm->ops->key(item));
+  }
+}
+
+// Applies a delta to `*items`: drops the `removed` keys, then puts each of the `upserts` right after the
+// record its link names (at the front if none), replacing the record with its key if there is one.
+// Records the delta does not name keep their order. Takes ownership of `upserts` on success.
+// @returns 0, leaving `*items` as it was, if the delta does not fit the list (say, a record follows one
+// the list does not have), which means the list missed a push.
+static int list_apply_delta(const ListOps* ops,
+                            void** items,
+                            size_t* count,
+                            const void* upserts,
+                            const DeltaLink* links,
+                            size_t nb_upserts,
+                            const int64_t* removed,
+                            size_t nb_removed) {
+  char* old_items = *items;
+  ListMerge lm = {.ops = ops, .upserts = upserts};
+  KeyMap changed = {0};
+  lm.out = malloc((*count + nb_upserts) * ops->size + 1);
+  lm.placed = calloc(nb_upserts + 1, 1);
+  int ok = lm.out && lm.placed && key_map_init(&changed, nb_upserts + nb_removed) &&
+           key_map_init(&lm.followers, nb_upserts);
+  uint32_t front = 0;
+  for (size_t i = 0; ok && i < nb_removed; ++i)
+    key_map_put(&changed, removed[i], KEY_MAP_REMOVED);
+  for (size_t i = 0; ok && i < nb_upserts; ++i) {
+    key_map_put(&changed, ops->key(lm.upserts + i * ops->size), (uint32_t)i + 1);
+    // Each record is followed by at most one other.
+    if (!links[i].has_after) {
+      ok = !front;
+      front = (uint32_t)i + 1;
+    } else if (key_map_get(&lm.followers, links[i].after)) {
+      ok = 0;
+    } else {
+      key_map_put(&lm.followers, links[i].after, (uint32_t)i + 1);
+    }
+  }
+
+  if (ok) {
+    list_place_chain(&lm, front);
+    for (size_t i = 0; i < *count; ++i) {
+      const char* item = old_items + i * ops->size;
+      int64_t key = ops->key(item);
+      if (key_map_get(&changed, key))
+        continue;
+      memcpy(lm.out + lm.count++ * ops->size, item, ops->size);
+      list_place_chain(&lm, key_map_get(&lm.followers, key));
+    }
+    ok = lm.nb_placed == nb_upserts;
+  }
+
+  if (ok) {
+    for (size_t i = 0; i < *count; ++i) {
+      char* item = old_items + i * ops->size;
+      if (key_map_get(&changed, ops->key(item)))
+        ops->release(item);
+    }
+    free(old_items);
+    *items = lm.out;
+    *count = lm.count;
+  } else {
+    free(lm.out);
+  }
+  free(lm.placed);
+  key_map_free(&changed);
+  key_map_free(&lm.followers);
+  return ok;
+}
+
+static void tab_scan(JScan* js, void* item, DeltaLink* link) {
+  scan_tab(js, item, link);
+}
+
+static int64_t tab_key(const void* item) {
+  return ((const LotabTab*)item)->handle;
+}
+
+static void tab_release(void* item) {
+  free(((LotabTab*)item)->title);
+}
+
+static void task_scan(JScan* js, void* item, DeltaLink* link) {
+  scan_task(js, item, link);
+}
+
+static int64_t task_key(const void* item) {
+  return ((const LotabTask*)item)->id;
+}
+
+static void task_release(void* item) {
+  LotabTask* task = item;
+  free(task->name);
+  free(task->color);
+}
+
+static const ListOps TAB_LIST_OPS = {
+    .size = sizeof(LotabTab), .scan = tab_scan, .key = tab_key, .release = tab_release};
+static const ListOps TASK_LIST_OPS = {
+    .size = sizeof(LotabTask), .scan = task_scan, .key = task_key, .release = task_release};
+
+static void list_release(const ListOps* ops, void* items, size_t count) {
+  for (size_t i = 0; i < count; ++i)
+    ops->release((char*)items + i * ops->size);
+  free(items);
+}
+
+// Asks the engine to start over with full pushes, once per gap.
+static void request_snapshot(ClientContext* ctx) {
+  if (ctx->snapshot_requested)
+    return;
+  vlog(LOG_LEVEL_WARN, ctx, "Missed an update from the engine, asking for a snapshot\n");
+  ctx->snapshot_requested = true;
+  send_begin(ctx, "GUI::UDS::SnapshotRequest");
+  send_end(ctx);
+}
+
+// Takes in a full push or delta of one of the client's lists (`*items`, `*count`, at push `*version`).
+// A delta that does not apply on top of the list drops it and asks for a snapshot.
+// @returns 1 if the list was updated, for the caller to hand it to its callback.
+static int take_list_push(ClientContext* ctx,
+                          const ListOps* ops,
+                          void** items,
+                          size_t* count,
+                          uint64_t* version,
+                          const ListPush* push,
+                          int delta) {
+  if (!push->has_list)
+    return 0;
+  JScan js = push->list;
+  size_t nb_items = scan_array_count(&js);
+  char* list = calloc(nb_items + 1, ops->size);
+  DeltaLink* links = delta ? calloc(nb_items + 1, sizeof(DeltaLink)) : NULL;
+  if (!list || (delta && !links)) {
+    free(list);
+    free(links);
+    return 0;
+  }
+  size_t n = 0;
+  jscan_array_begin(&js);
+  while (jscan_array_next(&js) && n < nb_items) {
+    ops->scan(&js, list + n * ops->size, links ? &links[n] : NULL);
+    n++;
+  }
+
+  if (!delta) {
+    list_release(ops, *items, *count);
+    *items = list;
+    *count = n;
+    *version = (uint64_t)push->version;
+    ctx->snapshot_requested = false;
+    return 1;
+  }
+  size_t nb_removed = 0;
+  JScan removed_js = push->removed;
+  int64_t* removed = push->has_removed ? scan_int64_array(&removed_js, &nb_removed) : NULL;
+  int applied = *version != 0 && (uint64_t)push->base == *version &&
+                list_apply_delta(ops, items, count, list, links, n, removed, nb_removed);
+  free(removed);
+  free(links);
+  if (!applied) {
+    list_release(ops, list, n);
+    *version = 0;
+    request_snapshot(ctx);
+    return 0;
+  }
+  free(list);  // The records now belong to `*items`.
+  *version = (uint64_t)push->version;
+  return 1;
+}
+
+// Messages are decoded straight from their text with jscan, so that ids and handles are read exactly
+// rather than through doubles.
+void lotab_client_process_message(ClientContext* ctx, const char* json_str) {
+  size_t len = strlen(json_str);
+  JScan js;
+  JScanStr key, event_str;
+  char event[64] = "";
+  const char* data = NULL;
+  int seen_event = 0;
+
+  jscan_init(&js, json_str, len);
+  if (jscan_object_begin(&js)) {
+    while (jscan_object_next(&js, &key)) {
+      if (jscan_key_is(&key, "event") && !seen_event) {
+        seen_event = 1;
+        if (jscan_peek(&js) == JSCAN_STRING && jscan_string(&js, &event_str) && event_str.len < sizeof(event))
+          jscan_unescape(&event_str, event, sizeof(event));
+        else
+          jscan_skip(&js);
       } else {
-        vlog(LOG_LEVEL_WARN, ctx, "on_tasks_update callback is NULL\n");
+        if (jscan_key_is(&key, "data") && !data)
+          data = js.p;
+        jscan_skip(&js);
       }
+    }
+  }
+  jscan_peek(&js);
+  if (js.error || js.p != js.end) {
+    vlog(LOG_LEVEL_ERROR, ctx, "Failed to parse JSON message: %s\n", json_str);
+    return;
+  }
+  if (!event[0])
+    return;
 
-      free_task_list(&list);
+  vlog(LOG_LEVEL_TRACE, ctx, "uds-event: %s\n", event);
+
+  // `data` was already walked once, so scanning it again cannot fail.
+  jscan_init(&js, data ? data : "", data ? (size_t)(json_str + len - data) : 0);
+  ClientEventType type = client_event_lookup(event);
+  ListPush push;
+  if (type == CLIENT_EVENT_TABS_UPDATE || type == CLIENT_EVENT_TABS_DELTA) {
+    scan_push(&js, "tabs", &push);
+    if (!take_list_push(ctx, &TAB_LIST_OPS, (void**)&ctx->tabs.tabs, &ctx->tabs.count, &ctx->tabs_version, &push,
+                        type == CLIENT_EVENT_TABS_DELTA))
+      return;
+    if (ctx->callbacks.on_tabs_update) {
+      ctx->callbacks.on_tabs_update(ctx->user_data, &ctx->tabs);
+    } else {
+      vlog(LOG_LEVEL_WARN, ctx, "on_tabs_update callback is NULL\n");
+    }
+  } else if (type == CLIENT_EVENT_TASKS_UPDATE || type == CLIENT_EVENT_TASKS_DELTA) {
+    scan_push(&js, "tasks", &push);
+    if (!take_list_push(ctx, &TASK_LIST_OPS, (void**)&ctx->tasks.tasks, &ctx->tasks.count, &ctx->tasks_version,
+                        &push, type == CLIENT_EVENT_TASKS_DELTA))
+      return;
+    if (ctx->callbacks.on_tasks_update) {
+      ctx->callbacks.on_tasks_update(ctx->user_data, &ctx->tasks);
+    } else {
+      vlog(LOG_LEVEL_WARN, ctx, "on_tasks_update callback is NULL\n");
     }
-  } else if (strcmp(event->valuestring, "Daemon::UDS::ToggleGuiRequest") == 0) {
+  } else if (type == CLIENT_EVENT_TOGGLE_GUI) {
     vlog(LOG_LEVEL_INFO, ctx, "Processing Daemon::UDS::ToggleGuiRequest\n");
     if (ctx->callbacks.on_ui_toggle) {
       ctx->callbacks.on_ui_toggle(ctx->user_data);
@@ -194,10 +599,8 @@ void lotab_client_process_message(ClientContext* ctx, const char* json_str) {
       vlog(LOG_LEVEL_WARN, ctx, "on_ui_toggle callback is NULL\n");
     }
   } else {
-    vlog(LOG_LEVEL_INFO, ctx, "Unknown UDS event: %s\n", event->valuestring);
+    vlog(LOG_LEVEL_INFO, ctx, "Unknown UDS event: %s\n", event);
   }
-
-  cJSON_Delete(json);
 }
 
 static void handle_client(ClientContext* ctx, int client_socket) {
@@ -312,71 +715,68 @@ void lotab_client_run_loop(ClientContext* ctx) {
   }
 }
 
-// Helpers for sending
-static void send_json_message(ClientContext* ctx, cJSON* json) {
+// Helpers for sending. A message is written between send_begin(), which starts its object with the
+// event name, and send_end(), which closes and sends it.
+static JWrite* send_begin(ClientContext* ctx, const char* event) {
+  pthread_mutex_lock(&ctx->send_mutex);
+  JWrite* w = &ctx->out;
+  jwrite_reset(w);
+  jwrite_object_begin(w);
+  jwrite_member_string(w, "event", event);
+  return w;
+}
+
+static void send_end(ClientContext* ctx) {
+  JWrite* w = &ctx->out;
+  jwrite_object_end(w);
+  size_t frame_len;
+  const char* frame = jwrite_frame(w, &frame_len);
   if (ctx->active_client_fd < 0) {
     vlog(LOG_LEVEL_WARN, ctx, "Cannot send message: no active client\n");
-    return;
-  }
-
-  char* json_str = cJSON_PrintUnformatted(json);
-  if (!json_str)
-    return;
-
-  size_t len = strlen(json_str);
-  size_t frame_len = sizeof(uint32_t) + len;
-  char* msg = malloc(frame_len);
-  if (msg) {
-    uint32_t header = (uint32_t)len;
-    memcpy(msg, &header, sizeof(uint32_t));
-    memcpy(msg + sizeof(uint32_t), json_str, len);
-
-    ssize_t sent = send(ctx->active_client_fd, msg, frame_len, 0);
-    if (sent < 0) {
+  } else if (!frame) {
+    vlog(LOG_LEVEL_ERROR, ctx, "Failed to write message: out of memory\n");
+  } else {
+    struct iovec iov = {.iov_base = (void*)frame, .iov_len = frame_len};
+    if (writev_all(ctx->active_client_fd, &iov, 1) < 0) {
       vlog(LOG_LEVEL_ERROR, ctx, "Failed to send message: %s\n", strerror(errno));
     } else {
-      vlog(LOG_LEVEL_TRACE, ctx, "Sent message: %s\n", json_str);
+      vlog(LOG_LEVEL_TRACE, ctx, "Sent message: %s\n", frame + JWRITE_FRAME_HEAD);
     }
-    free(msg);
   }
-  free(json_str);
+  pthread_mutex_unlock(&ctx->send_mutex);
 }
 
-void lotab_client_send_close_tabs(ClientContext* ctx, const int64_t* tab_ids, size_t count) {
-  if (!ctx || count == 0)
-    return;
-
-  cJSON* root = cJSON_CreateObject();
-  cJSON_AddStringToObject(root, "event", "GUI::UDS::CloseTabsRequest");
-
-  cJSON* data = cJSON_CreateObject();
-  cJSON_AddItemToObject(root, "data", data);
-
-  cJSON* ids = cJSON_CreateArray();
-  cJSON_AddItemToObject(data, "tabIds", ids);
-
+static void write_handle_array(JWrite* w, const char* key, const uint32_t* tab_handles, size_t count) {
+  jwrite_key(w, key);
+  jwrite_array_begin(w);
   for (size_t i = 0; i < count; i++) {
-    cJSON_AddItemToArray(ids, cJSON_CreateNumber((double)tab_ids[i]));
+    jwrite_int64(w, tab_handles[i]);
   }
-
-  send_json_message(ctx, root);
-  cJSON_Delete(root);
+  jwrite_array_end(w);
 }
 
-void lotab_client_send_tab_selected(ClientContext* ctx, int64_t tab_id) {
-  if (!ctx)
+void lotab_client_send_close_tabs(ClientContext* ctx, const uint32_t* tab_handles, size_t count) {
+  if (!ctx || count == 0)
     return;
 
-  cJSON* root = cJSON_CreateObject();
-  cJSON_AddStringToObject(root, "event", "GUI::UDS::TabSelected");
-
-  cJSON* data = cJSON_CreateObject();
-  cJSON_AddItemToObject(root, "data", data);
+  JWrite* w = send_begin(ctx, "GUI::UDS::CloseTabsRequest");
+  jwrite_key(w, "data");
+  jwrite_object_begin(w);
+  write_handle_array(w, "tabHandles", tab_handles, count);
+  jwrite_object_end(w);
+  send_end(ctx);
+}
 
-  cJSON_AddNumberToObject(data, "tabId", (double)tab_id);
+void lotab_client_send_tab_selected(ClientContext* ctx, uint32_t tab_handle) {
+  if (!ctx)
+    return;
 
-  send_json_message(ctx, root);
-  cJSON_Delete(root);
+  JWrite* w = send_begin(ctx, "GUI::UDS::TabSelected");
+  jwrite_key(w, "data");
+  jwrite_object_begin(w);
+  jwrite_member_int64(w, "tabHandle", tab_handle);
+  jwrite_object_end(w);
+  send_end(ctx);
 }
 
 struct ModeContext {
@@ -1050,43 +1450,36 @@ void lm_mode_task_creation__process_key(void* data,
   }
 }
 
-void lotab_client_send_associate_tabs(ClientContext* ctx, const int64_t* tab_ids, size_t count, int64_t task_id) {
+void lotab_client_send_associate_tabs(ClientContext* ctx,
+                                      const uint32_t* tab_handles,
+                                      size_t count,
+                                      int64_t task_id) {
   if (!ctx || count == 0)
     return;
-  cJSON* root = cJSON_CreateObject();
-  cJSON_AddStringToObject(root, "event", "GUI::UDS::AssociateTabs");
-  cJSON* data = cJSON_CreateObject();
-  cJSON_AddItemToObject(root, "data", data);
-  cJSON_AddNumberToObject(data, "taskId", (double)task_id);
-  cJSON_AddNumberToObject(data, "count", count);
-  cJSON* ids = cJSON_CreateArray();
-  cJSON_AddItemToObject(data, "tabIds", ids);
-  for (size_t i = 0; i < count; i++) {
-    cJSON_AddItemToArray(ids, cJSON_CreateNumber((double)tab_ids[i]));
-  }
-  send_json_message(ctx, root);
-  cJSON_Delete(root);
+  JWrite* w = send_begin(ctx, "GUI::UDS::AssociateTabs");
+  jwrite_key(w, "data");
+  jwrite_object_begin(w);
+  jwrite_member_int64(w, "taskId", task_id);
+  jwrite_member_int64(w, "count", (int64_t)count);
+  write_handle_array(w, "tabHandles", tab_handles, count);
+  jwrite_object_end(w);
+  send_end(ctx);
 }
 
 void lotab_client_send_create_task_and_associate(ClientContext* ctx,
                                                  const char* name,
-                                                 const int64_t* tab_ids,
+                                                 const uint32_t* tab_handles,
                                                  size_t count) {
   if (!ctx || !name)
     return;
-  cJSON* root = cJSON_CreateObject();
-  cJSON_AddStringToObject(root, "event", "GUI::UDS::CreateTask");
-  cJSON* data = cJSON_CreateObject();
-  cJSON_AddItemToObject(root, "data", data);
-  cJSON_AddStringToObject(data, "name", name);
-  cJSON_AddNumberToObject(data, "count", count);
-  if (count > 0 && tab_ids) {
-    cJSON* ids = cJSON_CreateArray();
-    cJSON_AddItemToObject(data, "associateTabIds", ids);
-    for (size_t i = 0; i < count; i++) {
-      cJSON_AddItemToArray(ids, cJSON_CreateNumber((double)tab_ids[i]));
-    }
+  JWrite* w = send_begin(ctx, "GUI::UDS::CreateTask");
+  jwrite_key(w, "data");
+  jwrite_object_begin(w);
+  jwrite_member_string(w, "name", name);
+  jwrite_member_int64(w, "count", (int64_t)count);
+  if (count > 0 && tab_handles) {
+    write_handle_array(w, "associateTabHandles", tab_handles, count);
   }
-  send_json_message(ctx, root);
-  cJSON_Delete(root);
+  jwrite_object_end(w);
+  send_end(ctx);
 }
@@ -14,7 +14,9 @@ typedef struct ClientContext ClientContext;
 
 // Data Structures
 typedef struct LotabTab {
-  int64_t id;
+  // Daemon-assigned handle; commands below name tabs by it. Stale once the tab closes.
+  uint32_t handle;
+  int64_t id;  // Browser tab id, for display.
   char* title;
   bool active;
   int64_t task_id;
@@ -24,6 +26,7 @@ typedef struct LotabTask {
   int64_t id;
   char* name;
   char* color;
+  int64_t tab_count;
 } LotabTask;
 
 typedef struct LotabTabList {
@@ -38,6 +41,7 @@ typedef struct LotabTaskList {
 
 // Callbacks
 // Note: Pointers invalid after callback returns (lifetimes managed by client)
+// The lists are always whole: the client applies the engine's deltas to its own copy before calling.
 typedef void (*lotab_on_tabs_update_cb)(void* user_data, const LotabTabList* tabs);
 typedef void (*lotab_on_tasks_update_cb)(void* user_data, const LotabTaskList* tasks);
 typedef void (*lotab_on_ui_toggle_cb)(void* user_data);
@@ -57,12 +61,16 @@ void lotab_client_stop(ClientContext* ctx);
 void lotab_client_run_loop(ClientContext* ctx);
 
 // Send Actions
-void lotab_client_send_close_tabs(ClientContext* ctx, const int64_t* tab_ids, size_t count);
-void lotab_client_send_tab_selected(ClientContext* ctx, int64_t tab_id);
-void lotab_client_send_associate_tabs(ClientContext* ctx, const int64_t* tab_ids, size_t count, int64_t task_id);
+// Tabs are named by LotabTab.handle.
+void lotab_client_send_close_tabs(ClientContext* ctx, const uint32_t* tab_handles, size_t count);
+void lotab_client_send_tab_selected(ClientContext* ctx, uint32_t tab_handle);
+void lotab_client_send_associate_tabs(ClientContext* ctx,
+                                      const uint32_t* tab_handles,
+                                      size_t count,
+                                      int64_t task_id);
 void lotab_client_send_create_task_and_associate(ClientContext* ctx,
                                                  const char* name,
-                                                 const int64_t* tab_ids,
+                                                 const uint32_t* tab_handles,
                                                  size_t count);
 
 // Exposed for testing purposes
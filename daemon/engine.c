@@ -17,34 +17,111 @@
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include "arena.h"
 #include "config.h"
+#include "engine_events.h"
+#include "jscan.h"
+#include "json_id.h"
+#include "jwrite.h"
 #include "statusbar.h"
+#include "trace.h"
 #include "util.h"
 
 #define NGERROR(x) (-x)
 
 extern char** environ;  // Necessary global for inheriting env in subprocess.
 
+// The last full snapshot of a list sent to the GUI, kept serialized so that it can be sent again as is
+// while the state it shows is current (a GUI that reconnects or asks to start over).
+typedef struct GuiSnapshotCache {
+  JWrite frame;  // With JWRITE_FRAME_HEAD, ready to send.
+  int valid;
+  uint64_t seq;  // The push version it carries.
+  // The state versions it shows (TabState.version, or TaskState.version and TabState.members_version).
+  uint64_t version;
+  uint64_t members_version;
+} GuiSnapshotCache;
+
+// What the GUI was last sent of the tab list, so that the next push can carry only the records that
+// changed (TabsDelta). Versions number the pushes of the list, full or delta, from 1.
+typedef struct GuiTabMirror {
+  int primed;        // The GUI holds the last push; 0 makes the next one a full TabsUpdate.
+  uint64_t seq;      // Version of the last push.
+  uint64_t version;  // TabState.version the last push reflected.
+  // Per slot: the handle the GUI has for it (TAB_HANDLE_INVALID if none) and its position in that push.
+  TabHandle* handles;
+  uint32_t* ranks;
+  uint32_t cap;
+  GuiSnapshotCache snapshot;
+} GuiTabMirror;
+
+typedef struct GuiTaskRecord {
+  int64_t id;
+  char* name;
+  char* color;
+  uint32_t tab_count;
+} GuiTaskRecord;
+
+// The same for the task list (TasksDelta): the records of the last push, in order.
+typedef struct GuiTaskMirror {
+  int primed;
+  uint64_t seq;
+  GuiTaskRecord* records;
+  uint32_t count;
+  // Task id -> position in `records` + 1 (0 is an empty bucket), rebuilt with them. Open addressing like
+  // TaskIndex, with a power of two capacity kept at most 3/4 full.
+  uint32_t* index;
+  uint32_t index_cap;
+  GuiSnapshotCache snapshot;
+} GuiTaskMirror;
+
 typedef struct ServerContext {
   struct EngClass* cls;
   struct lws_context* lws_ctx;
-  struct lws* client_wsi;
+  // Established extension sessions, most recent first. Guarded by pending_msg_mutex, as are their
+  // outboxes and browser ids.
+  PerSessionData* sessions;
   pthread_t ws_thread;
   int uds_fd;
   atomic_bool ws_thread_exit;
-  atomic_bool send_tab_request;
   pthread_t uds_read_thread;
   atomic_bool uds_read_exit;
-  char* pending_ws_msg;
-  atomic_bool send_pending_msg;
   pthread_mutex_t pending_msg_mutex;
   char* uds_path;
+  // State versions last pushed to the GUI; UDS_VERSION_NONE forces the next push.
+  atomic_uint_fast64_t tabs_version_sent;
+  atomic_uint_fast64_t tasks_version_sent;
+  atomic_uint_fast64_t task_members_version_sent;
+  // Serializes pushes of the tab and task lists, which come from the WebSocket, UDS reader and hotkey
+  // threads, and guards the mirrors they are diffed against.
+  pthread_mutex_t gui_mutex;
+  GuiTabMirror tab_mirror;
+  GuiTaskMirror task_mirror;
+  // Delta messages, and the records and removed keys of one while it is diffed.
+  JWrite gui_frame;
+  JWrite gui_upserts;
+  JWrite gui_removed;
+  // Snapshot coalescing (see notify_gui()); WebSocket thread only.
+  lws_sorted_usec_list_t notify_sul;
+  lws_usec_t notify_last_us;  // When snapshots were last pushed from the WebSocket thread.
+  int notify_pending;         // `notify_sul` is scheduled.
+  // Per-message allocations of the WebSocket and UDS reader threads (cJSON trees, printed payloads).
+  Arena ws_arena;
+  Arena uds_arena;
 } ServerContext;
 
+#define UDS_VERSION_NONE UINT64_MAX
+
+// Window over which GUI snapshot pushes from the extension side are merged (NotifyCoalesceMs). About a
+// frame at 120 Hz: bursts collapse without the switcher visibly lagging.
+#define DEFAULT_NOTIFY_COALESCE_MS 8
+#define MAX_NOTIFY_COALESCE_MS 1000
+
 static struct EngClass TAB_STATE_CLASS = {
     .name = "tab",
 };
@@ -58,24 +135,21 @@ static struct EngClass SERVER_CONTEXT_CLASS = {
     .name = "server",
 };
 
-void task_state_add(TaskState* ts, const char* task_name, const char* color, int64_t external_id);
-void tab_state_update_active(TabState* ts, const cJSON* json_data);
 static void send_tasks_update_to_uds(EngineContext* ectx);
 static void send_tabs_update_to_uds(EngineContext* ectx);
-static void send_tabs_update_to_uds(EngineContext* ectx);
-
-static void tab_state_free(TabState* ts) {
-  if (!ts)
-    return;
-  TabInfo* current = ts->tabs;
-  while (current) {
-    TabInfo* next = current->next;
-    if (current->title)
-      free(current->title);
-    free(current);
-    current = next;
-  }
-  free(ts);
+static void notify_gui(EngineContext* ectx);
+static void gui_tab_mirror_free(GuiTabMirror* m);
+static void gui_task_mirror_free(GuiTaskMirror* m);
+
+// Makes the next pushes full snapshots, for a GUI that has none (a new connection) or asked for them.
+static void gui_forget_pushes(ServerContext* sc) {
+  pthread_mutex_lock(&sc->gui_mutex);
+  sc->tab_mirror.primed = 0;
+  sc->task_mirror.primed = 0;
+  atomic_store(&sc->tabs_version_sent, UDS_VERSION_NONE);
+  atomic_store(&sc->tasks_version_sent, UDS_VERSION_NONE);
+  atomic_store(&sc->task_members_version_sent, UDS_VERSION_NONE);
+  pthread_mutex_unlock(&sc->gui_mutex);
 }
 
 static void task_state_free(TaskState* ts) {
@@ -84,201 +158,426 @@ static void task_state_free(TaskState* ts) {
   TaskInfo* current = ts->tasks;
   while (current) {
     TaskInfo* next = current->next;
-    if (current->task_name)
-      free(current->task_name);
-    if (current->color)
-      free(current->color);
     free(current);
     current = next;
   }
+  free(ts->by_id.buckets);
+  free(ts->pending.buckets);
+  intern_table_clear(&ts->strings);
   free(ts);
 }
 
-static void handle_gui_msg(ServerContext* sc, const char* msg) {
-  cJSON* json = cJSON_Parse(msg);
-  if (!json) {
-    vlog(LOG_LEVEL_ERROR, sc, "Failed to parse GUI message: %s\n", msg);
+// Room WebSocket messages are written with in front of the text: the PendingWsMsg they are queued as,
+// then the LWS_PRE bytes lws_write() needs, so that the writer's buffer is queued and sent as is.
+#define WS_MSG_HEAD (offsetof(PendingWsMsg, data) + LWS_PRE)
+
+// Queues the message in `w` (written with WS_MSG_HEAD) for the session of `browser_id`, or for the most
+// recent session if `browser_id` is NULL (tabs of no known browser). A message for a browser that is not
+// connected is dropped: tab ids are only unique within a browser, so another one could act on its own
+// tabs of the same ids. Takes `w`'s buffer, leaving the writer empty.
+static void ws_queue_msg(ServerContext* sc, const char* browser_id, JWrite* w) {
+  size_t len;
+  PendingWsMsg* pending = (PendingWsMsg*)jwrite_take(w, &len);
+  if (!pending)
+    return;
+  pending->payload = pending->data + LWS_PRE;
+  pending->len = len;
+  pending->next = NULL;
+  trace_record(TRACE_WS_QUEUED, (uint32_t)len);
+
+  pthread_mutex_lock(&sc->pending_msg_mutex);
+  PerSessionData* target = browser_id ? NULL : sc->sessions;
+  for (PerSessionData* pss = sc->sessions; browser_id && pss; pss = pss->next) {
+    if (pss->browser_id && strcmp(pss->browser_id, browser_id) == 0) {
+      target = pss;
+      break;
+    }
+  }
+  if (target) {
+    if (target->outbox_tail)
+      target->outbox_tail->next = pending;
+    else
+      target->outbox_head = pending;
+    target->outbox_tail = pending;
+  }
+  pthread_mutex_unlock(&sc->pending_msg_mutex);
+
+  if (!target && browser_id) {
+    vlog(LOG_LEVEL_WARN, sc, "Browser %s not connected, dropping message: %s\n", browser_id, pending->payload);
+    free(pending);
+    return;
+  }
+  if (!target) {
+    vlog(LOG_LEVEL_WARN, sc, "No extension connected, dropping message: %s\n", pending->payload);
+    free(pending);
     return;
   }
+  vlog(LOG_LEVEL_TRACE, sc, "queueing message to websocket\n");
+  // Wake up the WebSocket thread safely
+  lws_cancel_service(sc->lws_ctx);
+}
 
-  cJSON* event = cJSON_GetObjectItem(json, "event");
-  if (cJSON_IsString(event) && event->valuestring) {
-    if (strcmp(event->valuestring, "GUI::UDS::TabSelected") == 0) {
-      cJSON* data = cJSON_GetObjectItem(json, "data");
-      cJSON* tab_id = cJSON_GetObjectItem(data, "tabId");
-      if (cJSON_IsNumber(tab_id)) {
-        vlog(LOG_LEVEL_INFO, sc, "gui-evt: tab_selected - id=%llu]\n", (uint64_t)tab_id->valuedouble);
-
-        // Queue WS message to extension
-        if (sc->client_wsi) {
-          vlog(LOG_LEVEL_TRACE, sc, "queueing message to websocket\n");
-          cJSON* ws_payload = cJSON_CreateObject();
-          cJSON_AddStringToObject(ws_payload, "event", "Daemon::WS::ActivateTabRequest");
-          cJSON* ws_data = cJSON_CreateObject();
-          cJSON_AddNumberToObject(ws_data, "tabId", tab_id->valuedouble);
-          cJSON_AddItemToObject(ws_payload, "data", ws_data);
-
-          char* ws_str = cJSON_PrintUnformatted(ws_payload);
-
-          pthread_mutex_lock(&sc->pending_msg_mutex);
-          if (sc->pending_ws_msg) {
-            free(sc->pending_ws_msg);
-          }
-          sc->pending_ws_msg = ws_str;
-          atomic_store(&sc->send_pending_msg, true);
-          pthread_mutex_unlock(&sc->pending_msg_mutex);
-          cJSON_Delete(ws_payload);
+// A GUI command, decoded straight from the message text so that the tabs it names are read exactly.
+// GUI commands name tabs by the handles from TabsUpdate ("tabHandle"/"tabHandles"). Older clients send
+// browser tab ids ("tabId"/"tabIds") instead, which are looked up in any browser.
+typedef struct GuiCommand {
+  GuiEventType type;
+  char event[64];  // Event name, for logging unknown commands.
+  int by_handle;   // Whether `refs` are handles rather than browser tab ids.
+  int has_refs;    // A number for TabSelected, an array for the others.
+  int64_t* refs;   // From arena_malloc().
+  uint32_t nb_refs;
+  int has_task_id;
+  int64_t task_id;
+  char* name;  // CreateTask's name, from arena_malloc(); NULL if absent.
+} GuiCommand;
+
+// Members holding each command's tabs; the handles member wins when both are present.
+static const struct {
+  const char* handles;
+  const char* ids;
+} GUI_TAB_REF_KEYS[GUI_EVENT_UNKNOWN] = {
+    [GUI_EVENT_TAB_SELECTED] = {"tabHandle", "tabId"},
+    [GUI_EVENT_CLOSE_TABS] = {"tabHandles", "tabIds"},
+    [GUI_EVENT_ASSOCIATE_TABS] = {"tabHandles", "tabIds"},
+    [GUI_EVENT_CREATE_TASK] = {"associateTabHandles", "associateTabIds"},
+};
 
-          // Wake up the WebSocket thread safely
-          lws_cancel_service(sc->lws_ctx);
-        }
-      } else {
-        vlog(LOG_LEVEL_ERROR, sc, "gui-evt: No tab id found for tab_selected\n");
-      }
-    } else if (strcmp(event->valuestring, "GUI::UDS::CloseTabsRequest") == 0) {
-      cJSON* data = cJSON_GetObjectItem(json, "data");
-      cJSON* tab_ids = cJSON_GetObjectItem(data, "tabIds");
-      if (cJSON_IsArray(tab_ids)) {
-        vlog(LOG_LEVEL_INFO, sc, "gui-evt: close_tabs - count=%d\n", cJSON_GetArraySize(tab_ids));
-
-        if (sc->client_wsi) {
-          cJSON* ws_payload = cJSON_CreateObject();
-          cJSON_AddStringToObject(ws_payload, "event", "Daemon::WS::CloseTabsRequest");
-          cJSON* ws_data = cJSON_CreateObject();
-          cJSON_AddItemToObject(ws_data, "tabIds", cJSON_Duplicate(tab_ids, 1));
-          cJSON_AddItemToObject(ws_payload, "data", ws_data);
-
-          char* ws_str = cJSON_PrintUnformatted(ws_payload);
-
-          pthread_mutex_lock(&sc->pending_msg_mutex);
-          if (sc->pending_ws_msg) {
-            free(sc->pending_ws_msg);
-          }
-          sc->pending_ws_msg = ws_str;
-          atomic_store(&sc->send_pending_msg, true);
-          pthread_mutex_unlock(&sc->pending_msg_mutex);
-          cJSON_Delete(ws_payload);
+// Reads the tab refs under the scanner into `cmd`, replacing any read before. Array elements that are
+// not numbers are dropped, as nothing could resolve them.
+static void gui_scan_refs(JScan* js, GuiCommand* cmd, int by_handle) {
+  int single = cmd->type == GUI_EVENT_TAB_SELECTED;
+  if (jscan_peek(js) != (single ? JSCAN_NUMBER : JSCAN_ARRAY)) {
+    jscan_skip(js);
+    return;
+  }
+  arena_free(cmd->refs);
+  cmd->refs = NULL;
+  cmd->nb_refs = 0;
+  cmd->by_handle = by_handle;
+  if (single) {
+    cmd->refs = arena_malloc(sizeof(int64_t));
+    cmd->has_refs = cmd->refs && jscan_int64(js, &cmd->refs[0]);
+    cmd->nb_refs = cmd->has_refs;
+    return;
+  }
+  // Count first so that the array is one allocation.
+  JScan counter = *js;
+  uint32_t count = 0;
+  jscan_array_begin(&counter);
+  while (jscan_array_next(&counter) && jscan_skip(&counter))
+    ++count;
+  if (count && !(cmd->refs = arena_malloc(count * sizeof(int64_t)))) {
+    jscan_skip(js);
+    return;
+  }
+  jscan_array_begin(js);
+  while (jscan_array_next(js)) {
+    if (jscan_peek(js) == JSCAN_NUMBER && cmd->nb_refs < count)
+      jscan_int64(js, &cmd->refs[cmd->nb_refs++]);
+    else
+      jscan_skip(js);
+  }
+  cmd->has_refs = !js->error;
+}
+
+static char* gui_scan_name(JScan* js) {
+  JScanStr s;
+  if (jscan_peek(js) != JSCAN_STRING) {
+    jscan_skip(js);
+    return NULL;
+  }
+  char* name = jscan_string(js, &s) ? arena_malloc(s.len + 1) : NULL;
+  if (name)
+    jscan_unescape(&s, name, s.len + 1);
+  return name;
+}
+
+static void gui_scan_data(JScan* js, GuiCommand* cmd) {
+  JScanStr key;
+  int seen_handles = 0, seen_ids = 0, seen_task_id = 0, seen_name = 0;
+  if (cmd->type == GUI_EVENT_UNKNOWN || jscan_peek(js) != JSCAN_OBJECT) {
+    jscan_skip(js);
+    return;
+  }
+  jscan_object_begin(js);
+  while (jscan_object_next(js, &key)) {
+    if (jscan_key_is(&key, GUI_TAB_REF_KEYS[cmd->type].handles) && !seen_handles) {
+      seen_handles = 1;
+      gui_scan_refs(js, cmd, 1);
+    } else if (jscan_key_is(&key, GUI_TAB_REF_KEYS[cmd->type].ids) && !seen_ids && !seen_handles) {
+      seen_ids = 1;
+      gui_scan_refs(js, cmd, 0);
+    } else if (cmd->type == GUI_EVENT_ASSOCIATE_TABS && jscan_key_is(&key, "taskId") && !seen_task_id) {
+      seen_task_id = 1;
+      if (jscan_peek(js) == JSCAN_NUMBER)
+        cmd->has_task_id = jscan_int64(js, &cmd->task_id);
+      else
+        jscan_skip(js);
+    } else if (cmd->type == GUI_EVENT_CREATE_TASK && jscan_key_is(&key, "name") && !seen_name) {
+      seen_name = 1;
+      cmd->name = gui_scan_name(js);
+    } else {
+      jscan_skip(js);
+    }
+  }
+  // A handles member that was not a list still takes precedence, leaving the command without tabs.
+  if (seen_handles && !cmd->by_handle) {
+    arena_free(cmd->refs);
+    cmd->refs = NULL;
+    cmd->nb_refs = 0;
+    cmd->has_refs = 0;
+    cmd->by_handle = 1;
+  }
+}
+
+// @returns 0 if `msg` is not a JSON object. Commands whose "event" is not a string come back with an
+// empty event name.
+static int gui_command_scan(const char* msg, size_t len, GuiCommand* cmd) {
+  JScan js;
+  JScanStr key, event;
+  const char* data = NULL;
+  int seen_event = 0;
+  memset(cmd, 0, sizeof(*cmd));
+  cmd->type = GUI_EVENT_UNKNOWN;
+
+  jscan_init(&js, msg, len);
+  if (!jscan_object_begin(&js))
+    return 0;
+  while (jscan_object_next(&js, &key)) {
+    if (jscan_key_is(&key, "event") && !seen_event) {
+      seen_event = 1;
+      if (jscan_peek(&js) == JSCAN_STRING && jscan_string(&js, &event) && event.len < sizeof(cmd->event))
+        jscan_unescape(&event, cmd->event, sizeof(cmd->event));
+      else
+        jscan_skip(&js);
+    } else {
+      if (jscan_key_is(&key, "data") && !data)
+        data = js.p;
+      jscan_skip(&js);
+    }
+  }
+  jscan_peek(&js);
+  if (js.error || js.p != js.end)
+    return 0;
+
+  if (cmd->event[0])
+    cmd->type = gui_event_lookup(cmd->event);
+  if (data) {
+    jscan_init(&js, data, (size_t)(msg + len - data));
+    gui_scan_data(&js, cmd);
+  }
+  return 1;
+}
+
+static void gui_command_free(GuiCommand* cmd) {
+  arena_free(cmd->refs);
+  arena_free(cmd->name);
+}
+
+static TabHandle gui_resolve_tab(EngineContext* ec, int64_t ref, int by_handle) {
+  TabState* ts = ec ? ec->tab_state : NULL;
+  if (!ts || ref < 0)
+    return TAB_HANDLE_INVALID;
+  if (by_handle)
+    return ref > UINT32_MAX ? TAB_HANDLE_INVALID : tab_state_resolve(ts, (TabHandle)ref);
+  return tab_state_find_tab(ts, (uint64_t)ref);
+}
+
+// Writes {"event": `event`, "data": {`members`..., "tabIds": [ to `w`, for the ids to follow.
+static void ws_tab_ids_begin(JWrite* w, const char* event, JWrite* members) {
+  size_t len = 0;
+  const char* text = members ? jwrite_json(members, &len) : NULL;
+  jwrite_reset(w);
+  jwrite_object_begin(w);
+  jwrite_member_string(w, "event", event);
+  jwrite_key(w, "data");
+  jwrite_object_begin(w);
+  jwrite_raw(w, text, len);
+  jwrite_key(w, "tabIds");
+  jwrite_array_begin(w);
+}
+
+static void ws_tab_ids_end(JWrite* w) {
+  jwrite_array_end(w);
+  jwrite_object_end(w);
+  jwrite_object_end(w);
+}
 
-          lws_cancel_service(sc->lws_ctx);
+// Queues `event` to every browser owning some of the command's tabs, each with the `members` of its data
+// (written with no head, or NULL) plus its share of the tabs as browser tab ids. Ids the store does not
+// know go to the most recent session, as does an empty list; handles of closed tabs are dropped, and a
+// command left with none is not sent at all.
+static void ws_queue_per_browser(ServerContext* sc, EngineContext* ec, const char* event, JWrite* members,
+                                 const GuiCommand* cmd) {
+  TabState* ts = ec ? ec->tab_state : NULL;
+  uint32_t nb_browsers = ts && ts->nb_browsers ? ts->nb_browsers : 1;
+  int sent = 0;
+  JWrite w;
+  jwrite_init(&w, WS_MSG_HEAD);
+  for (uint32_t b = 0; b < nb_browsers; ++b) {
+    ws_tab_ids_begin(&w, event, members);
+    int nb_ids = 0;
+    for (uint32_t i = 0; i < cmd->nb_refs; ++i) {
+      TabHandle h = gui_resolve_tab(ec, cmd->refs[i], cmd->by_handle);
+      if (h != TAB_HANDLE_INVALID) {
+        uint32_t slot = tab_handle_slot(h);
+        if (ts->browsers[slot] == b) {
+          jwrite_int64(&w, (int64_t)ts->ids[slot]);
+          ++nb_ids;
         }
+      } else if (!cmd->by_handle && b == TAB_BROWSER_NONE) {
+        jwrite_int64(&w, cmd->refs[i]);
+        ++nb_ids;
       }
+    }
+    if (nb_ids == 0)
+      continue;
+    ws_tab_ids_end(&w);
+    ws_queue_msg(sc, ts ? tab_state_browser_id(ts, (BrowserHandle)b) : NULL, &w);
+    sent = 1;
+  }
+  if (!sent && cmd->nb_refs == 0) {
+    ws_tab_ids_begin(&w, event, members);
+    ws_tab_ids_end(&w);
+    ws_queue_msg(sc, NULL, &w);
+  }
+  jwrite_free(&w);
+}
 
-    } else if (strcmp(event->valuestring, "GUI::UDS::AssociateTabs") == 0) {
-      cJSON* data = cJSON_GetObjectItem(json, "data");
-      cJSON* task_id_json = cJSON_GetObjectItem(data, "taskId");
-      cJSON* tab_ids = cJSON_GetObjectItem(data, "tabIds");
-      if (cJSON_IsNumber(task_id_json) && cJSON_IsArray(tab_ids)) {
-        int64_t task_id = (int64_t)task_id_json->valuedouble;
-        EngineContext* ec = (EngineContext*)lws_context_user(sc->lws_ctx);
-        if (ec && ec->tab_state) {
-          cJSON* id_item = NULL;
-          // We need to collect tab IDs for both local update and WS forwarding
-          cJSON_ArrayForEach(id_item, tab_ids) {
-            if (cJSON_IsNumber(id_item)) {
-              TabInfo* tab = tab_state_find_tab(ec->tab_state, (uint64_t)id_item->valuedouble);
-              if (tab) {
-                tab->task_ext_id = task_id;
-              }
-            }
-          }
-          send_tabs_update_to_uds(ec);
-
-          // Forward to Extension to update real Tab Groups
-          // Find matching TaskInfo for external_id
-          int64_t group_id = 0;
-          if (ec->task_state) {
-            TaskInfo* curr = ec->task_state->tasks;
-            while (curr) {
-              if ((int64_t)curr->external_id == task_id) {
-                group_id = curr->external_id;
-                break;
-              }
-              curr = curr->next;
-            }
-          }
+static void gui_set_task(EngineContext* ec, const GuiCommand* cmd, int64_t task_id) {
+  for (uint32_t i = 0; i < cmd->nb_refs; ++i) {
+    TabHandle h = gui_resolve_tab(ec, cmd->refs[i], cmd->by_handle);
+    if (h != TAB_HANDLE_INVALID)
+      tab_state_set_task(ec->tab_state, h, task_id);
+  }
+}
 
-          // If group_id is 0, it means it's a local-only task or creates a new group.
-          // We generally only want to sync if we have a valid external ID or if intended.
-          // For now, let's forward everything. If group_id is 0, extension treats as new group.
+// @returns how many of the command's tabs ws_queue_per_browser() would pass on: the ones that resolve, and
+// bare ids, which go through as written. Stale handles are not counted.
+static uint32_t gui_count_routable(EngineContext* ec, const GuiCommand* cmd) {
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < cmd->nb_refs; ++i) {
+    if (!cmd->by_handle || gui_resolve_tab(ec, cmd->refs[i], cmd->by_handle) != TAB_HANDLE_INVALID)
+      ++count;
+  }
+  return count;
+}
 
-          cJSON* ws_payload = cJSON_CreateObject();
-          cJSON_AddStringToObject(ws_payload, "event", "Daemon::WS::GroupTabs");
-          cJSON* ws_data = cJSON_CreateObject();
-          cJSON_AddItemToObject(ws_data, "tabIds", cJSON_Duplicate(tab_ids, 1));
-          if (group_id != 0) {
-            cJSON_AddNumberToObject(ws_data, "groupId", (double)group_id);
-          }
-          cJSON_AddItemToObject(ws_payload, "data", ws_data);
+static void handle_gui_msg(ServerContext* sc, const char* msg, size_t len) {
+  GuiCommand cmd;
+  trace_record(TRACE_GUI_RECEIVED, (uint32_t)len);
+  if (!gui_command_scan(msg, len, &cmd)) {
+    vlog(LOG_LEVEL_ERROR, sc, "Failed to parse GUI message: %s\n", msg);
+    gui_command_free(&cmd);
+    return;
+  }
 
-          char* ws_str = cJSON_PrintUnformatted(ws_payload);
+  EngineContext* ec = (EngineContext*)lws_context_user(sc->lws_ctx);
+  if (cmd.type == GUI_EVENT_TAB_SELECTED) {
+    if (cmd.has_refs) {
+      int64_t ref = cmd.refs[0];
+      vlog(LOG_LEVEL_INFO, sc, "gui-evt: tab_selected - %s=%lld]\n", cmd.by_handle ? "handle" : "id",
+           (long long)ref);
 
-          pthread_mutex_lock(&sc->pending_msg_mutex);
-          if (sc->pending_ws_msg) {
-            free(sc->pending_ws_msg);
-          }
-          sc->pending_ws_msg = ws_str;
-          atomic_store(&sc->send_pending_msg, true);
-          pthread_mutex_unlock(&sc->pending_msg_mutex);
-          cJSON_Delete(ws_payload);
+      // Translate to the browser's tab id and queue to the extension owning the tab
+      TabHandle h = gui_resolve_tab(ec, ref, cmd.by_handle);
+      const char* browser_id = NULL;
+      int64_t tab_id = ref;
+      if (h != TAB_HANDLE_INVALID) {
+        browser_id = tab_state_browser_id(ec->tab_state, ec->tab_state->browsers[tab_handle_slot(h)]);
+        tab_id = (int64_t)ec->tab_state->ids[tab_handle_slot(h)];
+      }
+      if (h != TAB_HANDLE_INVALID || !cmd.by_handle) {
+        JWrite w;
+        jwrite_init(&w, WS_MSG_HEAD);
+        jwrite_object_begin(&w);
+        jwrite_member_string(&w, "event", "Daemon::WS::ActivateTabRequest");
+        jwrite_key(&w, "data");
+        jwrite_object_begin(&w);
+        jwrite_member_int64(&w, "tabId", tab_id);
+        jwrite_object_end(&w);
+        jwrite_object_end(&w);
+        ws_queue_msg(sc, browser_id, &w);
+        jwrite_free(&w);
+      } else {
+        vlog(LOG_LEVEL_WARN, sc, "gui-evt: tab_selected names a closed tab\n");
+      }
+    } else {
+      vlog(LOG_LEVEL_ERROR, sc, "gui-evt: No tab id found for tab_selected\n");
+    }
+  } else if (cmd.type == GUI_EVENT_CLOSE_TABS) {
+    if (cmd.has_refs) {
+      vlog(LOG_LEVEL_INFO, sc, "gui-evt: close_tabs - count=%u\n", cmd.nb_refs);
+
+      ws_queue_per_browser(sc, ec, "Daemon::WS::CloseTabsRequest", NULL, &cmd);
+    }
 
-          lws_cancel_service(sc->lws_ctx);
+  } else if (cmd.type == GUI_EVENT_ASSOCIATE_TABS) {
+    if (cmd.has_task_id && cmd.has_refs) {
+      int64_t task_id = cmd.task_id;
+      if (ec && ec->tab_state) {
+        // We need to collect tab IDs for both local update and WS forwarding
+        gui_set_task(ec, &cmd, task_id);
+        send_tabs_update_to_uds(ec);
+
+        // Forward to Extension to update real Tab Groups
+        // Find matching TaskInfo for external_id
+        int64_t group_id = 0;
+        if (ec->task_state && task_state_find_by_external_id(ec->task_state, task_id)) {
+          group_id = task_id;
         }
-      }
-    } else if (strcmp(event->valuestring, "GUI::UDS::CreateTask") == 0) {
-      cJSON* data = cJSON_GetObjectItem(json, "data");
-      cJSON* name_json = cJSON_GetObjectItem(data, "name");
-      cJSON* associate_tab_ids = cJSON_GetObjectItem(data, "associateTabIds");
-
-      if (cJSON_IsString(name_json) && name_json->valuestring) {
-        EngineContext* ec = (EngineContext*)lws_context_user(sc->lws_ctx);
-        // Use -1 for external_id to mark as unconfirmed/local-only initially
-        task_state_add(ec->task_state, name_json->valuestring, "grey", -1);
-
-        // New task is head
-        TaskInfo* new_t = ec->task_state->tasks;
-        send_tasks_update_to_uds(ec);
-
-        // Associate tabs locally
-        if (cJSON_IsArray(associate_tab_ids)) {
-          cJSON* id_item = NULL;
-          cJSON_ArrayForEach(id_item, associate_tab_ids) {
-            if (cJSON_IsNumber(id_item)) {
-              TabInfo* tab = tab_state_find_tab(ec->tab_state, (uint64_t)id_item->valuedouble);
-              if (tab) {
-                tab->task_ext_id = new_t->external_id;
-              }
-            }
-          }
-          send_tabs_update_to_uds(ec);
-
-          // Send request to Extension to create real group
-          cJSON* ws_payload = cJSON_CreateObject();
-          cJSON_AddStringToObject(ws_payload, "event", "Daemon::WS::CreateTabGroupRequest");
-          cJSON* ws_data = cJSON_CreateObject();
-          cJSON_AddStringToObject(ws_data, "title", name_json->valuestring);
-          cJSON_AddItemToObject(ws_data, "tabIds", cJSON_Duplicate(associate_tab_ids, 1));
-          cJSON_AddStringToObject(ws_data, "color", "grey");  // Default
-          cJSON_AddItemToObject(ws_payload, "data", ws_data);
-
-          char* ws_str = cJSON_PrintUnformatted(ws_payload);
-
-          pthread_mutex_lock(&sc->pending_msg_mutex);
-          if (sc->pending_ws_msg) {
-            free(sc->pending_ws_msg);
-          }
-          sc->pending_ws_msg = ws_str;
-          atomic_store(&sc->send_pending_msg, true);
-          pthread_mutex_unlock(&sc->pending_msg_mutex);
-          cJSON_Delete(ws_payload);
 
-          lws_cancel_service(sc->lws_ctx);
+        // If group_id is 0, it means it's a local-only task or creates a new group.
+        // We generally only want to sync if we have a valid external ID or if intended.
+        // For now, let's forward everything. If group_id is 0, extension treats as new group.
+
+        JWrite members;
+        jwrite_init(&members, 0);
+        if (group_id != 0) {
+          jwrite_member_int64(&members, "groupId", group_id);
         }
+        ws_queue_per_browser(sc, ec, "Daemon::WS::GroupTabs", &members, &cmd);
+        jwrite_free(&members);
       }
-    } else {
-      vlog(LOG_LEVEL_INFO, sc, "Received GUI Event: %s\n", event->valuestring);
     }
+  } else if (cmd.type == GUI_EVENT_CREATE_TASK) {
+    if (cmd.name) {
+      // Use -1 for external_id to mark as unconfirmed/local-only initially
+      TaskInfo* new_t = task_state_add(ec->task_state, cmd.name, "grey", -1);
+      send_tasks_update_to_uds(ec);
+
+      // Associate tabs locally. Without tabs (none named, or all closed since) there is no group to ask
+      // for: the extension would drop the request, and the task would wait on its request id for good
+      // instead of being claimed by name.
+      if (new_t && gui_count_routable(ec, &cmd) > 0) {
+        gui_set_task(ec, &cmd, new_t->external_id);
+        send_tabs_update_to_uds(ec);
+
+        // Send request to Extension to create real group. A group cannot span browsers, so each
+        // browser gets a group of the same name for its share of the tabs.
+        // The extension echoes requestId back with the group it made, which binds the task to it.
+        task_state_await_group(ec->task_state, new_t);
+        JWrite members;
+        jwrite_init(&members, 0);
+        jwrite_member_int64(&members, "requestId", new_t->external_id);
+        jwrite_member_string(&members, "title", cmd.name);
+        jwrite_member_string(&members, "color", "grey");  // Default
+        ws_queue_per_browser(sc, ec, "Daemon::WS::CreateTabGroupRequest", &members, &cmd);
+        jwrite_free(&members);
+      }
+    }
+  } else if (cmd.type == GUI_EVENT_SNAPSHOT_REQUEST) {
+    // The GUI lost track of the deltas (see send_tabs_update_to_uds()); start it over from snapshots.
+    vlog(LOG_LEVEL_INFO, sc, "gui-evt: snapshot requested\n");
+    gui_forget_pushes(sc);
+    send_tabs_update_to_uds(ec);
+    send_tasks_update_to_uds(ec);
+  } else if (cmd.event[0]) {
+    vlog(LOG_LEVEL_INFO, sc, "Received GUI Event: %s\n", cmd.event);
   }
-  cJSON_Delete(json);
+  trace_record(TRACE_GUI_HANDLED, (uint32_t)cmd.type);
+  gui_command_free(&cmd);
 }
 
 static void* uds_read_thread_run(void* arg) {
@@ -332,7 +631,9 @@ static void* uds_read_thread_run(void* arg) {
 
     if (total_read == msg_len) {
       buffer[msg_len] = '\0';
-      handle_gui_msg(sc, buffer);
+      arena_enter(&sc->uds_arena);
+      handle_gui_msg(sc, buffer, msg_len);
+      arena_leave(&sc->uds_arena);
     } else {
       vlog(LOG_LEVEL_ERROR, sc, "UDS recv payload incomplete. Expected %u, got %zu\n", msg_len, total_read);
       break;
@@ -374,6 +675,8 @@ static int setup_uds_client(ServerContext* sctx) {
         free(msg);
       }
       sctx->uds_fd = uds_fd;
+      // A fresh connection has seen nothing yet.
+      gui_forget_pushes(sctx);
       atomic_store(&sctx->uds_read_exit, 0);
       pthread_create(&sctx->uds_read_thread, NULL, uds_read_thread_run, sctx);
       return 0;
@@ -389,31 +692,22 @@ static int setup_uds_client(ServerContext* sctx) {
   return -1;
 }
 
-static void send_uds(const int uds_fd, const cJSON* json_data) {
-  if (uds_fd >= 0) {
-    char* json_str = cJSON_PrintUnformatted(json_data);
-    if (json_str) {
-      size_t len = strlen(json_str);
-      // Frame: [Length: 4 bytes (LE)] [Payload]
-      size_t frame_len = sizeof(uint32_t) + len;
-      char* msg = malloc(frame_len);
-      if (msg) {
-        // Assume LE host (macOS M1/Intel are LE)
-        uint32_t header = (uint32_t)len;
-        memcpy(msg, &header, sizeof(uint32_t));
-        memcpy(msg + sizeof(uint32_t), json_str, len);
-
-        if (send(uds_fd, msg, frame_len, 0) < 0) {
-          vlog(LOG_LEVEL_ERROR, NULL, "Failed to send data to App via UDS: %s\n", strerror(errno));
-        } else {
-          vlog(LOG_LEVEL_TRACE, NULL, "uds-send: %s (len: %zu)\n", json_str, len);
-        }
-        free(msg);
-      }
-      free(json_str);
-    }
-  } else {
+// Sends `len` bytes of serialized JSON as one frame.
+static void send_uds_json(const int uds_fd, const char* json_str, size_t len) {
+  if (uds_fd < 0) {
     vlog(LOG_LEVEL_WARN, NULL, "Warning - Cannot send UDS, not connected.\n");
+    return;
+  }
+  // Frame: [Length: 4 bytes (LE)] [Payload]
+  // Assume LE host (macOS M1/Intel are LE)
+  uint32_t header = (uint32_t)len;
+  struct iovec frame[2] = {{.iov_base = &header, .iov_len = sizeof(header)},
+                           {.iov_base = (void*)json_str, .iov_len = len}};
+  if (writev_all(uds_fd, frame, 2) < 0) {
+    vlog(LOG_LEVEL_ERROR, NULL, "Failed to send data to App via UDS: %s\n", strerror(errno));
+  } else {
+    trace_record(TRACE_UDS_SENT, (uint32_t)len);
+    vlog(LOG_LEVEL_TRACE, NULL, "uds-send: %.*s (len: %zu)\n", (int)len, json_str, len);
   }
 }
 
@@ -424,8 +718,12 @@ static void pss_clear_message(PerSessionData* pss, int should_free) {
   }
   pss->msg = NULL;
   pss->len = 0;
+  pss->cap = 0;
 }
 
+// Largest receive buffer a session keeps between messages; bigger ones are freed once handled.
+#define WS_MSG_KEEP_MAX (4 * 1024 * 1024)
+
 static int callback_minimal(struct lws* wsi, enum lws_callback_reasons reason, void* _user, void* in, size_t len) {
   EngineContext* ec = (EngineContext*)lws_context_user(lws_get_context(wsi));
   ServerContext* sc = (ServerContext*)ec->serv_ctx;
@@ -434,91 +732,101 @@ static int callback_minimal(struct lws* wsi, enum lws_callback_reasons reason, v
   switch (reason) {
     case LWS_CALLBACK_ESTABLISHED:
       lwsl_user("LWS_CALLBACK_ESTABLISHED (new connection)\n");
-      sc->client_wsi = wsi;
-      atomic_store(&sc->send_tab_request, 1);
       if (pss) {
         pss_clear_message(pss, 0);
+        pss->wsi = wsi;
+        pss->send_tab_request = 1;
+        pthread_mutex_lock(&sc->pending_msg_mutex);
+        pss->next = sc->sessions;
+        sc->sessions = pss;
+        pthread_mutex_unlock(&sc->pending_msg_mutex);
       }
       lws_callback_on_writable(wsi);
       break;
 
     case LWS_CALLBACK_CLOSED:
       lwsl_user("LWS_CALLBACK_CLOSED (connection lost)\n");
-      if (sc->client_wsi == wsi) {
-        sc->client_wsi = NULL;
-      }
-      if (pss && pss->browser_id) {
-        free(pss->browser_id);
-        pss->browser_id = NULL;
+      if (!pss)
+        break;
+      pthread_mutex_lock(&sc->pending_msg_mutex);
+      for (PerSessionData** link = &sc->sessions; *link; link = &(*link)->next) {
+        if (*link == pss) {
+          *link = pss->next;
+          break;
+        }
       }
-      if (pss && pss->msg) {
-        pss_clear_message(pss, 1);
+      while (pss->outbox_head) {
+        PendingWsMsg* next = pss->outbox_head->next;
+        free(pss->outbox_head);
+        pss->outbox_head = next;
       }
-      if (pss && pss->msg) {
+      pss->outbox_tail = NULL;
+      free(pss->browser_id);
+      pss->browser_id = NULL;
+      pthread_mutex_unlock(&sc->pending_msg_mutex);
+      if (pss->msg) {
         pss_clear_message(pss, 1);
       }
       break;
 
     case LWS_CALLBACK_EVENT_WAIT_CANCELLED:
-      if (sc && sc->client_wsi) {
+      if (sc) {
         pthread_mutex_lock(&sc->pending_msg_mutex);
-        if (atomic_load(&sc->send_pending_msg)) {
-          lws_callback_on_writable(sc->client_wsi);
+        for (PerSessionData* s = sc->sessions; s; s = s->next) {
+          if (s->outbox_head)
+            lws_callback_on_writable(s->wsi);
         }
         pthread_mutex_unlock(&sc->pending_msg_mutex);
       }
       break;
 
-    case LWS_CALLBACK_SERVER_WRITEABLE:
+    case LWS_CALLBACK_SERVER_WRITEABLE: {
       vlog(LOG_LEVEL_TRACE, sc, "lws-server-writeable\n");
-      if (atomic_load(&sc->send_tab_request)) {
+      if (pss->send_tab_request) {
         const char* msg = "{\"event\":\"Daemon::WS::AllTabsInfoRequest\"}";
         size_t msg_len = strlen(msg);
         unsigned char buf[LWS_PRE + 256];
         memset(buf, 0, sizeof(buf));
         memcpy(&buf[LWS_PRE], msg, msg_len);
         lws_write(wsi, &buf[LWS_PRE], msg_len, LWS_WRITE_TEXT);
-        atomic_store(&sc->send_tab_request, 0);
+        pss->send_tab_request = 0;
         vlog(LOG_LEVEL_INFO, sc, "Sent request_tab_info to extension\n");
       }
+      // One queued message per writeable callback; ask for another if more are waiting.
       pthread_mutex_lock(&sc->pending_msg_mutex);
-      if (atomic_load(&sc->send_pending_msg) && sc->pending_ws_msg) {
-        vlog(LOG_LEVEL_TRACE, sc, "Sending pending message to websocket.\n");
-        size_t msg_len = strlen(sc->pending_ws_msg);
-        // Allocate buffer with LWS_PRE padding
-        unsigned char* buf = malloc(LWS_PRE + msg_len + 1);
-        if (buf) {
-          memcpy(&buf[LWS_PRE], sc->pending_ws_msg, msg_len);
-          buf[LWS_PRE + msg_len] = '\0';  // Just in case
-          lws_write(wsi, &buf[LWS_PRE], msg_len, LWS_WRITE_TEXT);
-          free(buf);
-        }
-        free(sc->pending_ws_msg);
-        sc->pending_ws_msg = NULL;
-        atomic_store(&sc->send_pending_msg, 0);
+      PendingWsMsg* pending = pss->outbox_head;
+      if (pending) {
+        pss->outbox_head = pending->next;
+        if (!pss->outbox_head)
+          pss->outbox_tail = NULL;
       }
+      int more = pss->outbox_head != NULL;
       pthread_mutex_unlock(&sc->pending_msg_mutex);
-      break;
+      if (pending) {
+        vlog(LOG_LEVEL_TRACE, sc, "Sending pending message to websocket.\n");
+        lws_write(wsi, (unsigned char*)pending->payload, pending->len, LWS_WRITE_TEXT);
+        trace_record(TRACE_WS_SENT, (uint32_t)pending->len);
+        free(pending);
+      }
+      if (more)
+        lws_callback_on_writable(wsi);
+    } break;
 
     case LWS_CALLBACK_RECEIVE: {
       const size_t remaining = lws_remaining_packet_payload(wsi);
       int is_final = lws_is_final_fragment(wsi);
 
-      if (!pss->msg) {
-        pss_clear_message(pss, 0);
-        pss->msg = malloc(len + remaining + 1);
-        if (!pss->msg) {
-          lwsl_err("OOM: dropping\n");
-          return -1;
-        }
-      } else {
-        char* new_msg = realloc(pss->msg, pss->len + len + remaining + 1);
+      // The buffer is kept from one message to the next, so it only grows when a bigger one arrives.
+      size_t need = pss->len + len + remaining + 1;
+      if (need > pss->cap) {
+        char* new_msg = realloc(pss->msg, need);
         if (!new_msg) {
           lwsl_err("OOM: dropping\n");
           pss_clear_message(pss, 1);
           return -1;
         }
         pss->msg = new_msg;
+        pss->cap = need;
       }
 
       memcpy(pss->msg + pss->len, in, len);
@@ -529,7 +837,9 @@ static int callback_minimal(struct lws* wsi, enum lws_callback_reasons reason, v
 
         // Delegate parsing and handling to engine_handle_event
         // Pass pss so it can be updated (e.g. browser_id, should_close)
+        arena_enter(&sc->ws_arena);
         engine_handle_event(ec, EVENT_WS_MESSAGE_RECEIVED, pss->msg, pss);
+        arena_leave(&sc->ws_arena);
 
         if (pss->should_close) {
           vlog(LOG_LEVEL_WARN, sc, "Closing connection due to policy violation.\n");
@@ -537,7 +847,10 @@ static int callback_minimal(struct lws* wsi, enum lws_callback_reasons reason, v
           return -1;
         }
 
-        pss_clear_message(pss, 1);
+        if (pss->cap > WS_MSG_KEEP_MAX)
+          pss_clear_message(pss, 1);
+        else
+          pss->len = 0;
       }
     } break;
     default:
@@ -614,12 +927,15 @@ static void lws_log_emit_cb(int level, const char* line) {
 }
 
 // @returns 0 on failure.
-static int setup_app_config_dir(const EngineCreationInfo* cinfo, OUT char** out_keyboard_toggle) {
+static int setup_app_config_dir(const EngineCreationInfo* cinfo, OUT char** out_keyboard_toggle,
+                                OUT uint32_t* out_notify_coalesce_ms) {
   char config_dir[512];
   char* keybind_val = NULL;
   static const char* DEFAULT_UI_TOGGLE_KEYBIND = "CMD+SHIFT+J";
 
   assert(out_keyboard_toggle);
+  assert(out_notify_coalesce_ms);
+  *out_notify_coalesce_ms = DEFAULT_NOTIFY_COALESCE_MS;
 
   if (cinfo->config_path && strlen(cinfo->config_path) > 0) {
     strncpy(config_dir, cinfo->config_path, sizeof(config_dir) - 1);
@@ -650,6 +966,8 @@ static int setup_app_config_dir(const EngineCreationInfo* cinfo, OUT char** out_
       if (fp) {
         fprintf(fp, "# Lotab Configuration\n");
         fprintf(fp, "UiToggleKeybind = \"%s\"\n", DEFAULT_UI_TOGGLE_KEYBIND);
+        fprintf(fp, "# Tab and task updates to the switcher are batched over this many milliseconds (0 = off).\n");
+        fprintf(fp, "NotifyCoalesceMs = %d\n", DEFAULT_NOTIFY_COALESCE_MS);
         fclose(fp);
         vlog(LOG_LEVEL_INFO, NULL, "Created config file: %s\n", config_file);
       } else {
@@ -670,6 +988,16 @@ static int setup_app_config_dir(const EngineCreationInfo* cinfo, OUT char** out_
           free(bind.u.s);
           vlog(LOG_LEVEL_INFO, NULL, "Loaded keybind: %s\n", keybind_val);
         }
+        toml_datum_t coalesce = toml_int_in(conf, "NotifyCoalesceMs");
+        if (coalesce.ok) {
+          if (coalesce.u.i >= 0 && coalesce.u.i <= MAX_NOTIFY_COALESCE_MS) {
+            *out_notify_coalesce_ms = (uint32_t)coalesce.u.i;
+            vlog(LOG_LEVEL_INFO, NULL, "Loaded notify coalescing window: %u ms\n", *out_notify_coalesce_ms);
+          } else {
+            vlog(LOG_LEVEL_ERROR, NULL, "Invalid NotifyCoalesceMs: %lld. Must be 0 to %d; using %d.\n",
+                 (long long)coalesce.u.i, MAX_NOTIFY_COALESCE_MS, DEFAULT_NOTIFY_COALESCE_MS);
+          }
+        }
         toml_free(conf);
       } else {
         vlog(LOG_LEVEL_ERROR, NULL, "Failed to parse config file: %s\n", errbuf);
@@ -706,6 +1034,26 @@ fail:
   return 0;
 }
 
+// The flight recorder (trace.h) dumps next to the daemon manifest if there is one, else into the config
+// directory.
+static void engine_setup_trace(EngineContext* ec, const EngineCreationInfo* cinfo) {
+  char path[1024] = "";
+  const char* home_dir = getenv("HOME");
+  if (cinfo->daemon_manifest_path) {
+    snprintf(path, sizeof(path), "%s.trace", cinfo->daemon_manifest_path);
+    ec->trace_on_exit = 1;
+  } else if (cinfo->config_path && strlen(cinfo->config_path) > 0) {
+    snprintf(path, sizeof(path), "%s/daemon.trace", cinfo->config_path);
+    ec->trace_on_exit = 1;
+  } else if (home_dir) {
+    // Only for SIGUSR1 and crashes: an engine set up without paths (as in tests) must not overwrite the
+    // user's trace each time it shuts down.
+    snprintf(path, sizeof(path), "%s/.lotab/daemon.trace", home_dir);
+  }
+  trace_set_dump_path(path[0] ? path : NULL);
+  trace_install_handlers();
+}
+
 int engine_init(EngineContext** ectx, EngineCreationInfo cinfo) {
   assert(ectx != NULL);
   assert(*ectx == NULL);
@@ -724,16 +1072,16 @@ int engine_init(EngineContext** ectx, EngineCreationInfo cinfo) {
   memset(ec, 0, sizeof(EngineContext));
   ec->cls = &ENGINE_CONTEXT_CLASS;
   ec->app_pid = -1;
-  ec->tab_state = calloc(1, sizeof(TabState));
-  ec->tab_state->cls = &TAB_STATE_CLASS;
+  ec->tab_state = tab_state_alloc();
   ec->task_state = calloc(1, sizeof(TaskState));
   ec->task_state->cls = &TASK_STATE_CLASS;
   ec->init_statusline = cinfo.enable_statusbar != 0;
 
-  if (setup_app_config_dir(&cinfo, &ec->ui_toggle_keybind) == 0) {
+  if (setup_app_config_dir(&cinfo, &ec->ui_toggle_keybind, &ec->notify_coalesce_ms) == 0) {
     ret = -1;
     goto fail;
   }
+  engine_setup_trace(ec, &cinfo);
 
   // Setup websocket server
   vlog(LOG_LEVEL_INFO, ec, "Setting up websocket server.\n");
@@ -747,12 +1095,22 @@ int engine_init(EngineContext** ectx, EngineCreationInfo cinfo) {
   sc->cls = &SERVER_CONTEXT_CLASS;
   sc->uds_fd = -1;
   pthread_mutex_init(&sc->pending_msg_mutex, NULL);
+  pthread_mutex_init(&sc->gui_mutex, NULL);
+  jwrite_init(&sc->tab_mirror.snapshot.frame, JWRITE_FRAME_HEAD);
+  jwrite_init(&sc->task_mirror.snapshot.frame, JWRITE_FRAME_HEAD);
+  jwrite_init(&sc->gui_frame, JWRITE_FRAME_HEAD);
+  jwrite_init(&sc->gui_upserts, 0);
+  jwrite_init(&sc->gui_removed, 0);
   atomic_init(&sc->ws_thread_exit, 0);
-  atomic_init(&sc->send_tab_request, 0);
   atomic_init(&sc->uds_read_exit, 0);
-  atomic_init(&sc->send_pending_msg, 0);
+  atomic_init(&sc->tabs_version_sent, UDS_VERSION_NONE);
+  atomic_init(&sc->tasks_version_sent, UDS_VERSION_NONE);
+  atomic_init(&sc->task_members_version_sent, UDS_VERSION_NONE);
 
   lws_set_log_level(LLL_USER | LLL_ERR | LLL_WARN | LLL_NOTICE | LLL_INFO, lws_log_emit_cb);
+  // While a thread handles a message, cJSON allocates from that thread's message arena.
+  cJSON_Hooks cjson_hooks = {.malloc_fn = arena_malloc, .free_fn = arena_free};
+  cJSON_InitHooks(&cjson_hooks);
 
   if (cinfo.daemon_manifest_path) {
     ec->daemon_manifest_path = strdup(cinfo.daemon_manifest_path);
@@ -885,15 +1243,16 @@ static void engine_dump_manifest(EngineContext* ectx) {
   cJSON* tabs = cJSON_CreateArray();
   cJSON_AddItemToObject(root, "tabs", tabs);
   if (ectx->tab_state) {
-    TabInfo* t = ectx->tab_state->tabs;
-    while (t) {
+    const TabState* ts = ectx->tab_state;
+    TabOrderCursor cur;
+    for (uint32_t slot = tab_state_order_begin(ts, &cur); slot != TAB_SLOT_NONE;
+         slot = tab_state_order_next(ts, &cur)) {
       cJSON* t_obj = cJSON_CreateObject();
-      cJSON_AddNumberToObject(t_obj, "id", (double)t->id);
-      cJSON_AddStringToObject(t_obj, "title", t->title ? t->title : "");
-      cJSON_AddBoolToObject(t_obj, "active", t->active);
-      cJSON_AddNumberToObject(t_obj, "task_id", (double)t->task_ext_id);
+      json_id_add(t_obj, "id", (int64_t)ts->ids[slot]);
+      cJSON_AddStringToObject(t_obj, "title", ts->titles[slot] ? ts->titles[slot] : "");
+      cJSON_AddBoolToObject(t_obj, "active", (ts->flags[slot] & TAB_FLAG_ACTIVE) != 0);
+      json_id_add(t_obj, "task_id", ts->task_ids[slot]);
       cJSON_AddItemToArray(tabs, t_obj);
-      t = t->next;
     }
   }
 
@@ -904,10 +1263,12 @@ static void engine_dump_manifest(EngineContext* ectx) {
     TaskInfo* t = ectx->task_state->tasks;
     while (t) {
       cJSON* t_obj = cJSON_CreateObject();
-      cJSON_AddNumberToObject(t_obj, "task_id", (double)t->external_id);
+      json_id_add(t_obj, "task_id", t->external_id);
       cJSON_AddStringToObject(t_obj, "task_name", t->task_name ? t->task_name : "");
       cJSON_AddStringToObject(t_obj, "color", t->color ? t->color : "");
-      cJSON_AddNumberToObject(t_obj, "external_id", (double)t->external_id);
+      uint32_t tab_count = ectx->tab_state ? tab_state_task_count(ectx->tab_state, t->external_id) : 0;
+      cJSON_AddNumberToObject(t_obj, "tab_count", (double)tab_count);
+      json_id_add(t_obj, "external_id", t->external_id);
       cJSON_AddItemToArray(tasks, t_obj);
       t = t->next;
     }
@@ -924,7 +1285,7 @@ static void engine_dump_manifest(EngineContext* ectx) {
     vlog(LOG_LEVEL_ERROR, ectx, "Failed to write manifest to %s\n", ectx->daemon_manifest_path);
   }
 
-  free(json_str);
+  cJSON_free(json_str);
   cJSON_Delete(root);
 }
 
@@ -963,9 +1324,20 @@ void engine_destroy(EngineContext* ectx) {
       free(ectx->serv_ctx->uds_path);
     }
     pthread_mutex_destroy(&ectx->serv_ctx->pending_msg_mutex);
+    pthread_mutex_destroy(&ectx->serv_ctx->gui_mutex);
+    gui_tab_mirror_free(&ectx->serv_ctx->tab_mirror);
+    gui_task_mirror_free(&ectx->serv_ctx->task_mirror);
+    jwrite_free(&ectx->serv_ctx->gui_frame);
+    jwrite_free(&ectx->serv_ctx->gui_upserts);
+    jwrite_free(&ectx->serv_ctx->gui_removed);
+    arena_destroy(&ectx->serv_ctx->ws_arena);
+    arena_destroy(&ectx->serv_ctx->uds_arena);
     free(ectx->serv_ctx);
     ectx->serv_ctx = NULL;
   }
+  // After the service threads are gone, so the dump ends with their last events.
+  if (ectx->trace_on_exit && trace_dump_default() == 0)
+    vlog(LOG_LEVEL_INFO, ectx, "Dumped trace to %s\n", trace_dump_path());
   if (ectx->run_ctx) {
     free(ectx->run_ctx);
     ectx->run_ctx = NULL;
@@ -994,428 +1366,1678 @@ void engine_destroy(EngineContext* ectx) {
     free(ectx->allowed_browser_id);
     ectx->allowed_browser_id = NULL;
   }
+  free(ectx->scratch);
+  ectx->scratch = NULL;
+  ectx->scratch_cap = 0;
   ectx->destroyed = 1;
 }
 
-TabInfo* tab_state_find_tab(TabState* ts, const uint64_t id) {
-  assert(ts);
-  TabInfo* current = ts->tabs;
-  while (current) {
-    if (current->id == id)
-      return current;
-    current = current->next;
+struct InternEntry {
+  uint32_t refs;
+  uint32_t hash;
+  char str[];
+};
+
+#define INTERN_MIN_CAP 16
+
+static inline uint32_t intern_hash(const char* s) {
+  // FNV-1a; interned strings are short (uuids, color names, group titles).
+  uint32_t h = 2166136261u;
+  for (; *s; ++s) {
+    h ^= (uint8_t)*s;
+    h *= 16777619u;
   }
-  return NULL;
+  return h;
 }
 
-void tab_state_update_tab(TabState* ts, const char* title, const uint64_t id, int64_t task_id, const char* browser_id) {
-  TabInfo* ti = tab_state_find_tab(ts, id);
-  if (ti) {
-    if (ti->title && strcmp(title, ti->title) != 0) {
-      free(ti->title);
-      ti->title = strdup(title);
-    }
-    ti->task_ext_id = task_id;
-    if (browser_id) {
-      if (ti->browser_id)
-        free(ti->browser_id);
-      ti->browser_id = strdup(browser_id);
-    }
+static inline struct InternEntry* intern_entry_of(const char* interned) {
+  return (struct InternEntry*)(interned - offsetof(struct InternEntry, str));
+}
+
+// Returns the bucket holding `s`, or the empty bucket where it would be inserted.
+static uint32_t intern_probe(const InternTable* it, const char* s, uint32_t hash) {
+  const uint32_t mask = it->cap - 1;
+  uint32_t i = hash & mask;
+  while (it->buckets[i] && (it->buckets[i]->hash != hash || strcmp(it->buckets[i]->str, s) != 0)) {
+    i = (i + 1) & mask;
   }
+  return i;
 }
 
-void tab_state_add_tab(TabState* ts, const char* title, const uint64_t id, int64_t task_id, const char* browser_id) {
-  TabInfo* new_tab = malloc(sizeof(TabInfo));
-  if (new_tab) {
-    new_tab->id = id;
-    new_tab->title = strdup(title);
-    new_tab->active = 0;
-    new_tab->task_ext_id = task_id;
-    new_tab->browser_id = browser_id ? strdup(browser_id) : NULL;
-    new_tab->next = ts->tabs;
-    ts->tabs = new_tab;
-    ts->nb_tabs++;
+static int intern_grow(InternTable* it) {
+  uint32_t new_cap = it->cap ? it->cap * 2 : INTERN_MIN_CAP;
+  struct InternEntry** buckets = calloc(new_cap, sizeof(*buckets));
+  if (!buckets) {
+    vlog(LOG_LEVEL_ERROR, NULL, "Failed to grow intern table to %u buckets\n", new_cap);
+    return 0;
   }
+  for (uint32_t i = 0; i < it->cap; ++i) {
+    struct InternEntry* e = it->buckets[i];
+    if (!e)
+      continue;
+    uint32_t j = e->hash & (new_cap - 1);
+    while (buckets[j])
+      j = (j + 1) & (new_cap - 1);
+    buckets[j] = e;
+  }
+  free(it->buckets);
+  it->buckets = buckets;
+  it->cap = new_cap;
+  return 1;
 }
 
-void tab_state_remove_tab(TabState* ts, const uint64_t id) {
-  TabInfo* current = ts->tabs;
-  TabInfo* prev = NULL;
-  while (current) {
-    if (current->id == id) {
-      if (prev) {
-        prev->next = current->next;
-      } else {
-        ts->tabs = current->next;
-      }
-      if (current->title)
-        free(current->title);
-      if (current->browser_id)
-        free(current->browser_id);
-      free(current);
-      ts->nb_tabs--;
-      return;
+const char* intern_table_lookup(const InternTable* it, const char* s) {
+  if (!s || it->count == 0)
+    return NULL;
+  struct InternEntry* e = it->buckets[intern_probe(it, s, intern_hash(s))];
+  return e ? e->str : NULL;
+}
+
+const char* intern_table_acquire(InternTable* it, const char* s) {
+  if (!s)
+    return NULL;
+  if ((it->count + 1) * 4 > it->cap * 3 && !intern_grow(it))
+    return NULL;
+  uint32_t hash = intern_hash(s);
+  uint32_t i = intern_probe(it, s, hash);
+  struct InternEntry* e = it->buckets[i];
+  if (!e) {
+    size_t len = strlen(s);
+    e = malloc(sizeof(*e) + len + 1);
+    if (!e)
+      return NULL;
+    e->refs = 0;
+    e->hash = hash;
+    memcpy(e->str, s, len + 1);
+    it->buckets[i] = e;
+    it->count++;
+  }
+  e->refs++;
+  return e->str;
+}
+
+void intern_table_release(InternTable* it, const char* interned) {
+  if (!interned)
+    return;
+  struct InternEntry* e = intern_entry_of(interned);
+  assert(e->refs > 0);
+  if (--e->refs > 0)
+    return;
+  // Last reference: locate the bucket by identity and backward-shift the chain over it.
+  const uint32_t mask = it->cap - 1;
+  uint32_t hole = e->hash & mask;
+  while (it->buckets[hole] != e) {
+    hole = (hole + 1) & mask;
+  }
+  uint32_t i = hole;
+  for (;;) {
+    i = (i + 1) & mask;
+    struct InternEntry* next = it->buckets[i];
+    if (!next)
+      break;
+    uint32_t home = next->hash & mask;
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      it->buckets[hole] = next;
+      hole = i;
     }
-    prev = current;
-    current = current->next;
   }
+  it->buckets[hole] = NULL;
+  it->count--;
+  free(e);
 }
 
-TaskInfo* task_state_find_by_external_id(TaskState* ts, int64_t external_id) {
-  assert(ts);
-  if (external_id < 0)
-    return NULL;
-  TaskInfo* cur = ts->tasks;
-  while (cur) {
-    if (cur->external_id == external_id)
-      return cur;
-    cur = cur->next;
+void intern_table_assign(InternTable* it, const char** slot, const char* s) {
+  if (*slot == s || (*slot && s && strcmp(*slot, s) == 0))
+    return;
+  const char* next = intern_table_acquire(it, s);
+  intern_table_release(it, *slot);
+  *slot = next;
+}
+
+void intern_table_clear(InternTable* it) {
+  for (uint32_t i = 0; i < it->cap; ++i) {
+    free(it->buckets[i]);
   }
-  return NULL;
+  free(it->buckets);
+  it->buckets = NULL;
+  it->cap = 0;
+  it->count = 0;
 }
 
-void task_state_add(TaskState* ts, const char* task_name, const char* color, int64_t external_id) {
-  int64_t final_id = external_id;
-  if (final_id <= 0 && final_id != -1) {
-    // If 0 passed, treat as request for new ID? Or strict?
-    // For now, if caller passes -1 or 0, we might want to generate one.
-    // But the signature allows passing a specific negative ID too.
-    // Let's assume if -1 is passed, we generate a new negative ID.
-    // If a positive ID is passed, we use it.
-  }
-
-  if (external_id == -1) {
-    int64_t min_id = 0;
-    TaskInfo* curr = ts->tasks;
-    while (curr) {
-      if (curr->external_id < min_id)
-        min_id = curr->external_id;
-      curr = curr->next;
-    }
-    final_id = min_id - 1;
+#define TAB_INDEX_MIN_CAP 64
+#define TAB_STORE_MIN_CAP 64
+
+TabState* tab_state_alloc(void) {
+  TabState* ts = calloc(1, sizeof(TabState));
+  if (ts)
+    ts->cls = &TAB_STATE_CLASS;
+  return ts;
+}
+
+void tab_state_free(TabState* ts) {
+  if (!ts)
+    return;
+  for (uint32_t slot = 0; slot < ts->nb_slots; ++slot) {
+    if (!(ts->flags[slot] & TAB_FLAG_LIVE))
+      continue;
+    free(ts->titles[slot]);
+  }
+  free(ts->ids);
+  free(ts->stamps);
+  free(ts->task_ids);
+  free(ts->flags);
+  free(ts->gens);
+  free(ts->titles);
+  free(ts->browsers);
+  free(ts->browser_names);
+  free(ts->window_ids);
+  free(ts->pos_left);
+  free(ts->pos_right);
+  free(ts->pos_parent);
+  free(ts->pos_size);
+  free(ts->pos_prio);
+  free(ts->windows);
+  free(ts->task_next);
+  free(ts->task_prev);
+  free(ts->free_slots);
+  free(ts->index);
+  free(ts->task_index);
+  free(ts->active);
+  free(ts->active_scratch);
+  intern_table_clear(&ts->strings);
+  free(ts);
+}
+
+static inline TabHandle tab_make_handle(const TabState* ts, uint32_t slot) {
+  return ((uint32_t)ts->gens[slot] << TAB_SLOT_BITS) | slot;
+}
+
+TabHandle tab_state_resolve(const TabState* ts, TabHandle h) {
+  if (h == TAB_HANDLE_INVALID)
+    return TAB_HANDLE_INVALID;
+  uint32_t slot = tab_handle_slot(h);
+  if (!tab_slot_live(ts, slot) || tab_make_handle(ts, slot) != h)
+    return TAB_HANDLE_INVALID;
+  return h;
+}
+
+static inline uint32_t tab_index_hash(uint64_t id) {
+  // splitmix64 finalizer; tab ids are small sequential integers, so they need mixing
+  // before being masked into the table.
+  id ^= id >> 30;
+  id *= 0xbf58476d1ce4e5b9ULL;
+  id ^= id >> 27;
+  id *= 0x94d049bb133111ebULL;
+  id ^= id >> 31;
+  return (uint32_t)id;
+}
+
+static inline uint32_t tab_key_hash(BrowserHandle browser, uint64_t id) {
+  // Chrome tab ids fit in 32 bits, so the browser handle can sit above them without colliding.
+  return tab_index_hash(((uint64_t)browser << 48) ^ id);
+}
+
+// Returns the bucket holding (browser, id), or the empty bucket where it would be inserted.
+static uint32_t tab_index_probe(const TabState* ts, BrowserHandle browser, uint64_t id) {
+  const uint32_t mask = ts->index_cap - 1;
+  uint32_t i = tab_key_hash(browser, id) & mask;
+  while (ts->index[i] && (ts->ids[ts->index[i] - 1] != id || ts->browsers[ts->index[i] - 1] != browser)) {
+    i = (i + 1) & mask;
   }
+  return i;
+}
 
-  TaskInfo* new_task = malloc(sizeof(TaskInfo));
-  if (new_task) {
-    new_task->task_name = strdup(task_name ? task_name : "Unknown Task");
-    new_task->color = strdup(color ? color : "grey");
-    new_task->external_id = final_id;
-    new_task->next = ts->tasks;
-    ts->tasks = new_task;
+static int tab_index_grow(TabState* ts) {
+  uint32_t new_cap = ts->index_cap ? ts->index_cap * 2 : TAB_INDEX_MIN_CAP;
+  uint32_t* new_index = calloc(new_cap, sizeof(uint32_t));
+  if (!new_index) {
+    vlog(LOG_LEVEL_ERROR, ts, "Failed to grow tab index to %u buckets\n", new_cap);
+    return 0;
   }
+  free(ts->index);
+  ts->index = new_index;
+  ts->index_cap = new_cap;
+  for (uint32_t slot = 0; slot < ts->nb_slots; ++slot) {
+    if (ts->flags[slot] & TAB_FLAG_LIVE)
+      ts->index[tab_index_probe(ts, ts->browsers[slot], ts->ids[slot])] = slot + 1;
+  }
+  return 1;
 }
 
-void task_state_update(TaskState* ts, int64_t external_id, const char* name, const char* color) {
-  TaskInfo* task = task_state_find_by_external_id(ts, external_id);
-  if (task) {
-    if (name) {
-      if (task->task_name)
-        free(task->task_name);
-      task->task_name = strdup(name ? name : "Unknown Task");
-    }
-    if (color) {
-      if (task->color)
-        free(task->color);
-      task->color = strdup(color ? color : "grey");
+// Backward-shift deletion: keeps probe chains intact without tombstones.
+static void tab_index_erase(TabState* ts, uint32_t slot) {
+  if (!ts->index)
+    return;
+  const uint32_t mask = ts->index_cap - 1;
+  uint32_t hole = tab_index_probe(ts, ts->browsers[slot], ts->ids[slot]);
+  if (!ts->index[hole])
+    return;
+  uint32_t i = hole;
+  for (;;) {
+    i = (i + 1) & mask;
+    uint32_t entry = ts->index[i];
+    if (!entry)
+      break;
+    uint32_t home = tab_key_hash(ts->browsers[entry - 1], ts->ids[entry - 1]) & mask;
+    // Move the entry into the hole only if the hole lies on its probe path (home..i, cyclically).
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      ts->index[hole] = entry;
+      hole = i;
     }
   }
+  ts->index[hole] = 0;
 }
 
-int64_t task_state_incorporate_external_group(TaskState* ts,
-                                              int64_t ext_group_id,
-                                              const char* title,
-                                              const char* color) {
-  if (task_state_find_by_external_id(ts, ext_group_id)) {
-    task_state_update(ts, ext_group_id, title, color);
-    return 0;
+#define TAB_TASK_INDEX_MIN_CAP 16
+
+// Returns the bucket holding `task_id`, or the empty bucket where it would be inserted.
+static uint32_t tab_task_probe(const TabState* ts, int64_t task_id) {
+  const uint32_t mask = ts->task_index_cap - 1;
+  uint32_t i = tab_index_hash((uint64_t)task_id) & mask;
+  while (ts->task_index[i].count && ts->task_index[i].task_id != task_id) {
+    i = (i + 1) & mask;
   }
+  return i;
+}
 
-  // If the group doesn't exist yet and has no name, we ignore it for now.
-  // This allows us to wait for a 'rename' event (or initial state with name)
-  // which lets us match against pending local tasks (which always have names).
-  if (!title || title[0] == '\0') {
+static TabTaskBucket* tab_task_find(const TabState* ts, int64_t task_id) {
+  if (!ts->task_index)
+    return NULL;
+  TabTaskBucket* b = &ts->task_index[tab_task_probe(ts, task_id)];
+  return b->count ? b : NULL;
+}
+
+static int tab_task_index_grow(TabState* ts) {
+  uint32_t old_cap = ts->task_index_cap;
+  TabTaskBucket* old = ts->task_index;
+  uint32_t new_cap = old_cap ? old_cap * 2 : TAB_TASK_INDEX_MIN_CAP;
+  TabTaskBucket* grown = calloc(new_cap, sizeof(TabTaskBucket));
+  if (!grown) {
+    vlog(LOG_LEVEL_ERROR, ts, "Failed to grow task index to %u buckets\n", new_cap);
     return 0;
   }
-
-  // Check for unconfirmed task (external_id <= 0) with same name
-  TaskInfo* curr = ts->tasks;
-  while (curr) {
-    if (curr->external_id <= 0) {
-      // Allow matching if both are empty or strings match
-      const char* tname = curr->task_name ? curr->task_name : "";
-      const char* target = title ? title : "";
-
-      if (strcmp(tname, target) == 0) {
-        vlog(LOG_LEVEL_INFO, NULL, "MATCH FOUND! Claiming task %lld for external %lld\n", curr->external_id,
-             ext_group_id);
-        int64_t old_id = curr->external_id;
-        curr->external_id = ext_group_id;
-        return old_id;
-      }
-    }
-    curr = curr->next;
+  ts->task_index = grown;
+  ts->task_index_cap = new_cap;
+  for (uint32_t i = 0; i < old_cap; ++i) {
+    if (old[i].count)
+      ts->task_index[tab_task_probe(ts, old[i].task_id)] = old[i];
   }
+  free(old);
+  return 1;
+}
 
-  vlog(LOG_LEVEL_INFO, NULL, "No match found. Creating new task for external %lld '%s'.\n", ext_group_id, title);
-  task_state_add(ts, title, color, ext_group_id);
-  return 0;
+// Returns the bucket for `task_id`, claiming an empty one (count == 0) if the task has no tabs yet.
+static TabTaskBucket* tab_task_claim(TabState* ts, int64_t task_id) {
+  TabTaskBucket* b = tab_task_find(ts, task_id);
+  if (b)
+    return b;
+  if ((ts->nb_task_buckets + 1) * 4 > ts->task_index_cap * 3 && !tab_task_index_grow(ts))
+    return NULL;
+  b = &ts->task_index[tab_task_probe(ts, task_id)];
+  b->task_id = task_id;
+  b->head = TAB_SLOT_NONE;
+  ts->nb_task_buckets++;
+  return b;
 }
 
-void task_state_remove(TaskState* ts, int64_t external_id) {
-  TaskInfo* current = ts->tasks;
-  TaskInfo* prev = NULL;
-  while (current) {
-    if (current->external_id == external_id) {
-      if (prev) {
-        prev->next = current->next;
-      } else {
-        ts->tasks = current->next;
-      }
-      if (current->task_name)
-        free(current->task_name);
-      if (current->color)
-        free(current->color);
-      free(current);
-      ts->nb_tasks--;
-      return;
+static void tab_task_erase(TabState* ts, TabTaskBucket* b) {
+  const uint32_t mask = ts->task_index_cap - 1;
+  uint32_t hole = (uint32_t)(b - ts->task_index);
+  uint32_t i = hole;
+  for (;;) {
+    i = (i + 1) & mask;
+    if (!ts->task_index[i].count)
+      break;
+    uint32_t home = tab_index_hash((uint64_t)ts->task_index[i].task_id) & mask;
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      ts->task_index[hole] = ts->task_index[i];
+      hole = i;
     }
-    prev = current;
-    current = current->next;
   }
+  ts->task_index[hole].count = 0;
+  ts->nb_task_buckets--;
 }
 
-void tab_event__handle_all_tabs(EngineContext* ec, const cJSON* json_data, void* per_session_data) {
-  (void)per_session_data;
-  TabState* ts = ec->tab_state;
-  TaskState* tks = ec->task_state;
-  cJSON* data = cJSON_GetObjectItem(json_data, "data");
-  if (!data) {
-    vlog(LOG_LEVEL_WARN, ts, "onAllTabs: 'data' key missing.\n");
+static void tab_task_link(TabState* ts, uint32_t slot) {
+  TabTaskBucket* b = tab_task_claim(ts, ts->task_ids[slot]);
+  ts->task_prev[slot] = TAB_SLOT_NONE;
+  ts->task_next[slot] = TAB_SLOT_NONE;
+  if (!b)
     return;
-  }
+  ts->task_next[slot] = b->head;
+  if (b->head != TAB_SLOT_NONE)
+    ts->task_prev[b->head] = slot;
+  b->head = slot;
+  b->count++;
+  ts->members_version++;
+}
 
-  cJSON* tabs_json = NULL;
-  cJSON* groups_json = NULL;
+static void tab_task_unlink(TabState* ts, uint32_t slot) {
+  TabTaskBucket* b = tab_task_find(ts, ts->task_ids[slot]);
+  if (!b)
+    return;
+  uint32_t prev = ts->task_prev[slot];
+  uint32_t next = ts->task_next[slot];
+  if (prev != TAB_SLOT_NONE)
+    ts->task_next[prev] = next;
+  else
+    b->head = next;
+  if (next != TAB_SLOT_NONE)
+    ts->task_prev[next] = prev;
+  if (--b->count == 0)
+    tab_task_erase(ts, b);
+  ts->members_version++;
+}
 
-  if (cJSON_IsArray(data)) {
-    // Legacy format: 'data' is the array of tabs
-    tabs_json = data;
+// Bumps the version for a change to `slot`'s record.
+static inline void tab_slot_touch(TabState* ts, uint32_t slot) {
+  ts->stamps[slot] = ++ts->version;
+}
+
+static void tab_slot_set_task(TabState* ts, uint32_t slot, int64_t task_id) {
+  if (ts->task_ids[slot] == task_id)
+    return;
+  tab_task_unlink(ts, slot);
+  ts->task_ids[slot] = task_id;
+  tab_task_link(ts, slot);
+  tab_slot_touch(ts, slot);
+}
+
+#define TAB_STORE_GROW_COLUMN(ts, column, new_cap)                                  \
+  do {                                                                              \
+    void* grown = realloc((ts)->column, (size_t)(new_cap) * sizeof(*(ts)->column)); \
+    if (!grown)                                                                     \
+      return 0;                                                                     \
+    (ts)->column = grown;                                                           \
+  } while (0)
+
+static int tab_store_grow(TabState* ts) {
+  uint32_t new_cap = ts->cap ? ts->cap * 2 : TAB_STORE_MIN_CAP;
+  if (new_cap > TAB_MAX_SLOTS)
+    new_cap = TAB_MAX_SLOTS;
+  if (new_cap <= ts->cap)
+    return 0;
+  TAB_STORE_GROW_COLUMN(ts, ids, new_cap);
+  TAB_STORE_GROW_COLUMN(ts, stamps, new_cap);
+  TAB_STORE_GROW_COLUMN(ts, task_ids, new_cap);
+  TAB_STORE_GROW_COLUMN(ts, flags, new_cap);
+  TAB_STORE_GROW_COLUMN(ts, gens, new_cap);
+  TAB_STORE_GROW_COLUMN(ts, titles, new_cap);
+  TAB_STORE_GROW_COLUMN(ts, browsers, new_cap);
+  TAB_STORE_GROW_COLUMN(ts, window_ids, new_cap);
+  TAB_STORE_GROW_COLUMN(ts, pos_left, new_cap);
+  TAB_STORE_GROW_COLUMN(ts, pos_right, new_cap);
+  TAB_STORE_GROW_COLUMN(ts, pos_parent, new_cap);
+  TAB_STORE_GROW_COLUMN(ts, pos_size, new_cap);
+  TAB_STORE_GROW_COLUMN(ts, pos_prio, new_cap);
+  TAB_STORE_GROW_COLUMN(ts, task_next, new_cap);
+  TAB_STORE_GROW_COLUMN(ts, task_prev, new_cap);
+  TAB_STORE_GROW_COLUMN(ts, free_slots, new_cap);
+  ts->cap = new_cap;
+  return 1;
+}
+
+static uint32_t tab_store_take_slot(TabState* ts) {
+  if (ts->nb_free > 0)
+    return ts->free_slots[--ts->nb_free];
+  if (ts->nb_slots == ts->cap && !tab_store_grow(ts)) {
+    vlog(LOG_LEVEL_ERROR, ts, "Failed to grow tab store beyond %u slots\n", ts->cap);
+    return UINT32_MAX;
+  }
+  uint32_t slot = ts->nb_slots++;
+  ts->gens[slot] = 0;
+  ts->flags[slot] = 0;
+  return slot;
+}
+
+static inline uint32_t tab_pos_size(const TabState* ts, uint32_t n) {
+  return n == TAB_SLOT_NONE ? 0 : ts->pos_size[n];
+}
+
+static void tab_pos_pull(TabState* ts, uint32_t n) {
+  uint32_t l = ts->pos_left[n], r = ts->pos_right[n];
+  ts->pos_size[n] = 1 + tab_pos_size(ts, l) + tab_pos_size(ts, r);
+  if (l != TAB_SLOT_NONE)
+    ts->pos_parent[l] = n;
+  if (r != TAB_SLOT_NONE)
+    ts->pos_parent[r] = n;
+}
+
+// Concatenates the tabs of `a` and then those of `b`.
+static uint32_t tab_pos_merge(TabState* ts, uint32_t a, uint32_t b) {
+  if (a == TAB_SLOT_NONE)
+    return b;
+  if (b == TAB_SLOT_NONE)
+    return a;
+  if (ts->pos_prio[a] > ts->pos_prio[b]) {
+    ts->pos_right[a] = tab_pos_merge(ts, ts->pos_right[a], b);
+    tab_pos_pull(ts, a);
+    return a;
+  }
+  ts->pos_left[b] = tab_pos_merge(ts, a, ts->pos_left[b]);
+  tab_pos_pull(ts, b);
+  return b;
+}
+
+// Splits `n` into its first `k` tabs (*l) and the rest (*r).
+static void tab_pos_split(TabState* ts, uint32_t n, uint32_t k, uint32_t* l, uint32_t* r) {
+  if (n == TAB_SLOT_NONE) {
+    *l = *r = TAB_SLOT_NONE;
+    return;
+  }
+  uint32_t left_size = tab_pos_size(ts, ts->pos_left[n]);
+  if (k <= left_size) {
+    uint32_t left = ts->pos_left[n];
+    tab_pos_split(ts, left, k, l, &left);
+    ts->pos_left[n] = left;
+    *r = n;
+  } else {
+    uint32_t right = ts->pos_right[n];
+    tab_pos_split(ts, right, k - left_size - 1, &right, r);
+    ts->pos_right[n] = right;
+    *l = n;
+  }
+  tab_pos_pull(ts, n);
+}
+
+static uint32_t tab_pos_index(const TabState* ts, uint32_t n) {
+  uint32_t index = tab_pos_size(ts, ts->pos_left[n]);
+  for (uint32_t p = ts->pos_parent[n]; p != TAB_SLOT_NONE; n = p, p = ts->pos_parent[p]) {
+    if (ts->pos_right[p] == n)
+      index += tab_pos_size(ts, ts->pos_left[p]) + 1;
+  }
+  return index;
+}
+
+static uint32_t tab_pos_leftmost(const TabState* ts, uint32_t n) {
+  while (n != TAB_SLOT_NONE && ts->pos_left[n] != TAB_SLOT_NONE)
+    n = ts->pos_left[n];
+  return n;
+}
+
+static uint32_t tab_pos_successor(const TabState* ts, uint32_t n) {
+  if (ts->pos_right[n] != TAB_SLOT_NONE)
+    return tab_pos_leftmost(ts, ts->pos_right[n]);
+  uint32_t p = ts->pos_parent[n];
+  while (p != TAB_SLOT_NONE && ts->pos_right[p] == n) {
+    n = p;
+    p = ts->pos_parent[p];
+  }
+  return p;
+}
+
+static TabWindow* tab_window_find(TabState* ts, BrowserHandle browser, int64_t window_id) {
+  for (uint32_t w = 0; w < ts->nb_windows; ++w) {
+    if (ts->windows[w].window_id == window_id && ts->windows[w].browser == browser)
+      return &ts->windows[w];
+  }
+  return NULL;
+}
+
+static TabWindow* tab_window_get(TabState* ts, BrowserHandle browser, int64_t window_id) {
+  TabWindow* window = tab_window_find(ts, browser, window_id);
+  if (window)
+    return window;
+  if (ts->nb_windows == ts->windows_cap) {
+    uint32_t cap = ts->windows_cap ? ts->windows_cap * 2 : 4;
+    TabWindow* windows = realloc(ts->windows, cap * sizeof(TabWindow));
+    if (!windows) {
+      vlog(LOG_LEVEL_ERROR, ts, "Failed to track window %lld\n", window_id);
+      return NULL;
+    }
+    ts->windows = windows;
+    ts->windows_cap = cap;
+  }
+  window = &ts->windows[ts->nb_windows++];
+  window->window_id = window_id;
+  window->browser = browser;
+  window->root = TAB_SLOT_NONE;
+  return window;
+}
+
+// Takes `slot` out of its window's strip. The window is forgotten once empty.
+static void tab_slot_unplace(TabState* ts, uint32_t slot) {
+  if (ts->window_ids[slot] == TAB_WINDOW_NONE)
+    return;
+  TabWindow* window = tab_window_find(ts, ts->browsers[slot], ts->window_ids[slot]);
+  ts->window_ids[slot] = TAB_WINDOW_NONE;
+  if (!window)
+    return;
+  uint32_t before, rest, self;
+  tab_pos_split(ts, window->root, tab_pos_index(ts, slot), &before, &rest);
+  tab_pos_split(ts, rest, 1, &self, &rest);
+  window->root = tab_pos_merge(ts, before, rest);
+  if (window->root != TAB_SLOT_NONE) {
+    ts->pos_parent[window->root] = TAB_SLOT_NONE;
+  } else {
+    *window = ts->windows[--ts->nb_windows];
+  }
+  ts->version++;
+}
+
+static void tab_slot_place(TabState* ts, uint32_t slot, int64_t window_id, uint32_t index) {
+  // Every snapshot places every tab, mostly where it already is; that is no change to the state.
+  if (ts->window_ids[slot] == window_id && (window_id == TAB_WINDOW_NONE || tab_pos_index(ts, slot) == index))
+    return;
+  tab_slot_unplace(ts, slot);
+  if (window_id == TAB_WINDOW_NONE)
+    return;
+  TabWindow* window = tab_window_get(ts, ts->browsers[slot], window_id);
+  if (!window)
+    return;
+  ts->pos_left[slot] = ts->pos_right[slot] = ts->pos_parent[slot] = TAB_SLOT_NONE;
+  ts->pos_size[slot] = 1;
+  ts->pos_prio[slot] = tab_index_hash(++ts->pos_seed);
+  ts->window_ids[slot] = window_id;
+  uint32_t size = tab_pos_size(ts, window->root);
+  uint32_t before, after;
+  tab_pos_split(ts, window->root, index < size ? index : size, &before, &after);
+  window->root = tab_pos_merge(ts, tab_pos_merge(ts, before, slot), after);
+  ts->pos_parent[window->root] = TAB_SLOT_NONE;
+  ts->version++;
+}
+
+void tab_state_place_tab(TabState* ts, TabHandle h, int64_t window_id, uint32_t index) {
+  h = tab_state_resolve(ts, h);
+  if (h != TAB_HANDLE_INVALID)
+    tab_slot_place(ts, tab_handle_slot(h), window_id, index);
+}
+
+uint32_t tab_state_tab_index(const TabState* ts, TabHandle h) {
+  h = tab_state_resolve(ts, h);
+  if (h == TAB_HANDLE_INVALID || ts->window_ids[tab_handle_slot(h)] == TAB_WINDOW_NONE)
+    return UINT32_MAX;
+  return tab_pos_index(ts, tab_handle_slot(h));
+}
+
+// Unplaced tabs follow the windows, scanned newest slot first.
+static uint32_t tab_order_unplaced(const TabState* ts, TabOrderCursor* cur) {
+  while (cur->slot-- > 0) {
+    if ((ts->flags[cur->slot] & TAB_FLAG_LIVE) && ts->window_ids[cur->slot] == TAB_WINDOW_NONE)
+      return cur->slot;
+  }
+  cur->slot = 0;
+  return TAB_SLOT_NONE;
+}
+
+uint32_t tab_state_order_begin(const TabState* ts, TabOrderCursor* cur) {
+  cur->window = 0;
+  if (ts->nb_windows > 0) {
+    cur->slot = tab_pos_leftmost(ts, ts->windows[0].root);
+    return cur->slot;
+  }
+  cur->slot = ts->nb_slots;
+  return tab_order_unplaced(ts, cur);
+}
+
+uint32_t tab_state_order_next(const TabState* ts, TabOrderCursor* cur) {
+  if (cur->window >= ts->nb_windows)
+    return tab_order_unplaced(ts, cur);
+  cur->slot = tab_pos_successor(ts, cur->slot);
+  if (cur->slot != TAB_SLOT_NONE)
+    return cur->slot;
+  if (++cur->window < ts->nb_windows) {
+    cur->slot = tab_pos_leftmost(ts, ts->windows[cur->window].root);
+    return cur->slot;
+  }
+  cur->slot = ts->nb_slots;
+  return tab_order_unplaced(ts, cur);
+}
+
+BrowserHandle tab_state_intern_browser(TabState* ts, const char* browser_id) {
+  if (!browser_id)
+    return TAB_BROWSER_NONE;
+  // Every pooled string is a registered browser, so a pool miss means a new browser.
+  const char* pooled = intern_table_lookup(&ts->strings, browser_id);
+  if (pooled) {
+    for (uint32_t b = 1; b < ts->nb_browsers; ++b) {
+      if (ts->browser_names[b] == pooled)
+        return (BrowserHandle)b;
+    }
+  }
+  uint32_t b = ts->nb_browsers ? ts->nb_browsers : 1;
+  if (b > TAB_MAX_BROWSERS) {
+    vlog(LOG_LEVEL_ERROR, ts, "Too many browsers registered, treating %s as unknown\n", browser_id);
+    return TAB_BROWSER_NONE;
+  }
+  const char** names = realloc(ts->browser_names, (b + 1) * sizeof(*names));
+  if (!names)
+    return TAB_BROWSER_NONE;
+  names[0] = NULL;
+  names[b] = intern_table_acquire(&ts->strings, browser_id);
+  ts->browser_names = names;
+  ts->nb_browsers = b + 1;
+  vlog(LOG_LEVEL_INFO, ts, "Registered browser %s as #%u\n", browser_id, b);
+  return (BrowserHandle)b;
+}
+
+const char* tab_state_browser_id(const TabState* ts, BrowserHandle browser) {
+  return browser != TAB_BROWSER_NONE && browser < ts->nb_browsers ? ts->browser_names[browser] : NULL;
+}
+
+static TabHandle tab_key_find(const TabState* ts, BrowserHandle browser, uint64_t id) {
+  if (!ts->index)
+    return TAB_HANDLE_INVALID;
+  uint32_t entry = ts->index[tab_index_probe(ts, browser, id)];
+  return entry ? tab_make_handle(ts, entry - 1) : TAB_HANDLE_INVALID;
+}
+
+TabHandle tab_state_find_tab(TabState* ts, const uint64_t id) {
+  assert(ts);
+  TabHandle h = tab_key_find(ts, TAB_BROWSER_NONE, id);
+  for (uint32_t b = 1; h == TAB_HANDLE_INVALID && b < ts->nb_browsers; ++b) {
+    h = tab_key_find(ts, (BrowserHandle)b, id);
+  }
+  return h;
+}
+
+// Moves a tab under another browser's key, keeping its place in the (now that browser's) window.
+static void tab_slot_rekey(TabState* ts, uint32_t slot, BrowserHandle browser) {
+  int64_t window_id = ts->window_ids[slot];
+  uint32_t index = window_id != TAB_WINDOW_NONE ? tab_pos_index(ts, slot) : 0;
+  tab_slot_unplace(ts, slot);
+  tab_index_erase(ts, slot);
+  ts->browsers[slot] = browser;
+  ts->index[tab_index_probe(ts, browser, ts->ids[slot])] = slot + 1;
+  tab_slot_place(ts, slot, window_id, index);
+  ts->version++;
+}
+
+// Resolves the tab an event from `browser` refers to. Events from an unknown browser match any
+// browser's tab with that id. A tab stored before its browser was known is adopted by the first
+// browser to name it.
+static TabHandle tab_state_match(TabState* ts, BrowserHandle browser, uint64_t id) {
+  TabHandle h = tab_key_find(ts, browser, id);
+  if (h != TAB_HANDLE_INVALID)
+    return h;
+  if (browser == TAB_BROWSER_NONE)
+    return tab_state_find_tab(ts, id);
+  h = tab_key_find(ts, TAB_BROWSER_NONE, id);
+  if (h != TAB_HANDLE_INVALID)
+    tab_slot_rekey(ts, tab_handle_slot(h), browser);
+  return h;
+}
+
+// Like tab_state_intern_browser() but never registers; unknown browsers map to TAB_BROWSER_NONE.
+static BrowserHandle tab_browser_lookup(const TabState* ts, const char* browser_id) {
+  const char* pooled = browser_id ? intern_table_lookup(&ts->strings, browser_id) : NULL;
+  for (uint32_t b = 1; pooled && b < ts->nb_browsers; ++b) {
+    if (ts->browser_names[b] == pooled)
+      return (BrowserHandle)b;
+  }
+  return TAB_BROWSER_NONE;
+}
+
+TabHandle tab_state_find_browser_tab(TabState* ts, const char* browser_id, const uint64_t id) {
+  assert(ts);
+  if (!browser_id)
+    return tab_state_find_tab(ts, id);
+  // An unknown browser can only own tabs that no browser has adopted yet.
+  BrowserHandle browser = tab_browser_lookup(ts, browser_id);
+  TabHandle h = browser != TAB_BROWSER_NONE ? tab_key_find(ts, browser, id) : TAB_HANDLE_INVALID;
+  return h != TAB_HANDLE_INVALID ? h : tab_key_find(ts, TAB_BROWSER_NONE, id);
+}
+
+static void tab_slot_update(TabState* ts, uint32_t slot, const char* title, int64_t task_id) {
+  if (ts->titles[slot] && strcmp(title, ts->titles[slot]) != 0) {
+    free(ts->titles[slot]);
+    ts->titles[slot] = strdup(title);
+    tab_slot_touch(ts, slot);
+  }
+  tab_slot_set_task(ts, slot, task_id);
+}
+
+void tab_state_update_tab(TabState* ts, const char* title, const uint64_t id, int64_t task_id, const char* browser_id) {
+  TabHandle h = tab_state_match(ts, tab_state_intern_browser(ts, browser_id), id);
+  if (h != TAB_HANDLE_INVALID)
+    tab_slot_update(ts, tab_handle_slot(h), title, task_id);
+}
+
+TabHandle tab_state_add_tab(TabState* ts, const char* title, const uint64_t id, int64_t task_id, const char* browser_id) {
+  BrowserHandle browser = tab_state_intern_browser(ts, browser_id);
+  TabHandle existing = tab_state_match(ts, browser, id);
+  if (existing != TAB_HANDLE_INVALID) {
+    // Keys are unique in the index; a repeated create (e.g. TabCreated racing AllTabs) is an update.
+    tab_slot_update(ts, tab_handle_slot(existing), title, task_id);
+    return existing;
+  }
+  if (((uint64_t)ts->nb_tabs + 1) * 4 > (uint64_t)ts->index_cap * 3 && !tab_index_grow(ts))
+    return TAB_HANDLE_INVALID;
+  uint32_t slot = tab_store_take_slot(ts);
+  if (slot == UINT32_MAX)
+    return TAB_HANDLE_INVALID;
+
+  ts->ids[slot] = id;
+  ts->browsers[slot] = browser;
+  ts->window_ids[slot] = TAB_WINDOW_NONE;
+  ts->task_ids[slot] = task_id;
+  ts->flags[slot] = TAB_FLAG_LIVE;
+  ts->titles[slot] = strdup(title);
+  ts->index[tab_index_probe(ts, browser, id)] = slot + 1;
+  tab_task_link(ts, slot);
+  ts->nb_tabs++;
+  tab_slot_touch(ts, slot);
+  return tab_make_handle(ts, slot);
+}
+
+static void tab_slot_remove(TabState* ts, uint32_t slot) {
+  tab_slot_unplace(ts, slot);
+  tab_index_erase(ts, slot);
+  tab_task_unlink(ts, slot);
+  free(ts->titles[slot]);
+  ts->titles[slot] = NULL;
+  ts->flags[slot] = 0;
+  ts->gens[slot] = (ts->gens[slot] + 1) & ((1u << (32 - TAB_SLOT_BITS)) - 1);
+  ts->free_slots[ts->nb_free++] = slot;
+  ts->nb_tabs--;
+  ts->version++;
+}
+
+void tab_state_remove_tab(TabState* ts, const uint64_t id, const char* browser_id) {
+  TabHandle h = tab_state_find_browser_tab(ts, browser_id, id);
+  if (h != TAB_HANDLE_INVALID)
+    tab_slot_remove(ts, tab_handle_slot(h));
+}
+
+void tab_state_replace_tab_id(TabState* ts, const char* browser_id, uint64_t old_id, uint64_t new_id) {
+  TabHandle h = tab_state_find_browser_tab(ts, browser_id, old_id);
+  if (h == TAB_HANDLE_INVALID || old_id == new_id)
+    return;
+  uint32_t slot = tab_handle_slot(h);
+  // The replacement may have been reported on its own already; the replaced tab keeps its place.
+  TabHandle dup = tab_key_find(ts, ts->browsers[slot], new_id);
+  if (dup != TAB_HANDLE_INVALID)
+    tab_slot_remove(ts, tab_handle_slot(dup));
+  tab_index_erase(ts, slot);
+  ts->ids[slot] = new_id;
+  ts->index[tab_index_probe(ts, ts->browsers[slot], new_id)] = slot + 1;
+  tab_slot_touch(ts, slot);
+}
+
+static int tab_active_reserve(TabState* ts, uint32_t cap) {
+  TabHandle* active = realloc(ts->active, cap * sizeof(TabHandle));
+  if (!active)
+    goto oom;
+  ts->active = active;
+  TabHandle* scratch = realloc(ts->active_scratch, cap * sizeof(TabHandle));
+  if (!scratch)
+    goto oom;
+  ts->active_scratch = scratch;
+  ts->active_cap = cap;
+  return 1;
+oom:
+  vlog(LOG_LEVEL_ERROR, ts, "Failed to reserve %u active tab entries\n", cap);
+  return 0;
+}
+
+void tab_state_set_task(TabState* ts, TabHandle h, int64_t task_id) {
+  h = tab_state_resolve(ts, h);
+  if (h != TAB_HANDLE_INVALID)
+    tab_slot_set_task(ts, tab_handle_slot(h), task_id);
+}
+
+void tab_state_retarget_task(TabState* ts, int64_t old_task_id, int64_t new_task_id) {
+  TabTaskBucket* from = tab_task_find(ts, old_task_id);
+  if (!from || old_task_id == new_task_id)
+    return;
+  uint32_t head = from->head;
+  uint32_t count = from->count;
+  tab_task_erase(ts, from);
+  ts->version++;
+  ts->members_version++;
+
+  uint32_t tail = TAB_SLOT_NONE;
+  for (uint32_t slot = head; slot != TAB_SLOT_NONE; slot = ts->task_next[slot]) {
+    ts->task_ids[slot] = new_task_id;
+    ts->stamps[slot] = ts->version;
+    tail = slot;
+  }
+  // Splice the whole member list in front of the target's.
+  TabTaskBucket* to = tab_task_claim(ts, new_task_id);
+  if (!to) {
+    for (uint32_t slot = head; slot != TAB_SLOT_NONE;) {
+      uint32_t next = ts->task_next[slot];
+      ts->task_next[slot] = ts->task_prev[slot] = TAB_SLOT_NONE;
+      slot = next;
+    }
+    return;
+  }
+  ts->task_next[tail] = to->head;
+  if (to->head != TAB_SLOT_NONE)
+    ts->task_prev[to->head] = tail;
+  to->head = head;
+  to->count += count;
+}
+
+uint32_t tab_state_task_count(const TabState* ts, int64_t task_id) {
+  const TabTaskBucket* b = tab_task_find(ts, task_id);
+  return b ? b->count : 0;
+}
+
+#define TASK_INDEX_MIN_CAP 16
+
+// Keys of the two TaskState indexes: by_id hashes the external id, pending the interned name pointer.
+typedef uint64_t (*TaskKeyFn)(const TaskInfo* t);
+
+static uint64_t task_id_key(const TaskInfo* t) {
+  return (uint64_t)t->external_id;
+}
+
+static uint64_t task_name_key(const TaskInfo* t) {
+  return (uint64_t)(uintptr_t)t->task_name;
+}
+
+// Returns the bucket holding `key`, or the empty bucket where it would be inserted.
+static uint32_t task_index_probe(const TaskIndex* ix, TaskKeyFn key_of, uint64_t key) {
+  const uint32_t mask = ix->cap - 1;
+  uint32_t i = tab_index_hash(key) & mask;
+  while (ix->buckets[i] && key_of(ix->buckets[i]) != key) {
+    i = (i + 1) & mask;
+  }
+  return i;
+}
+
+static TaskInfo* task_index_find(const TaskIndex* ix, TaskKeyFn key_of, uint64_t key) {
+  if (!ix->buckets)
+    return NULL;
+  return ix->buckets[task_index_probe(ix, key_of, key)];
+}
+
+static int task_index_grow(TaskIndex* ix, TaskKeyFn key_of) {
+  uint32_t old_cap = ix->cap;
+  TaskInfo** old = ix->buckets;
+  uint32_t new_cap = old_cap ? old_cap * 2 : TASK_INDEX_MIN_CAP;
+  TaskInfo** grown = calloc(new_cap, sizeof(TaskInfo*));
+  if (!grown) {
+    vlog(LOG_LEVEL_ERROR, NULL, "Failed to grow task index to %u buckets\n", new_cap);
+    return 0;
+  }
+  ix->buckets = grown;
+  ix->cap = new_cap;
+  for (uint32_t i = 0; i < old_cap; ++i) {
+    if (old[i])
+      ix->buckets[task_index_probe(ix, key_of, key_of(old[i]))] = old[i];
+  }
+  free(old);
+  return 1;
+}
+
+// Stores `t` under its key, replacing whatever entry held that key.
+static int task_index_put(TaskIndex* ix, TaskKeyFn key_of, TaskInfo* t) {
+  if (ix->buckets) {
+    uint32_t i = task_index_probe(ix, key_of, key_of(t));
+    if (ix->buckets[i]) {
+      ix->buckets[i] = t;
+      return 1;
+    }
+  }
+  if ((ix->count + 1) * 4 > ix->cap * 3 && !task_index_grow(ix, key_of))
+    return 0;
+  ix->buckets[task_index_probe(ix, key_of, key_of(t))] = t;
+  ix->count++;
+  return 1;
+}
+
+// Backward-shift deletion of the entry under `key`, as tab_index_erase().
+static void task_index_erase(TaskIndex* ix, TaskKeyFn key_of, uint64_t key) {
+  if (!ix->buckets)
+    return;
+  const uint32_t mask = ix->cap - 1;
+  uint32_t hole = task_index_probe(ix, key_of, key);
+  if (!ix->buckets[hole])
+    return;
+  uint32_t i = hole;
+  for (;;) {
+    i = (i + 1) & mask;
+    TaskInfo* entry = ix->buckets[i];
+    if (!entry)
+      break;
+    uint32_t home = tab_index_hash(key_of(entry)) & mask;
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      ix->buckets[hole] = entry;
+      hole = i;
+    }
+  }
+  ix->buckets[hole] = NULL;
+  ix->count--;
+}
+
+static void task_pending_link(TaskState* ts, TaskInfo* t) {
+  TaskInfo* head = task_index_find(&ts->pending, task_name_key, task_name_key(t));
+  t->pending_prev = NULL;
+  t->pending_next = head;
+  if (!task_index_put(&ts->pending, task_name_key, t)) {
+    // Without a bucket the task can never be claimed by name; it stays a local-only task.
+    t->pending_next = NULL;
+    return;
+  }
+  if (head)
+    head->pending_prev = t;
+}
+
+static void task_pending_unlink(TaskState* ts, TaskInfo* t) {
+  if (t->pending_prev) {
+    t->pending_prev->pending_next = t->pending_next;
+  } else if (task_index_find(&ts->pending, task_name_key, task_name_key(t)) == t) {
+    if (t->pending_next)
+      task_index_put(&ts->pending, task_name_key, t->pending_next);
+    else
+      task_index_erase(&ts->pending, task_name_key, task_name_key(t));
+  }
+  if (t->pending_next)
+    t->pending_next->pending_prev = t->pending_prev;
+  t->pending_next = NULL;
+  t->pending_prev = NULL;
+}
+
+// Gives `t` a new id in place.
+static void task_state_rekey(TaskState* ts, TaskInfo* t, int64_t external_id) {
+  if (t->external_id < 0)
+    task_pending_unlink(ts, t);
+  task_index_erase(&ts->by_id, task_id_key, (uint64_t)t->external_id);
+  t->external_id = external_id;
+  task_index_put(&ts->by_id, task_id_key, t);
+  ts->version++;
+}
+
+TaskInfo* task_state_find_by_external_id(TaskState* ts, int64_t external_id) {
+  assert(ts);
+  if (external_id < 0)
+    return NULL;
+  return task_index_find(&ts->by_id, task_id_key, (uint64_t)external_id);
+}
+
+TaskInfo* task_state_add(TaskState* ts, const char* task_name, const char* color, int64_t external_id) {
+  int64_t final_id = external_id;
+  if (external_id == -1)
+    final_id = -2 - (int64_t)ts->nb_local_ids++;
+
+  TaskInfo* new_task = calloc(1, sizeof(TaskInfo));
+  if (!new_task)
+    return NULL;
+  new_task->task_name = intern_table_acquire(&ts->strings, task_name ? task_name : "Unknown Task");
+  new_task->color = intern_table_acquire(&ts->strings, color ? color : "grey");
+  new_task->external_id = final_id;
+  if (!task_index_put(&ts->by_id, task_id_key, new_task)) {
+    intern_table_release(&ts->strings, new_task->task_name);
+    intern_table_release(&ts->strings, new_task->color);
+    free(new_task);
+    return NULL;
+  }
+  if (final_id < 0 && new_task->task_name)
+    task_pending_link(ts, new_task);
+  new_task->next = ts->tasks;
+  if (ts->tasks)
+    ts->tasks->prev = new_task;
+  ts->tasks = new_task;
+  ts->nb_tasks++;
+  ts->version++;
+  return new_task;
+}
+
+void task_state_update(TaskState* ts, int64_t external_id, const char* name, const char* color) {
+  TaskInfo* task = task_state_find_by_external_id(ts, external_id);
+  if (task) {
+    const char* prev_name = task->task_name;
+    const char* prev_color = task->color;
+    if (name)
+      intern_table_assign(&ts->strings, &task->task_name, name);
+    if (color)
+      intern_table_assign(&ts->strings, &task->color, color);
+    if (task->task_name != prev_name || task->color != prev_color)
+      ts->version++;
+  }
+}
+
+int64_t task_state_incorporate_external_group(TaskState* ts,
+                                              int64_t ext_group_id,
+                                              const char* title,
+                                              const char* color) {
+  if (task_state_find_by_external_id(ts, ext_group_id)) {
+    task_state_update(ts, ext_group_id, title, color);
+    return 0;
+  }
+
+  // If the group doesn't exist yet and has no name, we ignore it for now.
+  // This allows us to wait for a 'rename' event (or initial state with name)
+  // which lets us match against pending local tasks (which always have names).
+  if (!title || title[0] == '\0') {
+    return 0;
+  }
+
+  // Claim the newest unconfirmed task with the same name. Task names are interned, so a title that is
+  // not in the pool cannot match any task and a pooled one is looked up by pointer.
+  const char* pooled_title = intern_table_lookup(&ts->strings, title);
+  TaskInfo* claimed =
+      pooled_title ? task_index_find(&ts->pending, task_name_key, (uint64_t)(uintptr_t)pooled_title) : NULL;
+  if (claimed) {
+    vlog(LOG_LEVEL_INFO, NULL, "MATCH FOUND! Claiming task %lld for external %lld\n", claimed->external_id,
+         ext_group_id);
+    int64_t old_id = claimed->external_id;
+    task_state_rekey(ts, claimed, ext_group_id);
+    return old_id;
+  }
+
+  vlog(LOG_LEVEL_INFO, NULL, "No match found. Creating new task for external %lld '%s'.\n", ext_group_id, title);
+  task_state_add(ts, title, color, ext_group_id);
+  return 0;
+}
+
+void task_state_await_group(TaskState* ts, TaskInfo* t) {
+  if (t->external_id < 0)
+    task_pending_unlink(ts, t);
+}
+
+int64_t task_state_bind_group(TaskState* ts,
+                              int64_t request_id,
+                              int64_t ext_group_id,
+                              const char* title,
+                              const char* color) {
+  TaskInfo* local = request_id < 0 ? task_index_find(&ts->by_id, task_id_key, (uint64_t)request_id) : NULL;
+  TaskInfo* bound = task_state_find_by_external_id(ts, ext_group_id);
+  if (!local) {
+    // Another browser's share of the same request, or a task removed while the request was in flight.
+    if (bound)
+      task_state_update(ts, ext_group_id, title, color);
+    else
+      task_state_add(ts, title, color, ext_group_id);
+    return 0;
+  }
+  if (bound) {
+    // The group's own events got here first and created its task; fold the local task into it.
+    task_state_remove(ts, request_id);
+  } else {
+    task_state_rekey(ts, local, ext_group_id);
+  }
+  task_state_update(ts, ext_group_id, title, color);
+  return request_id;
+}
+
+void task_state_remove(TaskState* ts, int64_t external_id) {
+  TaskInfo* current = task_index_find(&ts->by_id, task_id_key, (uint64_t)external_id);
+  if (!current)
+    return;
+  task_index_erase(&ts->by_id, task_id_key, (uint64_t)external_id);
+  if (current->external_id < 0)
+    task_pending_unlink(ts, current);
+  if (current->prev)
+    current->prev->next = current->next;
+  else
+    ts->tasks = current->next;
+  if (current->next)
+    current->next->prev = current->prev;
+  intern_table_release(&ts->strings, current->task_name);
+  intern_table_release(&ts->strings, current->color);
+  free(current);
+  ts->nb_tasks--;
+  ts->version++;
+}
+
+// The browser an extension event speaks for: `item`'s own browserId, else the envelope's, else the
+// one the session registered with.
+static const char* tab_event_browser_id(const cJSON* json_data, const cJSON* item, const PerSessionData* pss) {
+  cJSON* bid_json = item ? cJSON_GetObjectItemCaseSensitive(item, "browserId") : NULL;
+  if (!cJSON_IsString(bid_json) || !bid_json->valuestring)
+    bid_json = cJSON_GetObjectItemCaseSensitive(json_data, "browserId");
+  if (cJSON_IsString(bid_json) && bid_json->valuestring)
+    return bid_json->valuestring;
+  return pss ? pss->browser_id : NULL;
+}
+
+// Places `h` at obj[index_key] of window obj[window_key] when the event carries both.
+static void tab_event_place(TabState* ts, TabHandle h, const cJSON* obj, const char* window_key,
+                            const char* index_key) {
+  cJSON* index_json = cJSON_GetObjectItemCaseSensitive(obj, index_key);
+  int64_t window_id;
+  if (h == TAB_HANDLE_INVALID || !json_id_get(cJSON_GetObjectItemCaseSensitive(obj, window_key), &window_id) ||
+      !cJSON_IsNumber(index_json) || index_json->valuedouble < 0)
+    return;
+  tab_state_place_tab(ts, h, window_id, (uint32_t)index_json->valuedouble);
+}
+
+// One tab of an AllTabsInfoResponse, decoded from either the cJSON tree or the streaming scanner.
+typedef struct TabSnapshotItem {
+  const char* title;       // NULL if absent.
+  const char* browser_id;  // The item's own browserId, NULL if absent.
+  uint64_t id;
+  int64_t group_id;
+  int64_t window_id;
+  double index;
+  uint8_t has_group;
+  uint8_t has_window;
+  uint8_t has_index;
+} TabSnapshotItem;
+
+// Mark-and-sweep bookkeeping of one AllTabsInfoResponse.
+typedef struct TabSnapshot {
+  // The snapshot is complete for the sending browser: every tab it lists is marked, then that browser's
+  // unmarked tabs are swept. Tabs whose browser is not known yet (e.g. from TabCreated) count as the
+  // sender's too.
+  const char* sender;
+  int added, updated, unchanged, removed;
+} TabSnapshot;
+
+static void tab_snapshot_group(EngineContext* ec, int64_t external_id, const char* title, const char* color) {
+  if (!title || !title[0])
+    title = "Browser Group";
+  if (!color)
+    color = "grey";
+  int64_t claimed_id = task_state_incorporate_external_group(ec->task_state, external_id, title, color);
+  if (claimed_id != 0) {
+    // Tabs not in this snapshot (e.g. from another browser) may still point at the local id.
+    tab_state_retarget_task(ec->tab_state, claimed_id, external_id);
+  }
+}
+
+static void tab_snapshot_tab(EngineContext* ec, TabSnapshot* snap, const TabSnapshotItem* item) {
+  TabState* ts = ec->tab_state;
+  int64_t task_id = -1;
+  if (item->has_group) {
+    TaskInfo* task = task_state_find_by_external_id(ec->task_state, item->group_id);
+    if (task)
+      task_id = task->external_id;
+  }
+  const char* title = item->title ? item->title : "Unknown";
+  const char* browser_id = item->browser_id ? item->browser_id : snap->sender;
+
+  TabHandle h = tab_state_find_browser_tab(ts, browser_id, item->id);
+  if (h != TAB_HANDLE_INVALID) {
+    uint64_t version = ts->version;
+    tab_state_update_tab(ts, title, item->id, task_id, browser_id);
+    if (ts->version != version)
+      ++snap->updated;
+    else
+      ++snap->unchanged;
+  } else {
+    h = tab_state_add_tab(ts, title, item->id, task_id, browser_id);
+    if (h == TAB_HANDLE_INVALID)
+      return;
+    ++snap->added;
+  }
+  ts->flags[tab_handle_slot(h)] |= TAB_FLAG_SEEN;
+  // chrome.tabs.query() lists tabs by window in strip order, so placing each at its index in turn
+  // leaves every window exactly as listed.
+  if (item->has_window && item->has_index && item->index >= 0)
+    tab_state_place_tab(ts, h, item->window_id, (uint32_t)item->index);
+}
+
+static void tab_snapshot_sweep(EngineContext* ec, TabSnapshot* snap) {
+  TabState* ts = ec->tab_state;
+  // A sender that owns no tabs yet maps to TAB_BROWSER_NONE and then only sweeps browser-less tabs.
+  BrowserHandle sender_browser = tab_browser_lookup(ts, snap->sender);
+  for (uint32_t slot = 0; slot < ts->nb_slots; ++slot) {
+    if (!(ts->flags[slot] & TAB_FLAG_LIVE))
+      continue;
+    if (ts->flags[slot] & TAB_FLAG_SEEN) {
+      ts->flags[slot] &= (uint8_t)~TAB_FLAG_SEEN;
+    } else if (ts->browsers[slot] == TAB_BROWSER_NONE || ts->browsers[slot] == sender_browser) {
+      tab_slot_remove(ts, slot);
+      ++snap->removed;
+    }
+  }
+  vlog(LOG_LEVEL_INFO, ts, "Tab State Synced: %d added, %d updated, %d unchanged, %d removed. Total: %d\n",
+       snap->added, snap->updated, snap->unchanged, snap->removed, ts->nb_tabs);
+}
+
+void tab_event__handle_all_tabs(EngineContext* ec, const cJSON* json_data, void* per_session_data) {
+  PerSessionData* pss = (PerSessionData*)per_session_data;
+  TabState* ts = ec->tab_state;
+  cJSON* data = cJSON_GetObjectItem(json_data, "data");
+  if (!data) {
+    vlog(LOG_LEVEL_WARN, ts, "onAllTabs: 'data' key missing.\n");
+    return;
+  }
+
+  cJSON* tabs_json = NULL;
+  cJSON* groups_json = NULL;
+
+  if (cJSON_IsArray(data)) {
+    // Legacy format: 'data' is the array of tabs
+    tabs_json = data;
   } else if (cJSON_IsObject(data)) {
     tabs_json = cJSON_GetObjectItem(data, "tabs");
     groups_json = cJSON_GetObjectItem(data, "groups");
   }
 
   if (groups_json && cJSON_IsArray(groups_json)) {
-    int group_count = cJSON_GetArraySize(groups_json);
-    for (int i = 0; i < group_count; i++) {
-      cJSON* g = cJSON_GetArrayItem(groups_json, i);
-      cJSON* gid_json = cJSON_GetObjectItemCaseSensitive(g, "id");
+    cJSON* g = NULL;
+    cJSON_ArrayForEach(g, groups_json) {
       cJSON* gtitle_json = cJSON_GetObjectItemCaseSensitive(g, "title");
-
-      int64_t external_id = -1;
-      if (cJSON_IsNumber(gid_json)) {
-        external_id = (int64_t)gid_json->valuedouble;
-      }
-      char* group_title = "Browser Group";
-      if (cJSON_IsString(gtitle_json) && gtitle_json->valuestring && strlen(gtitle_json->valuestring) > 0) {
-        group_title = gtitle_json->valuestring;
-      }
-
       cJSON* gcolor_json = cJSON_GetObjectItemCaseSensitive(g, "color");
-      char* group_color = "grey";
-      if (cJSON_IsString(gcolor_json) && gcolor_json->valuestring) {
-        group_color = gcolor_json->valuestring;
-      }
-
-      int64_t claimed_id = task_state_incorporate_external_group(tks, external_id, group_title, group_color);
-      if (claimed_id != 0) {
-        // Update tabs logic if needed here?
-        // Since we are iterating tabs next, we might be fine, but if tabs logic relies on Task ID correctness?
-        // Actually, in `onAllTabs`, we iterate tabs and look up `task_state_find_by_external_id`.
-        // If we claimed the task, `find_by_external_id` will now find it by the new positive ID (external_id).
-        // And tabs coming from browser will have `groupId` = `external_id`.
-        // So lookups will work.
-
-        // However, if there were OTHER tabs locally that are NOT in the payload (unlikely for "AllTabs")
-        // but if we had them, they would need updating.
-        // Since "AllTabs" replaces/syncs state, we rely on the loop below to update tabs.
-        // Check loop below:
-        // cJSON* gid_json = ... "groupId"
-        // int64_t external_id = gid_json...
-        // TaskInfo* task = find(ext_id)...
-        // So, if we claimed it, `find` works. `task->external_id` (Task ID logic) works.
-        // So for "AllTabs", we don't strictly need to do the manual tab loop update because we are about to refresh all
-        // tabs anyway.
-
-        // But let's be safe. If we have tabs that are NOT in the update?
-        // `onAllTabs` doesn't remove tabs unless they are missing?
-        // It iterates json, adds/updates.
-        // It does NOT remove tabs that are not in JSON (unless `tab_state_clear` is called? No.)
-        // Wait, `onAllTabs` logic in existing code:
-        // It iterates JSON. It does NOT clear existing tabs.
-        // This implies "AllTabs" is partial or additive? Or we assume it's complete?
-        // If it's complete, we should probably verify.
-        // But existing logic is: update if exists, add if new.
-        // It doesn't seem to delete?
-
-        // Anyway, for `incorporate`, we updated the Task.
-        // If we have tabs pointing to Old ID, and they are NOT in this specific update batch, they will be orphaned.
-        // So yes, we should update them.
-
-        TabInfo* t = ts->tabs;
-        while (t) {
-          if (t->task_ext_id == claimed_id) {
-            t->task_ext_id = external_id;
-          }
-          t = t->next;
-        }
-      }
+      int64_t gid = -1;
+      json_id_get(cJSON_GetObjectItemCaseSensitive(g, "id"), &gid);
+      tab_snapshot_group(ec, gid,
+                         cJSON_IsString(gtitle_json) ? gtitle_json->valuestring : NULL,
+                         cJSON_IsString(gcolor_json) ? gcolor_json->valuestring : NULL);
     }
-    // Always send task update after processing groups in AllTabs
-    send_tasks_update_to_uds(ec);
   }
 
   if (tabs_json && cJSON_IsArray(tabs_json)) {
-    int count = cJSON_GetArraySize(tabs_json);
-    vlog(LOG_LEVEL_INFO, ts, "Received %d tabs (current state: %d)\n", count, ts->nb_tabs);
-    int tabs_added = 0, tabs_updated = 0;
+    vlog(LOG_LEVEL_INFO, ts, "Received %d tabs (current state: %d)\n", cJSON_GetArraySize(tabs_json), ts->nb_tabs);
+    TabSnapshot snap = {.sender = tab_event_browser_id(json_data, NULL, pss)};
 
-    for (int i = 0; i < count; i++) {
-      cJSON* item = cJSON_GetArrayItem(tabs_json, i);
+    cJSON* item = NULL;
+    cJSON_ArrayForEach(item, tabs_json) {
       cJSON* title_json = cJSON_GetObjectItemCaseSensitive(item, "title");
-      cJSON* id_json = cJSON_GetObjectItemCaseSensitive(item, "id");
-      cJSON* gid_json = cJSON_GetObjectItemCaseSensitive(item, "groupId");
       cJSON* bid_json = cJSON_GetObjectItemCaseSensitive(item, "browserId");
+      cJSON* index_json = cJSON_GetObjectItemCaseSensitive(item, "index");
+
+      TabSnapshotItem tab = {0};
+      int64_t id = 0;
+      tab.title = cJSON_IsString(title_json) ? title_json->valuestring : NULL;
+      tab.browser_id = cJSON_IsString(bid_json) ? bid_json->valuestring : NULL;
+      json_id_get(cJSON_GetObjectItemCaseSensitive(item, "id"), &id);
+      tab.id = (uint64_t)id;
+      tab.has_group = (uint8_t)json_id_get(cJSON_GetObjectItemCaseSensitive(item, "groupId"), &tab.group_id);
+      tab.has_window = (uint8_t)json_id_get(cJSON_GetObjectItemCaseSensitive(item, "windowId"), &tab.window_id);
+      tab.has_index = cJSON_IsNumber(index_json);
+      tab.index = tab.has_index ? index_json->valuedouble : 0;
+      tab_snapshot_tab(ec, &snap, &tab);
+    }
+    tab_snapshot_sweep(ec, &snap);
+  } else {
+    vlog(LOG_LEVEL_WARN, ts, "onAllTabs: 'tabs' data missing or not an array.\n");
+  }
+  tab_state_update_active(ts, json_data, per_session_data);
+}
 
-      char* tab_title = NULL;
-      uint64_t tab_id = 0;
-      int64_t task_id = -1;
-      const char* browser_id = NULL;
+// An activeTabIds list being applied: tab_active_begin(), tab_active_mark() per id, tab_active_commit().
+typedef struct TabActiveUpdate {
+  const char* sender;
+  BrowserHandle sender_browser;
+  uint32_t nb_next;
+} TabActiveUpdate;
+
+// `count` bounds the number of ids that will be marked. The list only covers `sender`; a NULL sender
+// is taken to cover every browser.
+static int tab_active_begin(TabState* ts, TabActiveUpdate* u, const char* sender, uint32_t count) {
+  u->sender = sender;
+  u->sender_browser = tab_browser_lookup(ts, sender);
+  u->nb_next = 0;
+  // Other browsers' active tabs are carried over, so the next set can hold all of the current one.
+  uint32_t needed = count + ts->nb_active;
+  return needed <= ts->active_cap || tab_active_reserve(ts, needed);
+}
 
-      if (cJSON_IsString(title_json) && (title_json->valuestring != NULL)) {
-        tab_title = title_json->valuestring;
-      }
-      if (cJSON_IsNumber(id_json)) {
-        tab_id = (uint64_t)id_json->valuedouble;
-      }
-      if (cJSON_IsNumber(gid_json)) {
-        int64_t external_id = (int64_t)gid_json->valuedouble;
-        TaskInfo* task = task_state_find_by_external_id(tks, external_id);
-        if (task) {
-          task_id = task->external_id;
-        }
-      }
-      if (cJSON_IsString(bid_json) && bid_json->valuestring) {
-        browser_id = bid_json->valuestring;
-      }
+static void tab_active_mark(TabState* ts, TabActiveUpdate* u, uint64_t id) {
+  TabHandle h = tab_state_find_browser_tab(ts, u->sender, id);
+  if (h == TAB_HANDLE_INVALID)
+    return;
+  uint32_t slot = tab_handle_slot(h);
+  if (ts->flags[slot] & TAB_FLAG_ACTIVE_MARK)
+    return;
+  ts->flags[slot] |= TAB_FLAG_ACTIVE_MARK;
+  ts->active_scratch[u->nb_next++] = h;
+}
 
-      if (tab_state_find_tab(ts, tab_id) != NULL) {
-        tab_state_update_tab(ts, tab_title ? tab_title : "Unknown", tab_id, task_id, browser_id);
-        ++tabs_updated;
-      } else {
-        tab_state_add_tab(ts, tab_title ? tab_title : "Unknown", tab_id, task_id, browser_id);
-        ++tabs_added;
-      }
+// Clears only the previously active tabs that were not marked.
+static void tab_active_commit(TabState* ts, TabActiveUpdate* u) {
+  uint32_t nb_next = u->nb_next;
+  int changed = 0;
+  for (uint32_t i = 0; i < ts->nb_active; ++i) {
+    // Handles of tabs removed since the last update no longer resolve and are simply dropped.
+    TabHandle h = tab_state_resolve(ts, ts->active[i]);
+    if (h == TAB_HANDLE_INVALID)
+      continue;
+    uint32_t slot = tab_handle_slot(h);
+    if (ts->flags[slot] & TAB_FLAG_ACTIVE_MARK)
+      continue;
+    BrowserHandle browser = ts->browsers[slot];
+    if (u->sender && browser != TAB_BROWSER_NONE && browser != u->sender_browser) {
+      ts->flags[slot] |= TAB_FLAG_ACTIVE_MARK;
+      ts->active_scratch[nb_next++] = h;
+      continue;
     }
-    vlog(LOG_LEVEL_INFO, ts, "Tab State Synced: %d updated, %d added. Total: %d\n", tabs_updated, tabs_added,
-         ts->nb_tabs);
-  } else {
-    vlog(LOG_LEVEL_WARN, ts, "onAllTabs: 'tabs' data missing or not an array.\n");
+    ts->flags[slot] &= (uint8_t)~TAB_FLAG_ACTIVE;
+    ts->stamps[slot] = ts->version + 1;  // The version bumped below.
+    changed = 1;
+  }
+  for (uint32_t i = 0; i < nb_next; ++i) {
+    uint32_t slot = tab_handle_slot(ts->active_scratch[i]);
+    if (!(ts->flags[slot] & TAB_FLAG_ACTIVE)) {
+      ts->stamps[slot] = ts->version + 1;
+      changed = 1;
+    }
+    ts->flags[slot] = (uint8_t)((ts->flags[slot] & ~TAB_FLAG_ACTIVE_MARK) | TAB_FLAG_ACTIVE);
   }
-  tab_state_update_active(ts, json_data);
+  if (changed)
+    ts->version++;
+
+  TabHandle* prev = ts->active;
+  ts->active = ts->active_scratch;
+  ts->active_scratch = prev;
+  ts->nb_active = nb_next;
 }
 
-void tab_state_update_active(TabState* ts, const cJSON* json_data) {
+void tab_state_update_active(TabState* ts, const cJSON* json_data, const PerSessionData* pss) {
   cJSON* active_tabs_json = cJSON_GetObjectItem(json_data, "activeTabIds");
   if (!active_tabs_json || !cJSON_IsArray(active_tabs_json))
     return;
 
-#define MAX_ACTIVE_TAB_IDS_SIZE 64
-  uint64_t active_tab_ids[MAX_ACTIVE_TAB_IDS_SIZE];
-  int active_count = 0;
-  int array_size = cJSON_GetArraySize(active_tabs_json);
+  TabActiveUpdate u;
+  const char* sender = tab_event_browser_id(json_data, NULL, pss);
+  if (!tab_active_begin(ts, &u, sender, (uint32_t)cJSON_GetArraySize(active_tabs_json)))
+    return;
+  cJSON* item = NULL;
+  cJSON_ArrayForEach(item, active_tabs_json) {
+    int64_t id;
+    if (json_id_get(item, &id))
+      tab_active_mark(ts, &u, (uint64_t)id);
+  }
+  tab_active_commit(ts, &u);
+}
 
-  for (int i = 0; i < array_size && i < MAX_ACTIVE_TAB_IDS_SIZE; i++) {
-    cJSON* item = cJSON_GetArrayItem(active_tabs_json, i);
-    if (cJSON_IsNumber(item)) {
-      active_tab_ids[active_count++] = (uint64_t)item->valuedouble;
+// Top-level members of an extension message, located by ws_envelope_scan() without decoding the rest.
+typedef struct WsEnvelope {
+  JScanStr event;
+  JScanStr browser_id;
+  const char* data;    // Start of the "data" value, NULL if absent.
+  const char* active;  // Start of the "activeTabIds" value, NULL if absent.
+  const char* end;
+  uint8_t has_event;
+  uint8_t has_browser_id;
+} WsEnvelope;
+
+// Walks the whole message once (which also validates it), keeping the first of each member as
+// cJSON_GetObjectItem() would. Returns 0 if the text is not a well-formed JSON object.
+static int ws_envelope_scan(const char* msg, size_t len, WsEnvelope* env) {
+  memset(env, 0, sizeof(*env));
+  env->end = msg + len;
+  JScan js;
+  JScanStr key;
+  jscan_init(&js, msg, len);
+  if (!jscan_object_begin(&js))
+    return 0;
+  while (jscan_object_next(&js, &key)) {
+    JScanType type = jscan_peek(&js);
+    if (jscan_key_is(&key, "event") && type == JSCAN_STRING && !env->has_event) {
+      env->has_event = (uint8_t)jscan_string(&js, &env->event);
+    } else if (jscan_key_is(&key, "browserId") && type == JSCAN_STRING && !env->has_browser_id) {
+      env->has_browser_id = (uint8_t)jscan_string(&js, &env->browser_id);
+    } else {
+      if (jscan_key_is(&key, "data") && !env->data)
+        env->data = js.p;
+      else if (jscan_key_is(&key, "activeTabIds") && !env->active)
+        env->active = js.p;
+      jscan_skip(&js);
     }
   }
-  TabInfo* current = ts->tabs;
-  while (current) {
-    current->active = 0;
-    for (int i = 0; i < active_count; i++) {
-      if (current->id == active_tab_ids[i]) {
-        current->active = 1;
-        break;
+  jscan_peek(&js);
+  return !js.error && js.p == js.end;
+}
+
+static TabEventType ws_envelope_type(const WsEnvelope* env) {
+  char name[64];
+  if (!env->has_event || env->event.len >= sizeof(name))
+    return TAB_EVENT_UNKNOWN;
+  jscan_unescape(&env->event, name, sizeof(name));
+  return tab_event_lookup(name);
+}
+
+// Grows the engine's scratch buffer to `size` bytes. The buffer may move.
+static char* engine_scratch(EngineContext* ec, size_t size) {
+  if (size > ec->scratch_cap) {
+    size_t cap = ec->scratch_cap ? ec->scratch_cap : 256;
+    while (cap < size)
+      cap *= 2;
+    char* grown = realloc(ec->scratch, cap);
+    if (!grown)
+      return NULL;
+    ec->scratch = grown;
+    ec->scratch_cap = cap;
+  }
+  return ec->scratch;
+}
+
+// Streaming counterpart of tab_event__handle_all_tabs(): decodes the snapshot straight from the message
+// text one group or tab at a time. Strings of the current record are unescaped into the engine's
+// scratch buffer (after the envelope's browserId, which lives at its start for the whole snapshot), so
+// a snapshot allocates nothing once the buffer has grown to its longest record. `env` must come from a
+// successful ws_envelope_scan(), which guarantees the walks below cannot hit malformed text.
+static void tab_event_stream_all_tabs(EngineContext* ec, const WsEnvelope* env, void* per_session_data) {
+  PerSessionData* pss = (PerSessionData*)per_session_data;
+  TabState* ts = ec->tab_state;
+  if (!env->data) {
+    vlog(LOG_LEVEL_WARN, ts, "onAllTabs: 'data' key missing.\n");
+    return;
+  }
+
+  size_t base = env->has_browser_id ? env->browser_id.len + 1 : 0;
+  if (!engine_scratch(ec, base + 1))
+    return;
+  if (env->has_browser_id)
+    jscan_unescape(&env->browser_id, ec->scratch, base);
+
+  JScan js;
+  JScanStr key;
+  const char* tabs = NULL;
+  const char* groups = NULL;
+  jscan_init(&js, env->data, (size_t)(env->end - env->data));
+  if (jscan_peek(&js) == JSCAN_ARRAY) {
+    // Legacy format: 'data' is the array of tabs
+    tabs = env->data;
+  } else if (jscan_object_begin(&js)) {
+    while (jscan_object_next(&js, &key)) {
+      if (jscan_key_is(&key, "tabs") && !tabs)
+        tabs = js.p;
+      else if (jscan_key_is(&key, "groups") && !groups)
+        groups = js.p;
+      jscan_skip(&js);
+    }
+  }
+
+  if (groups) {
+    jscan_init(&js, groups, (size_t)(env->end - groups));
+    if (jscan_peek(&js) == JSCAN_ARRAY) {
+      jscan_array_begin(&js);
+      while (jscan_array_next(&js)) {
+        if (jscan_peek(&js) != JSCAN_OBJECT) {
+          jscan_skip(&js);
+          continue;
+        }
+        int64_t id = -1;
+        JScanStr title = {0}, color = {0};
+        int has_title = 0, has_color = 0;
+        jscan_object_begin(&js);
+        while (jscan_object_next(&js, &key)) {
+          JScanType type = jscan_peek(&js);
+          if (jscan_key_is(&key, "id") && type == JSCAN_NUMBER)
+            jscan_int64(&js, &id);
+          else if (jscan_key_is(&key, "title") && type == JSCAN_STRING && !has_title)
+            has_title = jscan_string(&js, &title);
+          else if (jscan_key_is(&key, "color") && type == JSCAN_STRING && !has_color)
+            has_color = jscan_string(&js, &color);
+          else
+            jscan_skip(&js);
+        }
+        if (!engine_scratch(ec, base + title.len + color.len + 2))
+          continue;
+        char* title_buf = ec->scratch + base;
+        char* color_buf = title_buf + title.len + 1;
+        jscan_unescape(&title, title_buf, title.len + 1);
+        jscan_unescape(&color, color_buf, color.len + 1);
+        tab_snapshot_group(ec, id, has_title ? title_buf : NULL, has_color ? color_buf : NULL);
+      }
+    }
+  }
+
+  if (tabs)
+    jscan_init(&js, tabs, (size_t)(env->end - tabs));
+  if (tabs && jscan_peek(&js) == JSCAN_ARRAY) {
+    TabSnapshot snap = {0};
+    int count = 0;
+    jscan_array_begin(&js);
+    while (jscan_array_next(&js)) {
+      ++count;
+      if (jscan_peek(&js) != JSCAN_OBJECT) {
+        jscan_skip(&js);
+        continue;
       }
+      TabSnapshotItem tab = {0};
+      JScanStr title = {0}, browser_id = {0};
+      int has_title = 0, has_browser_id = 0;
+      int64_t id = 0;
+      jscan_object_begin(&js);
+      while (jscan_object_next(&js, &key)) {
+        JScanType type = jscan_peek(&js);
+        if (type == JSCAN_NUMBER && jscan_key_is(&key, "id")) {
+          jscan_int64(&js, &id);
+        } else if (type == JSCAN_STRING && jscan_key_is(&key, "title") && !has_title) {
+          has_title = jscan_string(&js, &title);
+        } else if (type == JSCAN_NUMBER && jscan_key_is(&key, "groupId")) {
+          tab.has_group = (uint8_t)jscan_int64(&js, &tab.group_id);
+        } else if (type == JSCAN_NUMBER && jscan_key_is(&key, "windowId")) {
+          tab.has_window = (uint8_t)jscan_int64(&js, &tab.window_id);
+        } else if (type == JSCAN_NUMBER && jscan_key_is(&key, "index")) {
+          tab.has_index = (uint8_t)jscan_number(&js, &tab.index);
+        } else if (type == JSCAN_STRING && jscan_key_is(&key, "browserId") && !has_browser_id) {
+          has_browser_id = jscan_string(&js, &browser_id);
+        } else {
+          jscan_skip(&js);
+        }
+      }
+      if (!engine_scratch(ec, base + title.len + browser_id.len + 2))
+        continue;
+      char* title_buf = ec->scratch + base;
+      char* browser_buf = title_buf + title.len + 1;
+      jscan_unescape(&title, title_buf, title.len + 1);
+      jscan_unescape(&browser_id, browser_buf, browser_id.len + 1);
+      tab.title = has_title ? title_buf : NULL;
+      tab.browser_id = has_browser_id ? browser_buf : NULL;
+      tab.id = (uint64_t)id;
+      // The scratch buffer may have moved.
+      snap.sender = env->has_browser_id ? ec->scratch : (pss ? pss->browser_id : NULL);
+      tab_snapshot_tab(ec, &snap, &tab);
+    }
+    snap.sender = env->has_browser_id ? ec->scratch : (pss ? pss->browser_id : NULL);
+    vlog(LOG_LEVEL_INFO, ts, "Received %d tabs\n", count);
+    tab_snapshot_sweep(ec, &snap);
+  } else {
+    vlog(LOG_LEVEL_WARN, ts, "onAllTabs: 'tabs' data missing or not an array.\n");
+  }
+
+  if (env->active) {
+    jscan_init(&js, env->active, (size_t)(env->end - env->active));
+    if (jscan_peek(&js) != JSCAN_ARRAY)
+      return;
+    JScan counter = js;
+    uint32_t count = 0;
+    jscan_array_begin(&counter);
+    while (jscan_array_next(&counter)) {
+      ++count;
+      jscan_skip(&counter);
     }
-    current = current->next;
+    TabActiveUpdate u;
+    if (!tab_active_begin(ts, &u, env->has_browser_id ? ec->scratch : (pss ? pss->browser_id : NULL), count))
+      return;
+    jscan_array_begin(&js);
+    while (jscan_array_next(&js)) {
+      int64_t id;
+      if (jscan_peek(&js) == JSCAN_NUMBER && jscan_int64(&js, &id))
+        tab_active_mark(ts, &u, (uint64_t)id);
+      else
+        jscan_skip(&js);
+    }
+    tab_active_commit(ts, &u);
   }
 }
 
+
 void tab_event__handle_remove_tab(EngineContext* ec, const cJSON* json_data, void* per_session_data) {
-  (void)per_session_data;
   TabState* ts = ec->tab_state;
   // {"event": "tabs.onRemoved", "data": {"tabId": 123, "removeInfo": {...}}}
   cJSON* data = cJSON_GetObjectItem(json_data, "data");
   if (data) {
-    cJSON* tabIdJson = cJSON_GetObjectItem(data, "tabId");
-    if (cJSON_IsNumber(tabIdJson)) {
-      uint64_t id = (uint64_t)tabIdJson->valuedouble;
-      tab_state_remove_tab(ts, id);
+    int64_t tab_id;
+    if (json_id_get(cJSON_GetObjectItem(data, "tabId"), &tab_id)) {
+      uint64_t id = (uint64_t)tab_id;
+      tab_state_remove_tab(ts, id, tab_event_browser_id(json_data, data, per_session_data));
       vlog(LOG_LEVEL_INFO, ts, "Tab Removed: %llu. Remaining: %d\n", id, ts->nb_tabs);
     } else {
       vlog(LOG_LEVEL_WARN, ts, "onRemoved: tabId missing or invalid\n");
     }
   }
-  tab_state_update_active(ts, json_data);
+  tab_state_update_active(ts, json_data, per_session_data);
 }
 
 void tab_event__handle_activated(EngineContext* ec, const cJSON* json_data, void* per_session_data) {
-  (void)per_session_data;
   TabState* ts = ec->tab_state;
   // {"event": "tabs.onActivated", "data": {"tabId": 123, "windowId": 456}}
   cJSON* data = cJSON_GetObjectItem(json_data, "data");
   if (data) {
-    cJSON* tabIdJson = cJSON_GetObjectItem(data, "tabId");
-    if (cJSON_IsNumber(tabIdJson)) {
-      uint64_t id = (uint64_t)tabIdJson->valuedouble;
-      vlog(LOG_LEVEL_INFO, ts, "Tab Activated: %llu\n", id);
+    int64_t id;
+    if (json_id_get(cJSON_GetObjectItem(data, "tabId"), &id)) {
+      vlog(LOG_LEVEL_INFO, ts, "Tab Activated: %lld\n", id);
     } else {
       vlog(LOG_LEVEL_WARN, ts, "onActivated: tabId missing or invalid\n");
     }
   }
-  tab_state_update_active(ts, json_data);
+  tab_state_update_active(ts, json_data, per_session_data);
 }
 
 void tab_event__handle_created(EngineContext* ec, const cJSON* json_data, void* per_session_data) {
-  (void)per_session_data;
   TabState* ts = ec->tab_state;
   // {"event": "tabs.onCreated", "data": {"id": 123, "title": "New Tab", ...}}
   cJSON* data = cJSON_GetObjectItem(json_data, "data");
   if (data) {
-    cJSON* id_json = cJSON_GetObjectItem(data, "id");
     cJSON* title_json = cJSON_GetObjectItem(data, "title");
-    cJSON* bid_json = cJSON_GetObjectItem(data, "browserId");
 
-    if (cJSON_IsNumber(id_json)) {
-      uint64_t id = (uint64_t)id_json->valuedouble;
+    int64_t tab_id;
+    if (json_id_get(cJSON_GetObjectItem(data, "id"), &tab_id)) {
+      uint64_t id = (uint64_t)tab_id;
       const char* title = "New Tab";
       if (cJSON_IsString(title_json) && title_json->valuestring) {
         title = title_json->valuestring;
       }
-      const char* browser_id = NULL;
-      if (cJSON_IsString(bid_json) && bid_json->valuestring) {
-        browser_id = bid_json->valuestring;
-      }
-      tab_state_add_tab(ts, title, id, -1, browser_id);
+      TabHandle h = tab_state_add_tab(ts, title, id, -1, tab_event_browser_id(json_data, data, per_session_data));
+      tab_event_place(ts, h, data, "windowId", "index");
       vlog(LOG_LEVEL_INFO, ts, "Tab Created: %llu, Title: %s\n", id, title);
     } else {
       vlog(LOG_LEVEL_WARN, ts, "onCreated: id missing or invalid\n");
     }
   }
-  tab_state_update_active(ts, json_data);
+  tab_state_update_active(ts, json_data, per_session_data);
+}
+
+// TabMoved {tabId, moveInfo{windowId, toIndex}}, TabAttached {tabId, attachInfo{newWindowId, newPosition}}
+// and TabDetached {tabId, detachInfo{...}} all reposition one tab.
+void tab_event__handle_moved(EngineContext* ec, const cJSON* json_data, void* per_session_data) {
+  TabState* ts = ec->tab_state;
+  cJSON* data = cJSON_GetObjectItem(json_data, "data");
+  int64_t tab_id;
+  if (!json_id_get(cJSON_GetObjectItem(data, "tabId"), &tab_id)) {
+    vlog(LOG_LEVEL_WARN, ts, "onMoved: tabId missing or invalid\n");
+    return;
+  }
+  uint64_t id = (uint64_t)tab_id;
+  TabHandle h = tab_state_find_browser_tab(ts, tab_event_browser_id(json_data, data, per_session_data), id);
+  if (h == TAB_HANDLE_INVALID)
+    return;
+  cJSON* info = NULL;
+  if ((info = cJSON_GetObjectItem(data, "moveInfo"))) {
+    tab_event_place(ts, h, info, "windowId", "toIndex");
+  } else if ((info = cJSON_GetObjectItem(data, "attachInfo"))) {
+    tab_event_place(ts, h, info, "newWindowId", "newPosition");
+  } else if (cJSON_GetObjectItem(data, "detachInfo")) {
+    tab_state_place_tab(ts, h, TAB_WINDOW_NONE, 0);
+  }
+  vlog(LOG_LEVEL_INFO, ts, "Tab Moved: %llu, Index: %u\n", id, tab_state_tab_index(ts, h));
+  tab_state_update_active(ts, json_data, per_session_data);
+}
+
+void tab_event__handle_replaced(EngineContext* ec, const cJSON* json_data, void* per_session_data) {
+  TabState* ts = ec->tab_state;
+  // {"event": "...", "data": {"addedTabId": 124, "removedTabId": 123}}
+  cJSON* data = cJSON_GetObjectItem(json_data, "data");
+  int64_t added_id, removed_id;
+  if (!json_id_get(cJSON_GetObjectItem(data, "addedTabId"), &added_id) ||
+      !json_id_get(cJSON_GetObjectItem(data, "removedTabId"), &removed_id)) {
+    vlog(LOG_LEVEL_WARN, ts, "onReplaced: tab ids missing or invalid\n");
+    return;
+  }
+  tab_state_replace_tab_id(ts, tab_event_browser_id(json_data, data, per_session_data), (uint64_t)removed_id,
+                           (uint64_t)added_id);
+  tab_state_update_active(ts, json_data, per_session_data);
 }
 
 void tab_event__do_nothing(EngineContext* ec, const cJSON* json_data, void* per_session_data) {
@@ -1426,7 +3048,6 @@ void tab_event__do_nothing(EngineContext* ec, const cJSON* json_data, void* per_
 }
 
 void tab_event__handle_updated(EngineContext* ec, const cJSON* json_data, void* per_session_data) {
-  (void)per_session_data;
   TabState* ts = ec->tab_state;
   // {"event": "tabs.onUpdated", "data": {"tabId": 123, "changeInfo": {...}, "tab": {"id": 123, "title": "..."}}}
   cJSON* data = cJSON_GetObjectItem(json_data, "data");
@@ -1435,30 +3056,26 @@ void tab_event__handle_updated(EngineContext* ec, const cJSON* json_data, void*
   cJSON* tab_json = cJSON_GetObjectItem(data, "tab");
   if (!tab_json)
     return;
-  cJSON* id_json = cJSON_GetObjectItem(tab_json, "id");
   cJSON* title_json = cJSON_GetObjectItem(tab_json, "title");
-  cJSON* bid_json = cJSON_GetObjectItem(tab_json, "browserId");
 
-  if (!cJSON_IsNumber(id_json))
+  int64_t tab_id;
+  if (!json_id_get(cJSON_GetObjectItem(tab_json, "id"), &tab_id))
     return;
-  uint64_t id = (uint64_t)id_json->valuedouble;
+  uint64_t id = (uint64_t)tab_id;
   const char* title = "Unknown";
   if (cJSON_IsString(title_json) && title_json->valuestring) {
     title = title_json->valuestring;
   }
-  const char* browser_id = NULL;
-  if (cJSON_IsString(bid_json) && bid_json->valuestring) {
-    browser_id = bid_json->valuestring;
-  }
+  const char* browser_id = tab_event_browser_id(json_data, tab_json, per_session_data);
 
-  if (tab_state_find_tab(ts, id)) {
+  if (tab_state_find_browser_tab(ts, browser_id, id) != TAB_HANDLE_INVALID) {
     tab_state_update_tab(ts, title, id, -1, browser_id);
     vlog(LOG_LEVEL_INFO, ts, "Tab Updated: %llu, Title: %s\n", id, title);
   } else {
     tab_state_add_tab(ts, title, id, -1, browser_id);
     vlog(LOG_LEVEL_INFO, ts, "Tab Updated (New): %llu, Title: %s\n", id, title);
   }
-  tab_state_update_active(ts, json_data);
+  tab_state_update_active(ts, json_data, per_session_data);
 }
 
 void tab_event__handle_group_updated(EngineContext* ec, const cJSON* json_data, void* per_session_data) {
@@ -1469,12 +3086,11 @@ void tab_event__handle_group_updated(EngineContext* ec, const cJSON* json_data,
   if (!data)
     return;
 
-  cJSON* id_json = cJSON_GetObjectItem(data, "id");
   cJSON* title_json = cJSON_GetObjectItem(data, "title");
   cJSON* color_json = cJSON_GetObjectItem(data, "color");
 
-  if (cJSON_IsNumber(id_json)) {
-    int64_t external_id = (int64_t)id_json->valuedouble;
+  int64_t external_id;
+  if (json_id_get(cJSON_GetObjectItem(data, "id"), &external_id)) {
     const char* title = "unnamed_group";
     if (cJSON_IsString(title_json) && title_json->valuestring) {
       title = title_json->valuestring;
@@ -1487,16 +3103,10 @@ void tab_event__handle_group_updated(EngineContext* ec, const cJSON* json_data,
     int64_t claimed_id = task_state_incorporate_external_group(ts, external_id, title, color);
     if (claimed_id != 0) {
       // Update tabs that were on claimed_id
-      TabInfo* t = ec->tab_state->tabs;
-      while (t) {
-        if (t->task_ext_id == claimed_id) {
-          t->task_ext_id = external_id;
-        }
-        t = t->next;
-      }
+      tab_state_retarget_task(ec->tab_state, claimed_id, external_id);
     }
     vlog(LOG_LEVEL_INFO, ec->tab_state, "Task Updated: %lld, Title: %s, Color: %s\n", external_id, title, color);
-    send_tasks_update_to_uds(ec);
+    notify_gui(ec);
   }
 }
 
@@ -1507,12 +3117,11 @@ void tab_event__handle_group_created(EngineContext* ec, const cJSON* json_data,
   if (!data)
     return;
 
-  cJSON* id_json = cJSON_GetObjectItem(data, "id");
   cJSON* title_json = cJSON_GetObjectItem(data, "title");
   cJSON* color_json = cJSON_GetObjectItem(data, "color");
 
-  if (cJSON_IsNumber(id_json)) {
-    int64_t external_id = (int64_t)id_json->valuedouble;
+  int64_t external_id;
+  if (json_id_get(cJSON_GetObjectItem(data, "id"), &external_id)) {
     const char* title = "Browser Group";
     if (cJSON_IsString(title_json) && title_json->valuestring) {
       title = title_json->valuestring;
@@ -1525,18 +3134,34 @@ void tab_event__handle_group_created(EngineContext* ec, const cJSON* json_data,
     int64_t claimed_id = task_state_incorporate_external_group(ts, external_id, title, color);
     if (claimed_id != 0) {
       // Update tabs that were on claimed_id
-      TabInfo* t = ec->tab_state->tabs;
-      while (t) {
-        if (t->task_ext_id == claimed_id) {
-          t->task_ext_id = external_id;
-        }
-        t = t->next;
-      }
+      tab_state_retarget_task(ec->tab_state, claimed_id, external_id);
     }
-    send_tasks_update_to_uds(ec);
+    notify_gui(ec);
   }
 }
 
+void tab_event__handle_group_create_response(EngineContext* ec, const cJSON* json_data, void* per_session_data) {
+  (void)per_session_data;
+  // {"event": "...", "data": {"requestId": -2, "group": {"id": 123, "title": "...", "color": "..."}}}
+  cJSON* data = cJSON_GetObjectItem(json_data, "data");
+  cJSON* group = cJSON_GetObjectItem(data, "group");
+  int64_t request_id, external_id;
+  if (!json_id_get(cJSON_GetObjectItem(data, "requestId"), &request_id) ||
+      !json_id_get(cJSON_GetObjectItem(group, "id"), &external_id))
+    return;
+
+  cJSON* title_json = cJSON_GetObjectItem(group, "title");
+  cJSON* color_json = cJSON_GetObjectItem(group, "color");
+  const char* title = cJSON_IsString(title_json) ? title_json->valuestring : NULL;
+  const char* color = cJSON_IsString(color_json) ? color_json->valuestring : NULL;
+
+  int64_t bound_id = task_state_bind_group(ec->task_state, request_id, external_id, title, color);
+  if (bound_id != 0)
+    tab_state_retarget_task(ec->tab_state, bound_id, external_id);
+  vlog(LOG_LEVEL_INFO, ec->tab_state, "Group %lld created for request %lld\n", external_id, request_id);
+  notify_gui(ec);
+}
+
 void tab_event__handle_group_removed(EngineContext* ec, const cJSON* json_data, void* per_session_data) {
   (void)per_session_data;
   TaskState* ts = ec->task_state;
@@ -1544,12 +3169,11 @@ void tab_event__handle_group_removed(EngineContext* ec, const cJSON* json_data,
   if (!data)
     return;
 
-  cJSON* id_json = cJSON_GetObjectItem(data, "id");
-  if (cJSON_IsNumber(id_json)) {
-    int64_t external_id = (int64_t)id_json->valuedouble;
+  int64_t external_id;
+  if (json_id_get(cJSON_GetObjectItem(data, "id"), &external_id)) {
     task_state_remove(ts, external_id);
     vlog(LOG_LEVEL_INFO, ec->tab_state, "Task Removed: %lld\n", external_id);
-    send_tasks_update_to_uds(ec);
+    notify_gui(ec);
   }
 }
 
@@ -1564,9 +3188,11 @@ void tab_event__handle_register_browser(EngineContext* ec, const cJSON* json_dat
   if (data) {
     cJSON* bId = cJSON_GetObjectItem(data, "browserId");
     if (cJSON_IsString(bId) && bId->valuestring) {
-      if (pss->browser_id)
-        free(pss->browser_id);
+      // The UDS thread reads browser ids when routing GUI commands.
+      pthread_mutex_lock(&sc->pending_msg_mutex);
+      free(pss->browser_id);
       pss->browser_id = strdup(bId->valuestring);
+      pthread_mutex_unlock(&sc->pending_msg_mutex);
       vlog(LOG_LEVEL_INFO, sc, "Registered browser session: %s\n", pss->browser_id);
 
       if (ec->allowed_browser_id && strcmp(pss->browser_id, ec->allowed_browser_id) != 0) {
@@ -1578,123 +3204,537 @@ void tab_event__handle_register_browser(EngineContext* ec, const cJSON* json_dat
   }
 }
 
-struct TabEventMapEntry {
-  const char* event_name;
-  TabEventType type;
-};
-// clang-format off
-static const struct TabEventMapEntry TAB_EVENT_MAP[] = {
-    {"Extension::WS::TabActivated", TAB_EVENT_ACTIVATED},
-    {"Extension::WS::TabUpdated", TAB_EVENT_UPDATED},
-    {"Extension::WS::TabCreated", TAB_EVENT_CREATED},
-    {"Extension::WS::TabHighlighted", TAB_EVENT_HIGHLIGHTED},
-    {"Extension::WS::TabZoomChanged", TAB_EVENT_ZOOM_CHANGE},
-    {"Extension::WS::AllTabsInfoResponse", TAB_EVENT_ALL_TABS},
-    {"Extension::WS::TabRemoved", TAB_EVENT_TAB_REMOVED},
-    {"Extension::WS::TabGroupUpdated", TAB_EVENT_GROUP_UPDATED},
-    {"Extension::WS::TabGroupCreated", TAB_EVENT_GROUP_CREATED},
-    {"Extension::WS::TabGroupRemoved", TAB_EVENT_GROUP_REMOVED},
-    {"Extension::WS::RegisterBrowser", TAB_EVENT_REGISTER_BROWSER},
-    {NULL, TAB_EVENT_UNKNOWN},
-};
+typedef void (*TabEventHandler)(EngineContext* ec, const cJSON* json_data, void* per_session_data);
 
-static struct {
-  TabEventType type;
-  void (*event_handler)(EngineContext* ec, const cJSON* json_data, void* per_session_data);
-} TAB_EVENT_HANDLERS[] = {
-    {TAB_EVENT_ALL_TABS, tab_event__handle_all_tabs},
-    {TAB_EVENT_TAB_REMOVED, tab_event__handle_remove_tab},
-    {TAB_EVENT_ACTIVATED, tab_event__handle_activated},
-    {TAB_EVENT_CREATED, tab_event__handle_created},
-    {TAB_EVENT_UPDATED, tab_event__handle_updated},
-    {TAB_EVENT_GROUP_UPDATED, tab_event__handle_group_updated},
-    {TAB_EVENT_GROUP_CREATED, tab_event__handle_group_created},
-    {TAB_EVENT_GROUP_REMOVED, tab_event__handle_group_removed},
-    {TAB_EVENT_REGISTER_BROWSER, tab_event__handle_register_browser},
-    {TAB_EVENT_HIGHLIGHTED, tab_event__do_nothing},
-    {TAB_EVENT_ZOOM_CHANGE, tab_event__do_nothing},
-    {TAB_EVENT_UNKNOWN, NULL},
+// Indexed by the TabEventType tab_event_lookup() resolves from the event name (see engine_events.def).
+// clang-format off
+static const TabEventHandler TAB_EVENT_HANDLERS[TAB_EVENT_UNKNOWN] = {
+    [TAB_EVENT_ALL_TABS] = tab_event__handle_all_tabs,
+    [TAB_EVENT_TAB_REMOVED] = tab_event__handle_remove_tab,
+    [TAB_EVENT_ACTIVATED] = tab_event__handle_activated,
+    [TAB_EVENT_CREATED] = tab_event__handle_created,
+    [TAB_EVENT_UPDATED] = tab_event__handle_updated,
+    [TAB_EVENT_GROUP_UPDATED] = tab_event__handle_group_updated,
+    [TAB_EVENT_GROUP_CREATED] = tab_event__handle_group_created,
+    [TAB_EVENT_GROUP_REMOVED] = tab_event__handle_group_removed,
+    [TAB_EVENT_REGISTER_BROWSER] = tab_event__handle_register_browser,
+    [TAB_EVENT_MOVED] = tab_event__handle_moved,
+    [TAB_EVENT_ATTACHED] = tab_event__handle_moved,
+    [TAB_EVENT_DETACHED] = tab_event__handle_moved,
+    [TAB_EVENT_REPLACED] = tab_event__handle_replaced,
+    [TAB_EVENT_GROUP_CREATE_RESPONSE] = tab_event__handle_group_create_response,
+    [TAB_EVENT_HIGHLIGHTED] = tab_event__do_nothing,
+    [TAB_EVENT_ZOOM_CHANGE] = tab_event__do_nothing,
 };
 // clang-format on
 
-// Helper to determine event type from JSON string
-static TabEventType parse_event_type(cJSON* json) {
-  TabEventType type = TAB_EVENT_UNKNOWN;
-  cJSON* event = cJSON_GetObjectItemCaseSensitive(json, "event");
-
-  if (cJSON_IsString(event) && (event->valuestring != NULL)) {
-    int found = 0;
-    for (int i = 0; TAB_EVENT_MAP[i].event_name != NULL; ++i) {
-      if (strcmp(event->valuestring, TAB_EVENT_MAP[i].event_name) == 0) {
-        type = TAB_EVENT_MAP[i].type;
-        found = 1;
-        break;
+// Reads the message's top-level "event" member and nothing after it; the extension's JSON.stringify
+// writes it first, so this costs a few dozen bytes whatever the payload. Text before the member is
+// checked as it is walked, the rest is left to whoever decodes the message. TAB_EVENT_UNKNOWN if the
+// first "event" is not a known name (or not a string), as parsing the whole message would conclude.
+static TabEventType ws_event_peek(const char* msg, size_t len) {
+  JScan js;
+  JScanStr key;
+  jscan_init(&js, msg, len);
+  if (!jscan_object_begin(&js))
+    return TAB_EVENT_UNKNOWN;
+  while (jscan_object_next(&js, &key)) {
+    if (!jscan_key_is(&key, "event")) {
+      jscan_skip(&js);
+      continue;
+    }
+    WsEnvelope env = {.has_event = jscan_peek(&js) == JSCAN_STRING};
+    if (env.has_event && !jscan_string(&js, &env.event))
+      return TAB_EVENT_UNKNOWN;
+    return ws_envelope_type(&env);
+  }
+  return TAB_EVENT_UNKNOWN;
+}
+
+// What the engine does with a message, decided from its event type and sending session alone.
+typedef enum {
+  WS_GATE_HANDLE,
+  WS_GATE_UNAUTHORIZED,  // Another browser than --browser-id, and not registering.
+  WS_GATE_UNKNOWN,
+  WS_GATE_NO_OP,  // Known, but nothing handles it.
+} WsGate;
+
+static WsGate ws_event_gate(const EngineContext* ec, TabEventType type, const PerSessionData* pss) {
+  if (ec->allowed_browser_id && type != TAB_EVENT_REGISTER_BROWSER &&
+      (!pss || !pss->browser_id || strcmp(pss->browser_id, ec->allowed_browser_id) != 0))
+    return WS_GATE_UNAUTHORIZED;
+  if (type == TAB_EVENT_UNKNOWN)
+    return WS_GATE_UNKNOWN;
+  if (!TAB_EVENT_HANDLERS[type] || TAB_EVENT_HANDLERS[type] == tab_event__do_nothing)
+    return WS_GATE_NO_OP;
+  return WS_GATE_HANDLE;
+}
+
+// tab_event_handle removed, logic inlined in engine_handle_event
+
+// Records `version` as pushed; returns 0 if it already was.
+static int uds_version_advance(atomic_uint_fast64_t* sent, uint64_t version) {
+  return atomic_exchange(sent, version) != version;
+}
+
+// A push carries only what changed unless it would touch more than 1/GUI_DELTA_MAX_SHARE of the records,
+// where the full snapshot is about as big and simpler for the GUI to take in.
+#define GUI_DELTA_MAX_SHARE 2
+
+static int gui_tab_mirror_reserve(GuiTabMirror* m, uint32_t nb_slots) {
+  if (nb_slots <= m->cap)
+    return 1;
+  uint32_t cap = m->cap ? m->cap : 64;
+  while (cap < nb_slots)
+    cap *= 2;
+  TabHandle* handles = realloc(m->handles, cap * sizeof(*handles));
+  if (!handles)
+    return 0;
+  m->handles = handles;
+  uint32_t* ranks = realloc(m->ranks, cap * sizeof(*ranks));
+  if (!ranks)
+    return 0;
+  m->ranks = ranks;
+  for (uint32_t slot = m->cap; slot < cap; ++slot)
+    m->handles[slot] = TAB_HANDLE_INVALID;
+  m->cap = cap;
+  return 1;
+}
+
+static void gui_tab_mirror_free(GuiTabMirror* m) {
+  free(m->handles);
+  free(m->ranks);
+  jwrite_free(&m->snapshot.frame);
+  memset(m, 0, sizeof(*m));
+}
+
+// Writes the GUI's record of a tab, naming the tab it follows in a delta.
+static void gui_write_tab(JWrite* w, const TabState* ts, uint32_t slot, TabHandle after) {
+  jwrite_object_begin(w);
+  // The handle GUI commands refer to this tab by; browser ids stay on the WebSocket side.
+  jwrite_member_int64(w, "h", tab_make_handle(ts, slot));
+  jwrite_member_int64(w, "id", (int64_t)ts->ids[slot]);
+  jwrite_member_string(w, "title", ts->titles[slot] ? ts->titles[slot] : "Unknown");
+  jwrite_member_bool(w, "active", (ts->flags[slot] & TAB_FLAG_ACTIVE) != 0);
+  jwrite_member_int64(w, "task_id", ts->task_ids[slot]);
+  if (after != TAB_HANDLE_INVALID)
+    jwrite_member_int64(w, "after", after);
+  jwrite_object_end(w);
+}
+
+// Starts a snapshot (`list_key` holds the whole list) or delta message of one stream in `w`, up to the
+// opening '[' of the list.
+static void gui_push_begin(JWrite* w, const char* event, uint64_t base, uint64_t version, const char* list_key) {
+  jwrite_reset(w);
+  jwrite_object_begin(w);
+  jwrite_member_string(w, "event", event);
+  jwrite_key(w, "data");
+  jwrite_object_begin(w);
+  if (base)
+    jwrite_member_int64(w, "base", (int64_t)base);
+  jwrite_member_int64(w, "version", (int64_t)version);
+  jwrite_key(w, list_key);
+  jwrite_array_begin(w);
+}
+
+// Ends a message started by gui_push_begin(), after the list: for a delta, with the upserted records
+// written to the list and the keys in `removed`.
+static void gui_push_end(JWrite* w, JWrite* removed) {
+  jwrite_array_end(w);
+  if (removed) {
+    size_t len;
+    const char* keys = jwrite_json(removed, &len);
+    jwrite_key(w, "removed");
+    jwrite_array_begin(w);
+    jwrite_raw(w, keys, len);
+    jwrite_array_end(w);
+  }
+  jwrite_object_end(w);
+  jwrite_object_end(w);
+}
+
+// Walks the tabs in display order against what the GUI was last sent, writing to `upserts` the records
+// it lacks and to `removed` the handles it should drop (comma-separated, to go inside the delta's
+// arrays), and brings the mirror up to date. Either writer may be NULL when only the mirror is wanted.
+//
+// Each upserted record names the tab it follows ("after"; none for the first tab). The GUI keeps the
+// tabs it is not sent where they are and puts each upserted one right after the tab it names, which
+// rebuilds the order exactly as long as the unsent tabs kept their relative order; a tab that breaks it
+// (its previous position is lower than that of an unsent tab before it) is sent as well.
+// @returns the number of records in `upserts` and `removed`.
+static uint32_t gui_tab_mirror_diff(GuiTabMirror* m, const TabState* ts, JWrite* upserts, JWrite* removed) {
+  uint32_t nb_changes = 0;
+  uint32_t rank = 0;
+  int64_t last_kept = -1;
+  TabHandle after = TAB_HANDLE_INVALID;
+  TabOrderCursor cur;
+  for (uint32_t slot = tab_state_order_begin(ts, &cur); slot != TAB_SLOT_NONE;
+       slot = tab_state_order_next(ts, &cur), ++rank) {
+    TabHandle h = tab_make_handle(ts, slot);
+    int known = m->handles[slot] == h;
+    if (known && ts->stamps[slot] <= m->version && (int64_t)m->ranks[slot] > last_kept) {
+      last_kept = m->ranks[slot];
+    } else {
+      if (m->handles[slot] != TAB_HANDLE_INVALID && !known) {
+        if (removed)
+          jwrite_int64(removed, m->handles[slot]);
+        nb_changes++;
       }
+      if (upserts)
+        gui_write_tab(upserts, ts, slot, after);
+      nb_changes++;
     }
-    if (!found) {
-      vlog(LOG_LEVEL_WARN, NULL, "Unknown tab event: %s\n", event->valuestring);
+    m->handles[slot] = h;
+    m->ranks[slot] = rank;
+    after = h;
+  }
+  // Every live tab was visited above, so what is left of the removed ones is on free slots.
+  for (uint32_t slot = 0; slot < m->cap; ++slot) {
+    if (m->handles[slot] != TAB_HANDLE_INVALID && !tab_slot_live(ts, slot)) {
+      if (removed)
+        jwrite_int64(removed, m->handles[slot]);
+      m->handles[slot] = TAB_HANDLE_INVALID;
+      nb_changes++;
     }
   }
-  return type;
+  m->version = ts->version;
+  return nb_changes;
 }
 
-// tab_event_handle removed, logic inlined in engine_handle_event
+// Sends a message written with JWRITE_FRAME_HEAD, header and all.
+static void send_uds_frame(const int uds_fd, JWrite* w) {
+  size_t len;
+  const char* frame = jwrite_frame(w, &len);
+  if (!frame) {
+    vlog(LOG_LEVEL_ERROR, NULL, "Out of memory writing a message for the App\n");
+    return;
+  }
+  if (uds_fd < 0) {
+    vlog(LOG_LEVEL_WARN, NULL, "Warning - Cannot send UDS, not connected.\n");
+    return;
+  }
+  struct iovec iov = {.iov_base = (void*)frame, .iov_len = len};
+  if (writev_all(uds_fd, &iov, 1) < 0) {
+    vlog(LOG_LEVEL_ERROR, NULL, "Failed to send data to App via UDS: %s\n", strerror(errno));
+  } else {
+    trace_record(TRACE_UDS_SENT, (uint32_t)(len - JWRITE_FRAME_HEAD));
+    vlog(LOG_LEVEL_TRACE, NULL, "uds-send: %s (len: %zu)\n", frame + JWRITE_FRAME_HEAD, len - JWRITE_FRAME_HEAD);
+  }
+}
+
+static int gui_snapshot_is_current(const GuiSnapshotCache* c, uint64_t version, uint64_t members_version) {
+  return c->valid && c->version == version && c->members_version == members_version;
+}
+
+// Records the snapshot just written to the cache's frame as push `seq` of the given state.
+static void gui_snapshot_keep(GuiSnapshotCache* c, uint64_t seq, uint64_t version, uint64_t members_version) {
+  c->valid = !c->frame.error;
+  c->seq = seq;
+  c->version = version;
+  c->members_version = members_version;
+}
 
+// Pushes the tab list to the GUI: a TabsDelta against the last push where the GUI has one, else a full
+// TabsUpdate. Both carry a "version"; a delta applies on top of the push whose version is its "base".
 static void send_tabs_update_to_uds(EngineContext* ectx) {
-  if (!ectx->serv_ctx || ectx->serv_ctx->uds_fd < 0)
+  ServerContext* sc = ectx->serv_ctx;
+  if (!sc || sc->uds_fd < 0)
     return;
+  const TabState* ts = ectx->tab_state;
+  pthread_mutex_lock(&sc->gui_mutex);
+  if (ts && !uds_version_advance(&sc->tabs_version_sent, ts->version)) {
+    pthread_mutex_unlock(&sc->gui_mutex);
+    vlog(LOG_LEVEL_TRACE, ectx->tab_state, "Tabs unchanged (version %llu), skipping push\n",
+         (unsigned long long)ts->version);
+    return;
+  }
 
-  cJSON* tab_update_msg = cJSON_CreateObject();
-  cJSON_AddStringToObject(tab_update_msg, "event", "Daemon::UDS::TabsUpdate");
+  GuiTabMirror* m = &sc->tab_mirror;
+  JWrite* upserts = NULL;
+  JWrite* removed = NULL;
+  uint32_t nb_changes = 0;
+  int full = 1;
+  if (ts && gui_tab_mirror_reserve(m, ts->nb_slots)) {
+    if (m->primed) {
+      upserts = &sc->gui_upserts;
+      removed = &sc->gui_removed;
+      jwrite_reset(upserts);
+      jwrite_reset(removed);
+    } else {
+      m->version = 0;
+    }
+    nb_changes = gui_tab_mirror_diff(m, ts, upserts, removed);
+    full = !m->primed || nb_changes * GUI_DELTA_MAX_SHARE > (uint32_t)ts->nb_tabs;
+    m->primed = 1;
+  } else {
+    m->primed = 0;
+  }
+
+  uint64_t version = ts ? ts->version : 0;
+  if (!full && nb_changes > 0) {
+    JWrite* w = &sc->gui_frame;
+    size_t len;
+    const char* records = jwrite_json(upserts, &len);
+    gui_push_begin(w, "Daemon::UDS::TabsDelta", m->seq, m->seq + 1, "tabs");
+    jwrite_raw(w, records, len);
+    gui_push_end(w, removed);
+    m->seq++;
+    send_uds_frame(sc->uds_fd, w);
+  } else if (full && gui_snapshot_is_current(&m->snapshot, version, 0)) {
+    // Nothing the snapshot shows changed since it was built: send the same bytes, and let the deltas that
+    // follow build on the version it carries.
+    m->seq = m->snapshot.seq;
+    send_uds_frame(sc->uds_fd, &m->snapshot.frame);
+  } else if (full) {
+    JWrite* w = &m->snapshot.frame;
+    m->seq++;
+    gui_push_begin(w, "Daemon::UDS::TabsUpdate", 0, m->seq, "tabs");
+    if (ts) {
+      // Browser order where known; tabs without a position keep the newest-first order the GUI has
+      // always received.
+      TabOrderCursor cur;
+      for (uint32_t slot = tab_state_order_begin(ts, &cur); slot != TAB_SLOT_NONE;
+           slot = tab_state_order_next(ts, &cur)) {
+        gui_write_tab(w, ts, slot, TAB_HANDLE_INVALID);
+      }
+    }
+    gui_push_end(w, NULL);
+    gui_snapshot_keep(&m->snapshot, m->seq, version, 0);
+    send_uds_frame(sc->uds_fd, w);
+  }
+  // Otherwise only fields the GUI does not see (say, the browser a tab belongs to) changed.
+  pthread_mutex_unlock(&sc->gui_mutex);
+}
 
-  cJSON* event_data = cJSON_CreateObject();
-  cJSON_AddItemToObject(tab_update_msg, "data", event_data);
+static void gui_task_records_free(GuiTaskRecord* records, uint32_t count) {
+  for (uint32_t i = 0; i < count; ++i) {
+    free(records[i].name);
+    free(records[i].color);
+  }
+  free(records);
+}
 
-  cJSON* tabs_array = cJSON_CreateArray();
-  cJSON_AddItemToObject(event_data, "tabs", tabs_array);
+static void gui_task_mirror_clear(GuiTaskMirror* m) {
+  gui_task_records_free(m->records, m->count);
+  m->records = NULL;
+  m->count = 0;
+}
 
-  if (ectx->tab_state) {
-    TabInfo* current = ectx->tab_state->tabs;
-    while (current) {
-      cJSON* tab_obj = cJSON_CreateObject();
-      cJSON_AddNumberToObject(tab_obj, "id", (double)current->id);
-      cJSON_AddStringToObject(tab_obj, "title", current->title ? current->title : "Unknown");
-      cJSON_AddBoolToObject(tab_obj, "active", current->active);
-      cJSON_AddNumberToObject(tab_obj, "task_id", (double)current->task_ext_id);
-      cJSON_AddItemToArray(tabs_array, tab_obj);
-      current = current->next;
+static void gui_task_mirror_free(GuiTaskMirror* m) {
+  gui_task_mirror_clear(m);
+  free(m->index);
+  jwrite_free(&m->snapshot.frame);
+  memset(m, 0, sizeof(*m));
+}
+
+// Indexes the records by id. @returns 0 on OOM.
+static int gui_task_mirror_index(GuiTaskMirror* m) {
+  uint32_t cap = m->index_cap ? m->index_cap : TASK_INDEX_MIN_CAP;
+  while (((uint64_t)m->count + 1) * 4 > (uint64_t)cap * 3)
+    cap *= 2;
+  if (cap > m->index_cap) {
+    uint32_t* index = realloc(m->index, cap * sizeof(*index));
+    if (!index)
+      return 0;
+    m->index = index;
+    m->index_cap = cap;
+  }
+  const uint32_t mask = m->index_cap - 1;
+  memset(m->index, 0, m->index_cap * sizeof(*m->index));
+  for (uint32_t pos = 0; pos < m->count; ++pos) {
+    uint32_t i = tab_index_hash((uint64_t)m->records[pos].id) & mask;
+    while (m->index[i])
+      i = (i + 1) & mask;
+    m->index[i] = pos + 1;
+  }
+  return 1;
+}
+
+// @returns the position of the record of task `id`, or m->count if there is none.
+static uint32_t gui_task_mirror_find(const GuiTaskMirror* m, int64_t id) {
+  if (!m->count)
+    return m->count;
+  const uint32_t mask = m->index_cap - 1;
+  uint32_t i = tab_index_hash((uint64_t)id) & mask;
+  while (m->index[i] && m->records[m->index[i] - 1].id != id)
+    i = (i + 1) & mask;
+  return m->index[i] ? m->index[i] - 1 : m->count;
+}
+
+// The GUI's record of a task; `after` is the task it follows in a delta, if `has_after`.
+static void gui_write_task(JWrite* w, const TaskInfo* t, uint32_t tab_count, int has_after, int64_t after) {
+  jwrite_object_begin(w);
+  jwrite_member_int64(w, "id", t->external_id);
+  jwrite_member_string(w, "name", t->task_name ? t->task_name : "Unknown");
+  jwrite_member_string(w, "color", t->color ? t->color : "grey");
+  jwrite_member_int64(w, "tab_count", tab_count);
+  if (has_after)
+    jwrite_member_int64(w, "after", after);
+  jwrite_object_end(w);
+}
+
+// The task list counterpart of gui_tab_mirror_diff(), with records keyed by task id ("after" is a task
+// id). Previous records are found through the mirror's index, and the mirror is rebuilt each time.
+// @returns the number of records in `upserts` and `removed`, or -1 on OOM, which leaves the mirror empty
+// for the caller to push a full snapshot.
+static int gui_task_mirror_diff(GuiTaskMirror* m, const EngineContext* ectx, JWrite* upserts, JWrite* removed) {
+  const TaskState* tasks = ectx->task_state;
+  uint32_t nb_tasks = tasks ? (uint32_t)tasks->nb_tasks : 0;
+  GuiTaskRecord* next = calloc(nb_tasks ? nb_tasks : 1, sizeof(*next));
+  if (!next)
+    return -1;
+  int nb_changes = 0;
+  int64_t last_kept = -1;
+  uint32_t rank = 0;
+  for (const TaskInfo* t = tasks ? tasks->tasks : NULL; t && rank < nb_tasks; t = t->next, ++rank) {
+    const char* name = t->task_name ? t->task_name : "Unknown";
+    const char* color = t->color ? t->color : "grey";
+    uint32_t tab_count = ectx->tab_state ? tab_state_task_count(ectx->tab_state, t->external_id) : 0;
+    GuiTaskRecord* r = &next[rank];
+    r->id = t->external_id;
+    r->tab_count = tab_count;
+    uint32_t prev = gui_task_mirror_find(m, t->external_id);
+    if (prev < m->count && !m->records[prev].name)
+      prev = m->count;  // Claimed already.
+    if (prev < m->count && (int64_t)prev > last_kept && m->records[prev].tab_count == tab_count &&
+        strcmp(m->records[prev].name, name) == 0 && strcmp(m->records[prev].color, color) == 0) {
+      last_kept = prev;
+      r->name = m->records[prev].name;
+      r->color = m->records[prev].color;
+      m->records[prev].name = m->records[prev].color = NULL;
+      continue;
+    }
+    if (prev < m->count) {
+      free(m->records[prev].name);
+      free(m->records[prev].color);
+      m->records[prev].name = m->records[prev].color = NULL;
+    }
+    r->name = strdup(name);
+    r->color = strdup(color);
+    if (!r->name || !r->color) {
+      // A record without a name reads as unclaimed, and the task would drop out of the mirror unseen.
+      gui_task_records_free(next, rank + 1);
+      gui_task_mirror_clear(m);
+      return -1;
     }
+    gui_write_task(upserts, t, tab_count, rank > 0, rank > 0 ? next[rank - 1].id : 0);
+    nb_changes++;
   }
-  send_uds(ectx->serv_ctx->uds_fd, tab_update_msg);
-  cJSON_Delete(tab_update_msg);
+  // Records not claimed above are of removed tasks.
+  for (uint32_t i = 0; i < m->count; ++i) {
+    if (!m->records[i].name)
+      continue;
+    jwrite_int64(removed, m->records[i].id);
+    free(m->records[i].name);
+    free(m->records[i].color);
+    nb_changes++;
+  }
+  free(m->records);
+  m->records = next;
+  m->count = rank;
+  if (!gui_task_mirror_index(m)) {
+    gui_task_mirror_clear(m);
+    return -1;
+  }
+  return nb_changes;
 }
 
+// Pushes the task list to the GUI as TasksDelta or TasksUpdate, like send_tabs_update_to_uds().
 static void send_tasks_update_to_uds(EngineContext* ectx) {
-  if (!ectx->serv_ctx || ectx->serv_ctx->uds_fd < 0)
+  ServerContext* sc = ectx->serv_ctx;
+  if (!sc || sc->uds_fd < 0)
     return;
+  pthread_mutex_lock(&sc->gui_mutex);
+  if (ectx->task_state) {
+    // Task snapshots carry per-task tab counts, so tab membership changes also warrant a push.
+    int tasks_changed = uds_version_advance(&sc->tasks_version_sent, ectx->task_state->version);
+    int members_changed =
+        ectx->tab_state && uds_version_advance(&sc->task_members_version_sent, ectx->tab_state->members_version);
+    if (!tasks_changed && !members_changed) {
+      pthread_mutex_unlock(&sc->gui_mutex);
+      vlog(LOG_LEVEL_TRACE, ectx->task_state, "Tasks unchanged (version %llu), skipping push\n",
+           (unsigned long long)ectx->task_state->version);
+      return;
+    }
+  }
 
-  cJSON* task_update_msg = cJSON_CreateObject();
-  cJSON_AddStringToObject(task_update_msg, "event", "Daemon::UDS::TasksUpdate");
+  GuiTaskMirror* m = &sc->task_mirror;
+  JWrite* upserts = &sc->gui_upserts;
+  JWrite* removed = &sc->gui_removed;
+  jwrite_reset(upserts);
+  jwrite_reset(removed);
+  if (!m->primed)
+    gui_task_mirror_clear(m);
+  int nb_changes = gui_task_mirror_diff(m, ectx, upserts, removed);
+  int full = !m->primed || nb_changes < 0 || (uint32_t)nb_changes * GUI_DELTA_MAX_SHARE > m->count;
+  m->primed = nb_changes >= 0;
+
+  uint64_t version = ectx->task_state ? ectx->task_state->version : 0;
+  uint64_t members_version = ectx->tab_state ? ectx->tab_state->members_version : 0;
+  if (!full && nb_changes > 0) {
+    JWrite* w = &sc->gui_frame;
+    size_t len;
+    const char* records = jwrite_json(upserts, &len);
+    gui_push_begin(w, "Daemon::UDS::TasksDelta", m->seq, m->seq + 1, "tasks");
+    jwrite_raw(w, records, len);
+    gui_push_end(w, removed);
+    m->seq++;
+    send_uds_frame(sc->uds_fd, w);
+  } else if (full && gui_snapshot_is_current(&m->snapshot, version, members_version)) {
+    m->seq = m->snapshot.seq;
+    send_uds_frame(sc->uds_fd, &m->snapshot.frame);
+  } else if (full) {
+    JWrite* w = &m->snapshot.frame;
+    m->seq++;
+    gui_push_begin(w, "Daemon::UDS::TasksUpdate", 0, m->seq, "tasks");
+    for (const TaskInfo* t = ectx->task_state ? ectx->task_state->tasks : NULL; t; t = t->next) {
+      uint32_t tab_count = ectx->tab_state ? tab_state_task_count(ectx->tab_state, t->external_id) : 0;
+      gui_write_task(w, t, tab_count, 0, 0);
+    }
+    gui_push_end(w, NULL);
+    gui_snapshot_keep(&m->snapshot, m->seq, version, members_version);
+    send_uds_frame(sc->uds_fd, w);
+  }
+  pthread_mutex_unlock(&sc->gui_mutex);
+}
 
-  cJSON* task_data = cJSON_CreateObject();
-  cJSON_AddItemToObject(task_update_msg, "data", task_data);
+static void notify_gui_flush(EngineContext* ectx) {
+  send_tabs_update_to_uds(ectx);
+  send_tasks_update_to_uds(ectx);
+}
 
-  cJSON* tasks_array = cJSON_CreateArray();
-  cJSON_AddItemToObject(task_data, "tasks", tasks_array);
+static void notify_gui_expired(lws_sorted_usec_list_t* sul) {
+  ServerContext* sc = lws_container_of(sul, ServerContext, notify_sul);
+  EngineContext* ectx = lws_context_user(sc->lws_ctx);
+  sc->notify_pending = 0;
+  sc->notify_last_us = lws_now_usecs();
+  notify_gui_flush(ectx);
+}
 
-  if (ectx->task_state) {
-    TaskInfo* current = ectx->task_state->tasks;
-    while (current) {
-      cJSON* task_obj = cJSON_CreateObject();
-      cJSON_AddNumberToObject(task_obj, "id", (double)current->external_id);
-      cJSON_AddStringToObject(task_obj, "name", current->task_name ? current->task_name : "Unknown");
-      cJSON_AddStringToObject(task_obj, "color", current->color ? current->color : "grey");
-      cJSON_AddItemToArray(tasks_array, task_obj);
-      current = current->next;
-    }
+// Tells the GUI that tabs or tasks changed, from the WebSocket thread. Bursts of extension events (a page
+// load, closing many tabs) would otherwise push a full snapshot per event: the first change after a quiet
+// period is pushed at once and the ones that follow within NotifyCoalesceMs are pushed together when the
+// window closes, so the GUI gets at most one snapshot of each kind per window. State is updated as events
+// arrive either way; snapshots that would not change anything are skipped by the version checks.
+// Called from any other thread, it pushes at once: the window's timer belongs to the WebSocket thread.
+static void notify_gui(EngineContext* ectx) {
+  ServerContext* sc = ectx->serv_ctx;
+  if (!sc || !sc->lws_ctx || ectx->notify_coalesce_ms == 0 || !pthread_equal(pthread_self(), sc->ws_thread)) {
+    notify_gui_flush(ectx);
+    return;
+  }
+  if (sc->notify_pending)
+    return;
+  lws_usec_t window = (lws_usec_t)ectx->notify_coalesce_ms * LWS_US_PER_MS;
+  lws_usec_t now = lws_now_usecs();
+  lws_usec_t since = now - sc->notify_last_us;
+  if (since >= window) {
+    sc->notify_last_us = now;
+    notify_gui_flush(ectx);
+    return;
   }
-  send_uds(ectx->serv_ctx->uds_fd, task_update_msg);
-  cJSON_Delete(task_update_msg);
+  sc->notify_pending = 1;
+  lws_sul_schedule(sc->lws_ctx, 0, &sc->notify_sul, notify_gui_expired, window - since);
 }
 
 void engine_handle_event(EngineContext* ectx, DaemonEvent event, void* data, void* per_session_data) {
@@ -1703,16 +3743,16 @@ void engine_handle_event(EngineContext* ectx, DaemonEvent event, void* data, voi
   cJSON* json = NULL;
   switch (event) {
     case EVENT_HOTKEY_TOGGLE: {
-      send_tabs_update_to_uds(ectx);
-      send_tasks_update_to_uds(ectx);
+      trace_record(TRACE_HOTKEY_TOGGLE, 0);
+      // Whatever a coalescing window is holding back goes out now, so the GUI opens on current state; the
+      // window's own push then finds nothing new. A GUI that is already current is sent the toggle alone:
+      // the version checks turn the flush away before anything is walked or serialized.
+      notify_gui_flush(ectx);
 
       // 3. Send Toggle
       if (ectx->serv_ctx && ectx->serv_ctx->uds_fd >= 0) {
-        cJSON* toggle_msg = cJSON_CreateObject();
-        cJSON_AddStringToObject(toggle_msg, "event", "Daemon::UDS::ToggleGuiRequest");
-        cJSON_AddStringToObject(toggle_msg, "data", "toggle");
-        send_uds(ectx->serv_ctx->uds_fd, toggle_msg);
-        cJSON_Delete(toggle_msg);
+        static const char TOGGLE_MSG[] = "{\"event\":\"Daemon::UDS::ToggleGuiRequest\",\"data\":\"toggle\"}";
+        send_uds_json(ectx->serv_ctx->uds_fd, TOGGLE_MSG, sizeof(TOGGLE_MSG) - 1);
       }
     } break;
 
@@ -1721,41 +3761,48 @@ void engine_handle_event(EngineContext* ectx, DaemonEvent event, void* data, voi
         break;
       vlog(LOG_LEVEL_TRACE, ectx->serv_ctx, "raw message: %s\n", (const char*)data);
       const char* json_msg = (const char*)data;
-      json = cJSON_Parse(json_msg);
-      if (!json) {
-        vlog(LOG_LEVEL_ERROR, ectx, "Failed to parse json from websocket message.\n");
-        break;
-      }
-      vlog(LOG_LEVEL_TRACE, ectx->serv_ctx, "json parsed message: %s\n", cJSON_Print(json));
-      TabEventType type = parse_event_type(json);
-
-      if (type == TAB_EVENT_UNKNOWN) {
-        vlog(LOG_LEVEL_WARN, ectx->serv_ctx, "ignoring unknown tab event\n");
-        break;
-      }
-      // Check filtering for non-registration events
-      int allowed = 1;
-      if (ectx->allowed_browser_id != NULL && type != TAB_EVENT_REGISTER_BROWSER) {
-        PerSessionData* pss = (PerSessionData*)per_session_data;
-        if (!pss || !pss->browser_id || strcmp(pss->browser_id, ectx->allowed_browser_id) != 0) {
-          allowed = 0;
-        }
-      }
-      if (!allowed) {
-        vlog(LOG_LEVEL_TRACE, ectx, "Dropped message from unauthorized session.\n");
-        break;
+      PerSessionData* pss = (PerSessionData*)per_session_data;
+      size_t len = pss && pss->msg == json_msg ? pss->len : strlen(json_msg);
+      trace_record(TRACE_WS_RECEIVED, (uint32_t)len);
+      // Decide from the event name and the session whether the message is wanted before decoding any of
+      // it, so that unwanted traffic (say, a flood from an unauthorized browser) costs next to nothing.
+      TabEventType type = ws_event_peek(json_msg, len);
+      WsGate gate = ws_event_gate(ectx, type, pss);
+      trace_record(gate == WS_GATE_HANDLE ? TRACE_WS_DISPATCHED : TRACE_WS_DROPPED, (uint32_t)type);
+      switch (gate) {
+        case WS_GATE_HANDLE:
+          break;
+        case WS_GATE_UNAUTHORIZED:
+          vlog(LOG_LEVEL_TRACE, ectx, "Dropped message from unauthorized session.\n");
+          return;
+        case WS_GATE_UNKNOWN:
+          vlog(LOG_LEVEL_WARN, ectx->serv_ctx, "ignoring unknown tab event\n");
+          return;
+        case WS_GATE_NO_OP:
+          vlog(LOG_LEVEL_TRACE, ectx, "tab_event %d -- do nothing\n", type);
+          return;
       }
 
-      int handled = 0;
-      for (int i = 0; TAB_EVENT_HANDLERS[i].type != TAB_EVENT_UNKNOWN; ++i) {
-        if (TAB_EVENT_HANDLERS[i].type == type) {
-          TAB_EVENT_HANDLERS[i].event_handler(ectx, json, per_session_data);
-          handled = 1;
+      // Tab snapshots are decoded straight from the text; everything else goes through cJSON.
+      WsEnvelope env;
+      int streamed = type == TAB_EVENT_ALL_TABS && ws_envelope_scan(json_msg, len, &env);
+      if (!streamed) {
+        json = cJSON_ParseWithLength(json_msg, len);
+        if (!json) {
+          vlog(LOG_LEVEL_ERROR, ectx, "Failed to parse json from websocket message.\n");
           break;
         }
+        if (vlog_enabled(LOG_LEVEL_TRACE)) {
+          char* printed = cJSON_Print(json);
+          vlog(LOG_LEVEL_TRACE, ectx->serv_ctx, "json parsed message: %s\n", printed);
+          cJSON_free(printed);
+        }
       }
-      if (!handled) {
-        vlog(LOG_LEVEL_WARN, ectx->tab_state, "Unhandled tab event type: %d\n", type);
+
+      if (streamed) {
+        tab_event_stream_all_tabs(ectx, &env, per_session_data);
+      } else {
+        TAB_EVENT_HANDLERS[type](ectx, json, per_session_data);
       }
 
       // Post-handling updates
@@ -1765,13 +3812,17 @@ void engine_handle_event(EngineContext* ectx, DaemonEvent event, void* data, voi
         case TAB_EVENT_TAB_REMOVED:
         case TAB_EVENT_CREATED:
         case TAB_EVENT_UPDATED:
+        case TAB_EVENT_MOVED:
+        case TAB_EVENT_ATTACHED:
+        case TAB_EVENT_DETACHED:
+        case TAB_EVENT_REPLACED:
           // TODO: just move this inside of TAB_EVENT_UPDATE
-          send_tabs_update_to_uds(ectx);
-          send_tasks_update_to_uds(ectx);
+          notify_gui(ectx);
           break;
         default:
           break;
       }
+      trace_record(TRACE_WS_HANDLED, (uint32_t)type);
       break;
   }
   if (json) {
@@ -30,40 +30,193 @@ typedef enum {
   TAB_EVENT_GROUP_CREATED,
   TAB_EVENT_GROUP_REMOVED,
   TAB_EVENT_REGISTER_BROWSER,
+  TAB_EVENT_MOVED,
+  TAB_EVENT_ATTACHED,
+  TAB_EVENT_DETACHED,
+  TAB_EVENT_REPLACED,
+  TAB_EVENT_GROUP_CREATE_RESPONSE,
   TAB_EVENT_UNKNOWN
 } TabEventType;
 
+struct cJSON;
+struct lws;
 struct ServerContext;
 struct StatusBarRunContext;
-typedef struct TabInfo {
-  uint64_t id;
-  char* title;
-  int active;
-  int64_t task_ext_id;
-  char* browser_id;
-  struct TabInfo* next;
-} TabInfo;
+struct InternEntry;
+
+// Reference-counted string pool. Strings handed out by intern_table_acquire() are stored once per
+// table, so two interned strings from the same table are equal iff their pointers are equal.
+typedef struct InternTable {
+  struct InternEntry** buckets;
+  uint32_t cap;
+  uint32_t count;
+} InternTable;
+
+// One entry of TabState's task index: the live tabs owned by `task_id`, chained through the
+// task_next/task_prev columns. A bucket with count == 0 is empty.
+typedef struct TabTaskBucket {
+  int64_t task_id;
+  uint32_t head;
+  uint32_t count;
+} TabTaskBucket;
+
+// Returns the pooled copy of `s`, taking a reference. Returns NULL for a NULL `s` or on OOM.
+const char* intern_table_acquire(InternTable* it, const char* s);
+// Returns the pooled copy of `s` without taking a reference, or NULL if `s` is not pooled.
+const char* intern_table_lookup(const InternTable* it, const char* s);
+// Drops a reference taken by intern_table_acquire(). NULL is ignored.
+void intern_table_release(InternTable* it, const char* interned);
+// Points `*slot` at the pooled copy of `s`, releasing its previous string. No-op if unchanged.
+void intern_table_assign(InternTable* it, const char** slot, const char* s);
+void intern_table_clear(InternTable* it);
+
+// Tabs live in a dense structure-of-arrays store. A tab is addressed by a handle that packs its slot
+// index (low TAB_SLOT_BITS) with the slot's generation, so a handle to a removed tab never aliases the
+// tab that later reuses its slot.
+typedef uint32_t TabHandle;
+#define TAB_HANDLE_INVALID ((TabHandle)0xFFFFFFFFu)
+#define TAB_SLOT_BITS 20
+#define TAB_SLOT_MASK ((1u << TAB_SLOT_BITS) - 1)
+#define TAB_MAX_SLOTS TAB_SLOT_MASK
+
+#define TAB_SLOT_NONE UINT32_MAX
+
+// Tab ids are only unique within one browser, so tabs are keyed by (browser, id). Browsers are
+// registered by their browserId string and referred to by a small handle; TAB_BROWSER_NONE keys tabs
+// whose browser is not known (yet).
+typedef uint16_t BrowserHandle;
+#define TAB_BROWSER_NONE ((BrowserHandle)0)
+#define TAB_MAX_BROWSERS 0xFFFFu
+
+// chrome.windows.WINDOW_ID_NONE; marks a tab whose position is not known.
+#define TAB_WINDOW_NONE ((int64_t)-1)
+
+// The tabs of one browser window, in tab strip order. `root` is the root of an implicit treap (a
+// binary tree ordered by position, heap-ordered by a random priority) threaded through TabState's
+// pos_* columns, so a tab's position is the number of tabs before it in an in-order walk.
+typedef struct TabWindow {
+  int64_t window_id;
+  BrowserHandle browser;
+  uint32_t root;
+} TabWindow;
+
+// Walks tabs in display order: each window's tabs in strip order, then tabs without a known position,
+// newest first.
+typedef struct TabOrderCursor {
+  uint32_t window;
+  uint32_t slot;
+} TabOrderCursor;
+
+#define TAB_FLAG_LIVE (1u << 0)
+#define TAB_FLAG_ACTIVE (1u << 1)
+// Transient: set only while tab_state_update_active() diffs the incoming active set.
+#define TAB_FLAG_ACTIVE_MARK (1u << 2)
+// Transient: set on tabs present in an AllTabs snapshot while it is being reconciled.
+#define TAB_FLAG_SEEN (1u << 3)
 
 typedef struct TabState {
   struct EngClass* cls;
   int nb_tabs;
-  TabInfo* tabs;
+  // Bumped on every mutation visible in a tab snapshot. `members_version` moves only when a tab joins
+  // or leaves a task, which is all a task snapshot's tab counts depend on.
+  uint64_t version;
+  uint64_t members_version;
+  // Columns, indexed by slot. Slots [0, nb_slots) are either live or on the free list.
+  uint32_t nb_slots;
+  uint32_t cap;
+  uint64_t* ids;
+  // `version` as of the last change to a field a tab record carries (id, title, active, task), so a push
+  // can tell which records the GUI already has.
+  uint64_t* stamps;
+  int64_t* task_ids;
+  uint8_t* flags;
+  uint16_t* gens;
+  char** titles;
+  BrowserHandle* browsers;
+  // Window of the tab (TAB_WINDOW_NONE if unplaced) and its node in that window's treap: children,
+  // parent, subtree size and priority. TAB_SLOT_NONE is the null link.
+  int64_t* window_ids;
+  uint32_t* pos_left;
+  uint32_t* pos_right;
+  uint32_t* pos_parent;
+  uint32_t* pos_size;
+  uint32_t* pos_prio;
+  // Doubly linked membership lists of the tabs sharing a task id; TAB_SLOT_NONE terminates.
+  uint32_t* task_next;
+  uint32_t* task_prev;
+  // Removed slots, reused LIFO so recently touched memory is recycled first.
+  uint32_t* free_slots;
+  uint32_t nb_free;
+  // Open-addressing (linear probing) index of slot+1 keyed by (browser, tab id); 0 marks an empty bucket.
+  // Capacity is always a power of two and kept at most 3/4 full.
+  uint32_t* index;
+  uint32_t index_cap;
+  // Task id -> member list, same probing scheme as `index`.
+  TabTaskBucket* task_index;
+  uint32_t task_index_cap;
+  uint32_t nb_task_buckets;
+  // Handles of the tabs currently flagged TAB_FLAG_ACTIVE (one per window), kept so the next
+  // activeTabIds only has to touch the tabs whose state changed. `active_scratch` is the spare buffer
+  // the next set is built in; both hold `active_cap` entries.
+  TabHandle* active;
+  TabHandle* active_scratch;
+  uint32_t nb_active;
+  uint32_t active_cap;
+  // Registered browsers by handle; entry 0 (TAB_BROWSER_NONE) is NULL. Names are interned in `strings`
+  // and never unregistered.
+  const char** browser_names;
+  uint32_t nb_browsers;
+  // Windows holding at least one placed tab, looked up by linear scan (a handful per browser).
+  TabWindow* windows;
+  uint32_t nb_windows;
+  uint32_t windows_cap;
+  uint64_t pos_seed;
+  InternTable strings;
 } TabState;
 
+static inline uint32_t tab_handle_slot(TabHandle h) {
+  return h & TAB_SLOT_MASK;
+}
+
+static inline int tab_slot_live(const TabState* ts, uint32_t slot) {
+  return slot < ts->nb_slots && (ts->flags[slot] & TAB_FLAG_LIVE);
+}
+
 typedef struct TaskInfo {
   // task_id removed. external_id is the source of truth.
   // We keep external_id as int64_t.
   // Locally created tasks will have negative IDs.
-  char* task_name;
-  char* color;
+  const char* task_name;  // Interned in TaskState.strings.
+  const char* color;      // Interned in TaskState.strings.
   int64_t external_id;
   struct TaskInfo* next;
+  struct TaskInfo* prev;
+  // Chain of unconfirmed tasks sharing `task_name`, newest first (see TaskState.pending).
+  struct TaskInfo* pending_next;
+  struct TaskInfo* pending_prev;
 } TaskInfo;
 
+// Open-addressing (linear probing) table of TaskInfo pointers; NULL marks an empty bucket. Capacity is
+// always a power of two and kept at most 3/4 full.
+typedef struct TaskIndex {
+  TaskInfo** buckets;
+  uint32_t cap;
+  uint32_t count;
+} TaskIndex;
+
 typedef struct TaskState {
   struct EngClass* cls;
   int nb_tasks;
-  TaskInfo* tasks;
+  uint64_t version;  // Bumped on every task add, rename, recolor, claim or removal.
+  TaskInfo* tasks;   // Newest first.
+  // external_id -> task, for every task (local ones under their negative id).
+  TaskIndex by_id;
+  // Interned name -> head of the chain of unconfirmed (external_id < 0) tasks with that name that have
+  // not asked for a group; the ones that have are bound by request id instead.
+  TaskIndex pending;
+  // Local tasks handed out so far; the next one gets id -2 - nb_local_ids (-1 means "no task").
+  uint64_t nb_local_ids;
+  InternTable strings;
 } TaskState;
 
 typedef struct EngineContext {
@@ -76,9 +229,14 @@ typedef struct EngineContext {
   int destroyed;
   int init_statusline;
   char* ui_toggle_keybind;
+  uint32_t notify_coalesce_ms;  // NotifyCoalesceMs; 0 pushes every change to the GUI as it happens.
+  int trace_on_exit;            // The trace dump goes next to the manifest or config: dump on shutdown too.
   char* daemon_manifest_path;
   char* gui_manifest_path;
   char* allowed_browser_id;
+  // Reused across messages by the streaming snapshot decoder for the strings of one record.
+  char* scratch;
+  size_t scratch_cap;
 } EngineContext;
 
 typedef struct EngineCreationInfo {
@@ -92,11 +250,26 @@ typedef struct EngineCreationInfo {
   const char* allowed_browser_id;
 } EngineCreationInfo;
 
+// A message waiting for its session's next LWS_CALLBACK_SERVER_WRITEABLE.
+typedef struct PendingWsMsg {
+  char* payload;  // NUL-terminated, inside `data` with room for the LWS_PRE header in front.
+  size_t len;
+  struct PendingWsMsg* next;
+  char data[];
+} PendingWsMsg;
+
 typedef struct PerWebsocketSessionData {
   char* msg;
   size_t len;
-  char* browser_id;
+  size_t cap;  // Allocated size of `msg`, kept across messages.
+  char* browser_id;  // Written under the server's pending_msg_mutex once the browser registers.
   int should_close;
+  struct lws* wsi;
+  int send_tab_request;
+  // Outbound queue, guarded by the server's pending_msg_mutex.
+  PendingWsMsg* outbox_head;
+  PendingWsMsg* outbox_tail;
+  struct PerWebsocketSessionData* next;  // Server's list of established sessions.
 } PerSessionData;
 
 // Initializes the daemon engine.
@@ -111,9 +284,55 @@ void engine_destroy(EngineContext* ectx);
 void engine_handle_event(EngineContext* ectx, DaemonEvent event, void* data, void* per_session_data);
 
 // State helpers (exposed for testing)
-TabInfo* tab_state_find_tab(TabState* ts, const uint64_t id);
-TaskInfo* task_state_find_by_external_id(TaskState* ts, int64_t external_id);
+TabState* tab_state_alloc(void);
+void tab_state_free(TabState* ts);
+// Finds a tab by id alone, in any browser. Costs O(registered browsers).
+TabHandle tab_state_find_tab(TabState* ts, const uint64_t id);
+// Finds the tab `id` of `browser_id`. A NULL `browser_id` behaves like tab_state_find_tab().
+TabHandle tab_state_find_browser_tab(TabState* ts, const char* browser_id, const uint64_t id);
+// Returns the handle registered for `browser_id`, registering it if needed. NULL maps to TAB_BROWSER_NONE.
+BrowserHandle tab_state_intern_browser(TabState* ts, const char* browser_id);
+// @returns the browserId registered for `browser`, or NULL for TAB_BROWSER_NONE.
+const char* tab_state_browser_id(const TabState* ts, BrowserHandle browser);
+// @returns TAB_HANDLE_INVALID if the handle refers to a tab that has since been removed.
+TabHandle tab_state_resolve(const TabState* ts, TabHandle h);
+TabHandle tab_state_add_tab(TabState* ts, const char* title, const uint64_t id, int64_t task_id, const char* browser_id);
+void tab_state_update_tab(TabState* ts, const char* title, const uint64_t id, int64_t task_id, const char* browser_id);
+void tab_state_remove_tab(TabState* ts, const uint64_t id, const char* browser_id);
+// Moves a tab to another task. Writes to task_ids must go through here to keep the task index in sync.
+void tab_state_set_task(TabState* ts, TabHandle h, int64_t task_id);
+// Moves every tab owned by `old_task_id` to `new_task_id` in O(members of old_task_id).
+void tab_state_retarget_task(TabState* ts, int64_t old_task_id, int64_t new_task_id);
+uint32_t tab_state_task_count(const TabState* ts, int64_t task_id);
+// Moves a tab to `index` of `window_id` in its browser (clamped to the window's length), shifting the
+// tabs after it as the browser does. TAB_WINDOW_NONE just takes it out of its window. O(log n).
+void tab_state_place_tab(TabState* ts, TabHandle h, int64_t window_id, uint32_t index);
+// @returns the tab's position in its window, or UINT32_MAX if it is not placed. O(log n).
+uint32_t tab_state_tab_index(const TabState* ts, TabHandle h);
+// Gives tab `old_id` of `browser_id` the id `new_id` in place (chrome.tabs.onReplaced).
+void tab_state_replace_tab_id(TabState* ts, const char* browser_id, uint64_t old_id, uint64_t new_id);
+// @returns the first slot in display order, or TAB_SLOT_NONE.
+uint32_t tab_state_order_begin(const TabState* ts, TabOrderCursor* cur);
+uint32_t tab_state_order_next(const TabState* ts, TabOrderCursor* cur);
+// Applies the event's top-level "activeTabIds" array to the tabs of its sending browser ("browserId", else
+// the one session `pss` registered with); active tabs of other browsers are kept. Costs O(previous + new
+// active tabs).
+void tab_state_update_active(TabState* ts, const struct cJSON* json_data, const PerSessionData* pss);
+// Adds a task. An `external_id` of -1 allocates a fresh local (negative) id and files the task as
+// unconfirmed until a browser group of the same name claims it. O(1).
+TaskInfo* task_state_add(TaskState* ts, const char* task_name, const char* color, int64_t external_id);
+// @returns NULL for negative (local) ids. O(1).
 TaskInfo* task_state_find_by_external_id(TaskState* ts, int64_t external_id);
+// Takes local task `t` out of name matching: it has asked the browser for a group (its id is the
+// request's requestId) and will be bound by task_state_bind_group() instead.
+void task_state_await_group(TaskState* ts, TaskInfo* t);
+// Binds the local task `request_id` to the group the browser created for it. Returns `request_id` if
+// its tabs must move to `ext_group_id`, or 0 if the request is unknown (the group is then added or
+// updated as is). Never matches by title. O(1).
+int64_t task_state_bind_group(TaskState* ts, int64_t request_id, int64_t ext_group_id, const char* title,
+                              const char* color);
+// Returns the id of the local task the group claimed, or 0 if it matched an existing task or created
+// a new one. O(1).
 int64_t task_state_incorporate_external_group(TaskState* ts, int64_t external_id, const char* title, const char* color);
 void task_state_update(TaskState* ts, int64_t external_id, const char* name, const char* color);
 void task_state_remove(TaskState* ts, int64_t external_id);
@@ -0,0 +1,62 @@
+#include "jnum.h"
+
+#include <string.h>
+
+size_t jnum_parse_int64(const char* p, const char* end, int64_t* out) {
+  const char* s = p;
+  int neg = s < end && *s == '-';
+  s += neg;
+  const char* digits = s;
+  uint64_t v = 0;
+  while (s < end && (unsigned char)(*s - '0') < 10) {
+    unsigned d = (unsigned)(*s - '0');
+    if (v > (UINT64_MAX - d) / 10)
+      return 0;
+    v = v * 10 + d;
+    s++;
+  }
+  size_t n = (size_t)(s - digits);
+  if (n == 0 || (n > 1 && *digits == '0'))
+    return 0;
+  if (s < end && (*s == '.' || *s == 'e' || *s == 'E'))
+    return 0;
+  if (v > (uint64_t)INT64_MAX + neg)
+    return 0;
+  // -(v - 1) - 1 rather than -v, which overflows for INT64_MIN.
+  *out = neg ? -(int64_t)(v - 1) - 1 : (int64_t)v;
+  return (size_t)(s - p);
+}
+
+// "00" "01" ... "99": two digits per division.
+static const char JNUM_DIGIT_PAIRS[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+size_t jnum_format_int64(int64_t v, char* buf) {
+  char tmp[JNUM_INT64_LEN];
+  char* p = tmp + sizeof(tmp);
+  uint64_t u = v < 0 ? 0 - (uint64_t)v : (uint64_t)v;
+  while (u >= 100) {
+    unsigned pair = (unsigned)(u % 100) * 2;
+    u /= 100;
+    p -= 2;
+    p[0] = JNUM_DIGIT_PAIRS[pair];
+    p[1] = JNUM_DIGIT_PAIRS[pair + 1];
+  }
+  if (u >= 10) {
+    p -= 2;
+    p[0] = JNUM_DIGIT_PAIRS[u * 2];
+    p[1] = JNUM_DIGIT_PAIRS[u * 2 + 1];
+  } else {
+    *--p = (char)('0' + u);
+  }
+  size_t n = 0;
+  if (v < 0)
+    buf[n++] = '-';
+  size_t len = (size_t)(tmp + sizeof(tmp) - p);
+  memcpy(buf + n, p, len);
+  return n + len;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#ifndef DAEMON_JNUM_H_
+#define DAEMON_JNUM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Integer text for JSON ids, read and written without going through double: exact over the whole
+// int64 range (a double stops at 2^53) and without the cost of strtod()/printf("%g").
+
+// Longest text jnum_format_int64() writes: "-9223372036854775808".
+#define JNUM_INT64_LEN 20
+
+// Parses the JSON integer (an optional '-' and digits without leading zeros) at the start of [p, end).
+// @returns the bytes consumed, or 0 if there is none, it has a fraction or exponent, or it overflows.
+size_t jnum_parse_int64(const char* p, const char* end, int64_t* out);
+// Writes `v` in decimal, without a NUL, into `buf` of at least JNUM_INT64_LEN bytes.
+// @returns the number of bytes written.
+size_t jnum_format_int64(int64_t v, char* buf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // DAEMON_JNUM_H_
@@ -0,0 +1,451 @@
+#include "jscan.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "jnum.h"
+
+// String bodies, where almost all of a message's bytes are, are searched 16 bytes at a time with the
+// vector unit every target has as a baseline (SSE2 on x86-64, NEON on arm64). JSCAN_NO_SIMD forces the
+// scalar loop, which also handles the tail of every search.
+#if !defined(JSCAN_NO_SIMD) && defined(__SSE2__)
+#define JSCAN_SSE2 1
+#include <emmintrin.h>
+#elif !defined(JSCAN_NO_SIMD) && (defined(__ARM_NEON) || defined(__aarch64__))
+#define JSCAN_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Nesting depth jscan_skip() gives up at; deeper documents are treated as malformed.
+#define JSCAN_MAX_DEPTH 256
+
+static int jscan_fail(JScan* js) {
+  js->error = 1;
+  js->p = js->end;
+  return 0;
+}
+
+static void jscan_ws(JScan* js) {
+  while (js->p < js->end && (*js->p == ' ' || *js->p == '\t' || *js->p == '\n' || *js->p == '\r'))
+    js->p++;
+}
+
+// Consumes a literal such as "true" at the scanner position.
+static int jscan_literal(JScan* js, const char* lit, size_t len) {
+  if ((size_t)(js->end - js->p) < len || memcmp(js->p, lit, len) != 0)
+    return jscan_fail(js);
+  js->p += len;
+  js->last = 'v';
+  return 1;
+}
+
+void jscan_init(JScan* js, const char* text, size_t len) {
+  js->p = text;
+  js->end = text + len;
+  js->last = 0;
+  js->error = 0;
+}
+
+JScanType jscan_peek(JScan* js) {
+  jscan_ws(js);
+  if (js->error || js->p >= js->end)
+    return JSCAN_NONE;
+  switch (*js->p) {
+    case '{':
+      return JSCAN_OBJECT;
+    case '[':
+      return JSCAN_ARRAY;
+    case '"':
+      return JSCAN_STRING;
+    case 't':
+      return JSCAN_TRUE;
+    case 'f':
+      return JSCAN_FALSE;
+    case 'n':
+      return JSCAN_NULL;
+    default:
+      return (*js->p == '-' || (*js->p >= '0' && *js->p <= '9')) ? JSCAN_NUMBER : JSCAN_NONE;
+  }
+}
+
+int jscan_object_begin(JScan* js) {
+  if (jscan_peek(js) != JSCAN_OBJECT)
+    return jscan_fail(js);
+  js->p++;
+  js->last = '{';
+  return 1;
+}
+
+int jscan_array_begin(JScan* js) {
+  if (jscan_peek(js) != JSCAN_ARRAY)
+    return jscan_fail(js);
+  js->p++;
+  js->last = '[';
+  return 1;
+}
+
+// Shared by object and array iteration: consumes the separator or the closing bracket. Returns 1 if
+// another member follows.
+static int jscan_next(JScan* js, char open, char close) {
+  if (js->error)
+    return 0;
+  jscan_ws(js);
+  if (js->p >= js->end)
+    return jscan_fail(js);
+  if (js->last == open) {
+    if (*js->p == close) {
+      js->p++;
+      js->last = 'v';
+      return 0;
+    }
+    return 1;
+  }
+  if (js->last != 'v')
+    return jscan_fail(js);
+  if (*js->p == close) {
+    js->p++;
+    return 0;
+  }
+  if (*js->p != ',')
+    return jscan_fail(js);
+  js->p++;
+  js->last = ',';
+  return 1;
+}
+
+int jscan_object_next(JScan* js, JScanStr* key) {
+  if (!jscan_next(js, '{', '}'))
+    return 0;
+  if (!jscan_string(js, key))
+    return 0;
+  jscan_ws(js);
+  if (js->p >= js->end || *js->p != ':')
+    return jscan_fail(js);
+  js->p++;
+  js->last = ':';
+  return 1;
+}
+
+int jscan_array_next(JScan* js) {
+  return jscan_next(js, '[', ']');
+}
+
+const char* jscan_backend(void) {
+#if defined(JSCAN_SSE2)
+  return "sse2";
+#elif defined(JSCAN_NEON)
+  return "neon";
+#else
+  return "scalar";
+#endif
+}
+
+// Returns the first byte in [p, end) that can end a run of plain string content: '"', '\\' or a control
+// character (which JSON does not allow unescaped). Returns `end` if there is none.
+static const char* jscan_string_special(const char* p, const char* end) {
+#if defined(JSCAN_SSE2)
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i control = _mm_set1_epi8(0x1F);
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    // Unsigned v <= 0x1F iff min(v, 0x1F) == v.
+    __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                                _mm_cmpeq_epi8(_mm_min_epu8(v, control), v));
+    int mask = _mm_movemask_epi8(hits);
+    if (mask)
+      return p + __builtin_ctz((unsigned)mask);
+    p += 16;
+  }
+#elif defined(JSCAN_NEON)
+  const uint8x16_t quote = vdupq_n_u8('"');
+  const uint8x16_t backslash = vdupq_n_u8('\\');
+  const uint8x16_t control = vdupq_n_u8(0x1F);
+  while (end - p >= 16) {
+    uint8x16_t v = vld1q_u8((const uint8_t*)p);
+    uint8x16_t hits = vorrq_u8(vorrq_u8(vceqq_u8(v, quote), vceqq_u8(v, backslash)), vcleq_u8(v, control));
+    // Narrow each 0x00/0xFF byte to a nibble so the first hit is found with one count of trailing zeros.
+    uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hits), 4)), 0);
+    if (mask)
+      return p + (__builtin_ctzll(mask) >> 2);
+    p += 16;
+  }
+#endif
+  while (p < end && *p != '"' && *p != '\\' && (unsigned char)*p >= 0x20)
+    p++;
+  return p;
+}
+
+int jscan_string(JScan* js, JScanStr* out) {
+  if (jscan_peek(js) != JSCAN_STRING)
+    return jscan_fail(js);
+  const char* start = ++js->p;
+  const char* p = start;
+  int escaped = 0;
+  for (;;) {
+    p = jscan_string_special(p, js->end);
+    if (p >= js->end || (unsigned char)*p < 0x20)
+      return jscan_fail(js);
+    if (*p == '"')
+      break;
+    // A backslash escapes the byte after it; \uXXXX's digits are plain content.
+    if (js->end - p < 2)
+      return jscan_fail(js);
+    escaped = 1;
+    p += 2;
+  }
+  out->ptr = start;
+  out->len = (size_t)(p - start);
+  out->escaped = escaped;
+  js->p = p + 1;
+  js->last = 'v';
+  return 1;
+}
+
+int jscan_number(JScan* js, double* out) {
+  if (jscan_peek(js) != JSCAN_NUMBER)
+    return jscan_fail(js);
+  const char* start = js->p;
+  const char* p = js->p;
+  if (*p == '-')
+    p++;
+  // Integers without a fraction or exponent (every id the extension sends) are accumulated directly;
+  // anything else goes through strtod().
+  uint64_t mantissa = 0;
+  int digits = 0;
+  if (p < js->end && *p == '0') {
+    p++;
+    digits = 1;
+  } else {
+    while (p < js->end && *p >= '0' && *p <= '9') {
+      mantissa = mantissa * 10 + (uint64_t)(*p++ - '0');
+      digits++;
+    }
+  }
+  if (!digits)
+    return jscan_fail(js);
+  int is_integer = 1;
+  if (p < js->end && *p == '.') {
+    is_integer = 0;
+    const char* frac = ++p;
+    while (p < js->end && *p >= '0' && *p <= '9')
+      p++;
+    if (p == frac)
+      return jscan_fail(js);
+  }
+  if (p < js->end && (*p == 'e' || *p == 'E')) {
+    is_integer = 0;
+    p++;
+    if (p < js->end && (*p == '+' || *p == '-'))
+      p++;
+    const char* exp = p;
+    while (p < js->end && *p >= '0' && *p <= '9')
+      p++;
+    if (p == exp)
+      return jscan_fail(js);
+  }
+  js->p = p;
+  js->last = 'v';
+  if (is_integer && digits <= 18) {
+    *out = *start == '-' ? -(double)mantissa : (double)mantissa;
+    return 1;
+  }
+  char buf[64];
+  size_t len = (size_t)(p - start);
+  if (len >= sizeof(buf))
+    return jscan_fail(js);
+  memcpy(buf, start, len);
+  buf[len] = '\0';
+  *out = strtod(buf, NULL);
+  return 1;
+}
+
+int jscan_int64(JScan* js, int64_t* out) {
+  if (jscan_peek(js) != JSCAN_NUMBER)
+    return jscan_fail(js);
+  size_t n = jnum_parse_int64(js->p, js->end, out);
+  if (n) {
+    js->p += n;
+    js->last = 'v';
+    return 1;
+  }
+  // Fractions, exponents and integers beyond int64 are still numbers; they are truncated.
+  double d;
+  if (!jscan_number(js, &d))
+    return 0;
+  *out = d > -9.2e18 && d < 9.2e18 ? (int64_t)d : 0;
+  return 1;
+}
+
+int jscan_skip(JScan* js) {
+  uint8_t is_object[JSCAN_MAX_DEPTH / 8];  // Bit per open container.
+  int depth = 0;
+  for (;;) {
+    double d;
+    JScanStr s;
+    switch (jscan_peek(js)) {
+      case JSCAN_OBJECT:
+      case JSCAN_ARRAY: {
+        if (depth == JSCAN_MAX_DEPTH)
+          return jscan_fail(js);
+        int object = *js->p == '{';
+        if (object)
+          is_object[depth / 8] |= (uint8_t)(1u << (depth % 8));
+        else
+          is_object[depth / 8] &= (uint8_t)~(1u << (depth % 8));
+        depth++;
+        js->last = *js->p++;
+        break;
+      }
+      case JSCAN_STRING:
+        jscan_string(js, &s);
+        break;
+      case JSCAN_NUMBER:
+        jscan_number(js, &d);
+        break;
+      case JSCAN_TRUE:
+        jscan_literal(js, "true", 4);
+        break;
+      case JSCAN_FALSE:
+        jscan_literal(js, "false", 5);
+        break;
+      case JSCAN_NULL:
+        jscan_literal(js, "null", 4);
+        break;
+      case JSCAN_NONE:
+        return jscan_fail(js);
+    }
+    // Step to the next value to consume, closing the containers that are done.
+    while (depth > 0) {
+      int object = (is_object[(depth - 1) / 8] >> ((depth - 1) % 8)) & 1;
+      if (object ? jscan_object_next(js, &s) : jscan_array_next(js))
+        break;
+      if (js->error)
+        return 0;
+      depth--;
+    }
+    if (js->error)
+      return 0;
+    if (depth == 0)
+      return 1;
+  }
+}
+
+int jscan_key_is(const JScanStr* key, const char* lit) {
+  size_t len = strlen(lit);
+  return !key->escaped && key->len == len && memcmp(key->ptr, lit, len) == 0;
+}
+
+static int jscan_hex4(const char* p, uint32_t* out) {
+  uint32_t v = 0;
+  for (int i = 0; i < 4; ++i) {
+    char c = p[i];
+    v <<= 4;
+    if (c >= '0' && c <= '9')
+      v |= (uint32_t)(c - '0');
+    else if (c >= 'a' && c <= 'f')
+      v |= (uint32_t)(c - 'a' + 10);
+    else if (c >= 'A' && c <= 'F')
+      v |= (uint32_t)(c - 'A' + 10);
+    else
+      return 0;
+  }
+  *out = v;
+  return 1;
+}
+
+size_t jscan_unescape(const JScanStr* s, char* dst, size_t cap) {
+  if (!cap)
+    return 0;
+  size_t n = 0;
+  if (!s->escaped) {
+    n = s->len < cap - 1 ? s->len : cap - 1;
+    if (n)
+      memcpy(dst, s->ptr, n);
+    dst[n] = '\0';
+    return n;
+  }
+  const char* p = s->ptr;
+  const char* end = s->ptr + s->len;
+  while (p < end) {
+    char buf[4];
+    size_t len = 1;
+    if (*p != '\\') {
+      // Copy the run up to the next escape in one go.
+      const char* run = memchr(p, '\\', (size_t)(end - p));
+      size_t take = (size_t)((run ? run : end) - p);
+      if (take > cap - 1 - n)
+        take = cap - 1 - n;
+      memcpy(dst + n, p, take);
+      n += take;
+      p += take;
+      if (n == cap - 1)
+        break;
+      continue;
+    }
+    if (++p < end) {
+      char c = *p++;
+      switch (c) {
+        case 'b':
+          buf[0] = '\b';
+          break;
+        case 'f':
+          buf[0] = '\f';
+          break;
+        case 'n':
+          buf[0] = '\n';
+          break;
+        case 'r':
+          buf[0] = '\r';
+          break;
+        case 't':
+          buf[0] = '\t';
+          break;
+        case 'u': {
+          uint32_t cp;
+          if (end - p < 4 || !jscan_hex4(p, &cp)) {
+            len = 0;
+            break;
+          }
+          p += 4;
+          uint32_t lo;
+          if (cp >= 0xD800 && cp < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u' && jscan_hex4(p + 2, &lo) &&
+              lo >= 0xDC00 && lo < 0xE000) {
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+            p += 6;
+          }
+          if (cp < 0x80) {
+            buf[0] = (char)cp;
+          } else if (cp < 0x800) {
+            buf[0] = (char)(0xC0 | (cp >> 6));
+            buf[1] = (char)(0x80 | (cp & 0x3F));
+            len = 2;
+          } else if (cp < 0x10000) {
+            buf[0] = (char)(0xE0 | (cp >> 12));
+            buf[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+            buf[2] = (char)(0x80 | (cp & 0x3F));
+            len = 3;
+          } else {
+            buf[0] = (char)(0xF0 | (cp >> 18));
+            buf[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+            buf[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+            buf[3] = (char)(0x80 | (cp & 0x3F));
+            len = 4;
+          }
+          break;
+        }
+        default:  // '"', '\\' and '/' stand for themselves.
+          buf[0] = c;
+          break;
+      }
+    } else {
+      len = 0;
+    }
+    if (n + len > cap - 1)
+      break;
+    memcpy(dst + n, buf, len);
+    n += len;
+  }
+  dst[n] = '\0';
+  return n;
+}
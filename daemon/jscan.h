@@ -0,0 +1,88 @@
+#pragma once
+
+#ifndef DAEMON_JSCAN_H_
+#define DAEMON_JSCAN_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Pull scanner over a JSON text held in memory. Nothing is allocated: strings come back as slices of the
+// input and are only copied (unescaped) on request, so a caller can walk a large document one record at
+// a time. Values the caller does not ask for are skipped without being decoded.
+//
+// Walking an object:
+//
+//   JScanStr key;
+//   if (!jscan_object_begin(&js)) ...
+//   while (jscan_object_next(&js, &key)) {
+//     if (jscan_key_is(&key, "id")) jscan_number(&js, &id);
+//     else jscan_skip(&js);
+//   }
+//   if (js.error) ...
+//
+// Every call fails (returns 0 and sets `error`) once the text turns out to be malformed.
+typedef struct JScan {
+  const char* p;
+  const char* end;
+  // The last structural character consumed: '{', '[', ',' or ':', or 'v' after a complete value.
+  // Tells object/array iteration whether a separator is due.
+  char last;
+  int error;
+} JScan;
+
+typedef enum {
+  JSCAN_NONE,
+  JSCAN_OBJECT,
+  JSCAN_ARRAY,
+  JSCAN_STRING,
+  JSCAN_NUMBER,
+  JSCAN_TRUE,
+  JSCAN_FALSE,
+  JSCAN_NULL,
+} JScanType;
+
+typedef struct JScanStr {
+  const char* ptr;  // Between the quotes, escapes still in place.
+  size_t len;
+  int escaped;  // Whether `ptr` holds backslash escapes; if not it is the value verbatim.
+} JScanStr;
+
+void jscan_init(JScan* js, const char* text, size_t len);
+// @returns the type of the next value without consuming it, or JSCAN_NONE at the end or on error.
+JScanType jscan_peek(JScan* js);
+
+// Consumes the '{' of the next value.
+int jscan_object_begin(JScan* js);
+// Moves to the next member: returns 1 with `key` set and the scanner on the member's value, or 0 once
+// the closing '}' has been consumed (or on error). The value must be consumed before the next call.
+int jscan_object_next(JScan* js, JScanStr* key);
+// Consumes the '[' of the next value.
+int jscan_array_begin(JScan* js);
+// Returns 1 with the scanner on the next element, or 0 once the closing ']' has been consumed.
+int jscan_array_next(JScan* js);
+
+int jscan_string(JScan* js, JScanStr* out);
+int jscan_number(JScan* js, double* out);
+// Reads an integer exactly over the whole int64 range (see jnum.h). Other numbers are truncated.
+int jscan_int64(JScan* js, int64_t* out);
+// Consumes the next value whatever its type, including nested containers.
+int jscan_skip(JScan* js);
+
+// @returns the vector instruction set string scanning was built with: "sse2", "neon" or "scalar".
+const char* jscan_backend(void);
+
+// Compares an (unescaped) key against a NUL-terminated literal.
+int jscan_key_is(const JScanStr* key, const char* lit);
+// Writes `s` unescaped and NUL-terminated into `dst`, truncating to `cap` - 1 bytes. `s->len` + 1 bytes
+// always suffice. Returns the number of bytes written before the NUL.
+size_t jscan_unescape(const JScanStr* s, char* dst, size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // DAEMON_JSCAN_H_
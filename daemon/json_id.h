@@ -0,0 +1,51 @@
+#pragma once
+
+#ifndef DAEMON_JSON_ID_H_
+#define DAEMON_JSON_ID_H_
+
+#include <cJSON.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "jnum.h"
+
+// Ids in cJSON trees. Written as raw integer text (see jnum.h), so cJSON prints them verbatim instead of
+// through printf("%1.15g"), exact over the whole int64 range.
+
+// Largest magnitude below which every integer is exactly a double.
+#define JSON_ID_EXACT_MAX 9007199254740992.0  // 2^53
+
+static inline cJSON* json_id_create(int64_t id) {
+  char buf[JNUM_INT64_LEN + 1];
+  buf[jnum_format_int64(id, buf)] = '\0';
+  return cJSON_CreateRaw(buf);
+}
+
+static inline cJSON* json_id_add(cJSON* object, const char* key, int64_t id) {
+  cJSON* item = json_id_create(id);
+  if (item && !cJSON_AddItemToObject(object, key, item)) {
+    cJSON_Delete(item);
+    return NULL;
+  }
+  return item;
+}
+
+// Reads an id from a tree: raw text exactly, and numbers parsed by cJSON (doubles) only while they are
+// whole and within 2^53, which covers everything the extension's JavaScript can send. Anything else is
+// rejected rather than rounded. Returns 0 without touching `out` if `item` holds no id.
+static inline int json_id_get(const cJSON* item, int64_t* out) {
+  if (cJSON_IsRaw(item) && item->valuestring) {
+    const char* s = item->valuestring;
+    const char* end = s + strlen(s);
+    return jnum_parse_int64(s, end, out) == (size_t)(end - s);
+  }
+  if (!cJSON_IsNumber(item))
+    return 0;
+  double d = item->valuedouble;
+  if (!(d > -JSON_ID_EXACT_MAX && d < JSON_ID_EXACT_MAX) || d != (double)(int64_t)d)
+    return 0;
+  *out = (int64_t)d;
+  return 1;
+}
+
+#endif  // DAEMON_JSON_ID_H_
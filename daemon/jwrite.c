@@ -0,0 +1,235 @@
+#include "jwrite.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "jnum.h"
+
+#define JWRITE_MIN_CAP 256
+
+void jwrite_init(JWrite* w, size_t head) {
+  memset(w, 0, sizeof(*w));
+  w->head = head;
+  w->len = head;
+}
+
+void jwrite_free(JWrite* w) {
+  free(w->buf);
+  jwrite_init(w, w->head);
+}
+
+void jwrite_reset(JWrite* w) {
+  w->len = w->head;
+  w->error = 0;
+}
+
+// Makes room for `n` more bytes and the NUL after them. @returns 0 (and sets `error`) if there is none.
+static int jwrite_reserve(JWrite* w, size_t n) {
+  if (w->error)
+    return 0;
+  if (w->len + n + 1 <= w->cap)
+    return 1;
+  size_t cap = w->cap ? w->cap : JWRITE_MIN_CAP;
+  while (cap < w->len + n + 1)
+    cap *= 2;
+  char* buf = realloc(w->buf, cap);
+  if (!buf) {
+    w->error = 1;
+    return 0;
+  }
+  w->buf = buf;
+  w->cap = cap;
+  return 1;
+}
+
+// Reserves room for a value or key of `n` bytes and puts in the comma due before it, if any: one is due
+// unless the value opens the text, a container or a member.
+static int jwrite_begin(JWrite* w, size_t n) {
+  if (!jwrite_reserve(w, n + 1))
+    return 0;
+  if (w->len > w->head) {
+    char last = w->buf[w->len - 1];
+    if (last != '{' && last != '[' && last != ':')
+      w->buf[w->len++] = ',';
+  }
+  return 1;
+}
+
+static void jwrite_put(JWrite* w, const char* s, size_t n) {
+  if (!jwrite_begin(w, n))
+    return;
+  memcpy(w->buf + w->len, s, n);
+  w->len += n;
+}
+
+const char* jwrite_json(JWrite* w, size_t* len) {
+  if (!jwrite_reserve(w, 0)) {
+    *len = 0;
+    return "";
+  }
+  w->buf[w->len] = '\0';
+  *len = w->len - w->head;
+  return w->buf + w->head;
+}
+
+const char* jwrite_frame(JWrite* w, size_t* len) {
+  size_t payload_len;
+  jwrite_json(w, &payload_len);
+  if (w->error || w->head < JWRITE_FRAME_HEAD) {
+    *len = 0;
+    return NULL;
+  }
+  uint32_t n = (uint32_t)payload_len;
+  unsigned char* p = (unsigned char*)w->buf + w->head - JWRITE_FRAME_HEAD;
+  p[0] = (unsigned char)n;
+  p[1] = (unsigned char)(n >> 8);
+  p[2] = (unsigned char)(n >> 16);
+  p[3] = (unsigned char)(n >> 24);
+  *len = payload_len + JWRITE_FRAME_HEAD;
+  return (const char*)p;
+}
+
+char* jwrite_take(JWrite* w, size_t* len) {
+  jwrite_json(w, len);
+  char* buf = w->error ? NULL : w->buf;
+  if (!buf)
+    free(w->buf);
+  w->buf = NULL;
+  w->cap = 0;
+  jwrite_reset(w);
+  return buf;
+}
+
+void jwrite_object_begin(JWrite* w) {
+  jwrite_put(w, "{", 1);
+}
+
+void jwrite_object_end(JWrite* w) {
+  if (jwrite_reserve(w, 1))
+    w->buf[w->len++] = '}';
+}
+
+void jwrite_array_begin(JWrite* w) {
+  jwrite_put(w, "[", 1);
+}
+
+void jwrite_array_end(JWrite* w) {
+  if (jwrite_reserve(w, 1))
+    w->buf[w->len++] = ']';
+}
+
+void jwrite_key(JWrite* w, const char* key) {
+  jwrite_string(w, key);
+  if (jwrite_reserve(w, 1))
+    w->buf[w->len++] = ':';
+}
+
+static int jwrite_needs_escape(unsigned char c) {
+  return c < 0x20 || c == '"' || c == '\\';
+}
+
+// Whether none of the 8 bytes of `x` needs escaping. Each test sets the top bit of some byte exactly when
+// some byte is below 0x20, or equal to '"' or '\\' (the usual has-zero-byte tricks).
+static int jwrite_word_is_plain(uint64_t x) {
+  const uint64_t ones = 0x0101010101010101ull;
+  const uint64_t highs = 0x8080808080808080ull;
+  uint64_t quote = x ^ (ones * '"');
+  uint64_t backslash = x ^ (ones * '\\');
+  uint64_t hits = ((x - ones * 0x20) & ~x) | ((quote - ones) & ~quote) | ((backslash - ones) & ~backslash);
+  return (hits & highs) == 0;
+}
+
+void jwrite_string_len(JWrite* w, const char* s, size_t len) {
+  static const char HEX[] = "0123456789abcdef";
+  // Room for the text as is; each escape then asks for its extra bytes.
+  if (!jwrite_begin(w, len + 2))
+    return;
+  w->buf[w->len++] = '"';
+  size_t i = 0;
+  while (i < len) {
+    // Titles rarely hold anything to escape, so the plain runs are found a word at a time and copied
+    // whole.
+    size_t end = i;
+    while (end + 8 <= len) {
+      uint64_t x;
+      memcpy(&x, s + end, sizeof(x));
+      if (!jwrite_word_is_plain(x))
+        break;
+      end += 8;
+    }
+    while (end < len && !jwrite_needs_escape((unsigned char)s[end]))
+      ++end;
+    memcpy(w->buf + w->len, s + i, end - i);
+    w->len += end - i;
+    if (end == len)
+      break;
+
+    // 5 more bytes at most ("\u00XX" for one), plus what is left of the text and the closing quote.
+    if (!jwrite_reserve(w, 5 + (len - end) + 1))
+      return;
+    unsigned char c = (unsigned char)s[end];
+    char* out = w->buf + w->len;
+    out[0] = '\\';
+    switch (c) {
+      case '"':
+      case '\\':
+        out[1] = (char)c;
+        w->len += 2;
+        break;
+      case '\b':
+        out[1] = 'b';
+        w->len += 2;
+        break;
+      case '\f':
+        out[1] = 'f';
+        w->len += 2;
+        break;
+      case '\n':
+        out[1] = 'n';
+        w->len += 2;
+        break;
+      case '\r':
+        out[1] = 'r';
+        w->len += 2;
+        break;
+      case '\t':
+        out[1] = 't';
+        w->len += 2;
+        break;
+      default:
+        memcpy(out + 1, "u00", 3);
+        out[4] = HEX[c >> 4];
+        out[5] = HEX[c & 0xf];
+        w->len += 6;
+        break;
+    }
+    i = end + 1;
+  }
+  w->buf[w->len++] = '"';
+}
+
+void jwrite_string(JWrite* w, const char* s) {
+  jwrite_string_len(w, s, strlen(s));
+}
+
+void jwrite_int64(JWrite* w, int64_t v) {
+  if (!jwrite_begin(w, JNUM_INT64_LEN))
+    return;
+  w->len += jnum_format_int64(v, w->buf + w->len);
+}
+
+void jwrite_bool(JWrite* w, int v) {
+  if (v)
+    jwrite_put(w, "true", 4);
+  else
+    jwrite_put(w, "false", 5);
+}
+
+void jwrite_null(JWrite* w) {
+  jwrite_put(w, "null", 4);
+}
+
+void jwrite_raw(JWrite* w, const char* json, size_t len) {
+  if (len)
+    jwrite_put(w, json, len);
+}
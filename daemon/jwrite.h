@@ -0,0 +1,87 @@
+#pragma once
+
+#ifndef DAEMON_JWRITE_H_
+#define DAEMON_JWRITE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Streaming JSON writer, the output side of jscan.h: values are appended as text to one growable buffer,
+// with no tree in between. The buffer is kept across messages (it comes from the system allocator, never
+// an arena), so once it has grown to size building a message allocates nothing. `head` bytes are reserved
+// in front of the text for what the transport puts there (the UDS frame header, lws's LWS_PRE), so a
+// finished message is sent from the buffer as is.
+//
+//   jwrite_reset(&w);
+//   jwrite_object_begin(&w);
+//   jwrite_member_string(&w, "event", "GUI::UDS::TabSelected");
+//   jwrite_key(&w, "data");
+//   ...
+//   jwrite_object_end(&w);
+//   if (!w.error) send(fd, jwrite_frame(&w, &len), len, 0);
+//
+// Commas go in as needed; otherwise the writer trusts the calls to make a well-formed document. Once an
+// allocation fails `error` is set and output is dropped until the next reset.
+typedef struct JWrite {
+  char* buf;
+  size_t len;  // Bytes in use, `head` included.
+  size_t cap;
+  size_t head;
+  int error;
+} JWrite;
+
+// The UDS frame header: the payload length, 4 bytes little-endian.
+#define JWRITE_FRAME_HEAD 4
+
+// Nothing is allocated until the first write.
+void jwrite_init(JWrite* w, size_t head);
+void jwrite_free(JWrite* w);
+// Starts a new message, keeping the buffer.
+void jwrite_reset(JWrite* w);
+
+// @returns the text written, NUL-terminated, and its length in `len`.
+const char* jwrite_json(JWrite* w, size_t* len);
+// Fills in a JWRITE_FRAME_HEAD header. @returns the whole frame and its length in `len`.
+const char* jwrite_frame(JWrite* w, size_t* len);
+// Hands the buffer over to the caller, who free()s it: `head` bytes, then the NUL-terminated text of
+// length `len`. The writer starts over empty. @returns NULL if there was an error.
+char* jwrite_take(JWrite* w, size_t* len);
+
+void jwrite_object_begin(JWrite* w);
+void jwrite_object_end(JWrite* w);
+void jwrite_array_begin(JWrite* w);
+void jwrite_array_end(JWrite* w);
+void jwrite_key(JWrite* w, const char* key);
+void jwrite_string(JWrite* w, const char* s);
+void jwrite_string_len(JWrite* w, const char* s, size_t len);
+// Exact over the whole range, like json_id.h.
+void jwrite_int64(JWrite* w, int64_t v);
+void jwrite_bool(JWrite* w, int v);
+void jwrite_null(JWrite* w);
+// Appends JSON text written elsewhere: a value, or inside an object a run of members.
+void jwrite_raw(JWrite* w, const char* json, size_t len);
+
+static inline void jwrite_member_string(JWrite* w, const char* key, const char* s) {
+  jwrite_key(w, key);
+  jwrite_string(w, s);
+}
+
+static inline void jwrite_member_int64(JWrite* w, const char* key, int64_t v) {
+  jwrite_key(w, key);
+  jwrite_int64(w, v);
+}
+
+static inline void jwrite_member_bool(JWrite* w, const char* key, int v) {
+  jwrite_key(w, key);
+  jwrite_bool(w, v);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // DAEMON_JWRITE_H_
@@ -0,0 +1,136 @@
+#include "trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+
+TraceEvent trace_ring[TRACE_RING_EVENTS];
+uint64_t trace_pos;
+__thread uint16_t trace_thread;
+
+static uint16_t trace_nb_threads;
+static char trace_path[1024];
+static uint32_t trace_tick_numer = 1;
+static uint32_t trace_tick_denom = 1;
+
+static const int TRACE_CRASH_SIGNALS[] = {SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT};
+#define TRACE_NB_CRASH_SIGNALS (sizeof(TRACE_CRASH_SIGNALS) / sizeof(TRACE_CRASH_SIGNALS[0]))
+static struct sigaction trace_prev_actions[TRACE_NB_CRASH_SIGNALS];
+
+uint16_t trace_thread_assign(void) {
+  trace_thread = __atomic_add_fetch(&trace_nb_threads, 1, __ATOMIC_RELAXED);
+  return trace_thread;
+}
+
+void trace_set_dump_path(const char* path) {
+#if defined(__APPLE__)
+  mach_timebase_info_data_t tb;
+  if (mach_timebase_info(&tb) == KERN_SUCCESS) {
+    trace_tick_numer = tb.numer;
+    trace_tick_denom = tb.denom;
+  }
+#endif
+  if (!path) {
+    trace_path[0] = '\0';
+    return;
+  }
+  strncpy(trace_path, path, sizeof(trace_path) - 1);
+  trace_path[sizeof(trace_path) - 1] = '\0';
+}
+
+const char* trace_dump_path(void) {
+  return trace_path[0] ? trace_path : NULL;
+}
+
+static int trace_write_all(int fd, const void* data, size_t len) {
+  const char* p = data;
+  while (len > 0) {
+    ssize_t n = write(fd, p, len);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    p += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+int trace_dump(const char* path) {
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return -1;
+
+  // Threads keep recording while this runs, so the oldest events may be overwritten by newer ones on the
+  // way out; the decoder orders events by time.
+  uint64_t pos = __atomic_load_n(&trace_pos, __ATOMIC_RELAXED);
+  uint32_t n = pos < TRACE_RING_EVENTS ? (uint32_t)pos : TRACE_RING_EVENTS;
+  TraceFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic));
+  header.version = TRACE_FILE_VERSION;
+  header.event_size = sizeof(TraceEvent);
+  header.tick_numer = trace_tick_numer;
+  header.tick_denom = trace_tick_denom;
+  header.nb_recorded = pos;
+  header.nb_events = n;
+  header.pid = (uint32_t)getpid();
+
+  size_t first = (size_t)((pos - n) & (TRACE_RING_EVENTS - 1));
+  size_t head = TRACE_RING_EVENTS - first < n ? TRACE_RING_EVENTS - first : n;
+  int ret = trace_write_all(fd, &header, sizeof(header));
+  if (ret == 0)
+    ret = trace_write_all(fd, &trace_ring[first], head * sizeof(TraceEvent));
+  if (ret == 0)
+    ret = trace_write_all(fd, &trace_ring[0], (n - head) * sizeof(TraceEvent));
+  int saved = errno;
+  close(fd);
+  errno = saved;
+  return ret;
+}
+
+int trace_dump_default(void) {
+  if (!trace_path[0]) {
+    errno = ENOENT;
+    return -1;
+  }
+  return trace_dump(trace_path);
+}
+
+static void trace_on_usr1(int sig) {
+  (void)sig;
+  int saved = errno;
+  trace_dump_default();
+  errno = saved;
+}
+
+static void trace_on_crash(int sig) {
+  trace_dump_default();
+  for (size_t i = 0; i < TRACE_NB_CRASH_SIGNALS; ++i) {
+    if (TRACE_CRASH_SIGNALS[i] == sig)
+      sigaction(sig, &trace_prev_actions[i], NULL);
+  }
+  raise(sig);
+}
+
+void trace_install_handlers(void) {
+  static int installed;
+  if (__atomic_exchange_n(&installed, 1, __ATOMIC_SEQ_CST))
+    return;
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESTART;
+  sa.sa_handler = trace_on_usr1;
+  sigaction(SIGUSR1, &sa, NULL);
+
+  sa.sa_flags = 0;
+  sa.sa_handler = trace_on_crash;
+  for (size_t i = 0; i < TRACE_NB_CRASH_SIGNALS; ++i)
+    sigaction(TRACE_CRASH_SIGNALS[i], &sa, &trace_prev_actions[i]);
+}
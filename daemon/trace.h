@@ -0,0 +1,105 @@
+#pragma once
+
+#ifndef DAEMON_TRACE_H_
+#define DAEMON_TRACE_H_
+
+#include <stdint.h>
+
+#if defined(__APPLE__)
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Flight recorder: an always-on ring of the last TRACE_RING_EVENTS timestamped events, for working out
+// after the fact where time went ("the switcher was slow"). Recording is a clock read, one relaxed atomic
+// increment and a 16-byte store; nothing is formatted. The ring is written out with trace_dump() (on
+// SIGUSR1, on a crash, and when the engine shuts down) and read with scripts/trace_decode.py.
+#define TRACE_RING_EVENTS 32768  // Power of two.
+
+// What happened. Values are part of the dump format: append only, and keep scripts/trace_decode.py in step.
+typedef enum TraceKind {
+  TRACE_NONE = 0,
+  TRACE_WS_RECEIVED = 1,    // arg: message length.
+  TRACE_WS_DISPATCHED = 2,  // arg: TabEventType. The message passed the gate and is about to be decoded.
+  TRACE_WS_HANDLED = 3,     // arg: TabEventType. Handler and resulting GUI updates done.
+  TRACE_WS_DROPPED = 4,     // arg: TabEventType. Turned away by the gate.
+  TRACE_WS_QUEUED = 5,      // arg: payload length. A message for the extension was queued.
+  TRACE_WS_SENT = 6,        // arg: payload length. ...and written to the socket.
+  TRACE_GUI_RECEIVED = 7,   // arg: message length.
+  TRACE_GUI_HANDLED = 8,    // arg: GuiEventType.
+  TRACE_UDS_SENT = 9,       // arg: frame length.
+  TRACE_HOTKEY_TOGGLE = 10,
+} TraceKind;
+
+typedef struct TraceEvent {
+  uint64_t ticks;  // trace_now(); see TraceFileHeader for the unit.
+  uint32_t arg;
+  uint16_t kind;    // TraceKind.
+  uint16_t thread;  // Small per-thread number, from 1 in order of first use.
+} TraceEvent;
+
+extern TraceEvent trace_ring[TRACE_RING_EVENTS];
+// Events recorded so far; the next goes to trace_pos % TRACE_RING_EVENTS. Accessed with __atomic builtins.
+extern uint64_t trace_pos;
+extern __thread uint16_t trace_thread;
+uint16_t trace_thread_assign(void);
+
+static inline uint64_t trace_now(void) {
+#if defined(__APPLE__)
+  return mach_absolute_time();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static inline void trace_record(TraceKind kind, uint32_t arg) {
+  uint16_t thread = trace_thread ? trace_thread : trace_thread_assign();
+  uint64_t pos = __atomic_fetch_add(&trace_pos, 1, __ATOMIC_RELAXED);
+  TraceEvent* e = &trace_ring[pos & (TRACE_RING_EVENTS - 1)];
+  e->ticks = trace_now();
+  e->arg = arg;
+  e->kind = (uint16_t)kind;
+  e->thread = thread;
+}
+
+// Dump file layout: this header, then the recorded events oldest first (at most TRACE_RING_EVENTS).
+// Native byte order.
+#define TRACE_FILE_MAGIC "LOTABTRC"
+#define TRACE_FILE_VERSION 1
+
+typedef struct TraceFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t event_size;  // sizeof(TraceEvent).
+  // Nanoseconds = ticks * tick_numer / tick_denom.
+  uint32_t tick_numer;
+  uint32_t tick_denom;
+  uint64_t nb_recorded;  // Since start; more than the events that follow once the ring has wrapped.
+  uint32_t nb_events;
+  uint32_t pid;
+} TraceFileHeader;
+
+// Sets where trace_dump_default() and the signal handlers write. Call before trace_install_handlers().
+void trace_set_dump_path(const char* path);
+// @returns the dump path set, or NULL.
+const char* trace_dump_path(void);
+// Writes the ring to `path`. Async-signal-safe: only open()/write()/close(), no allocation.
+// @returns 0 on success, -1 with errno set otherwise.
+int trace_dump(const char* path);
+int trace_dump_default(void);
+// Dumps to the set path on SIGUSR1, and on SIGSEGV/SIGBUS/SIGILL/SIGFPE/SIGABRT before handing the
+// signal on to whatever handled it before.
+void trace_install_handlers(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // DAEMON_TRACE_H_
@@ -1,16 +1,20 @@
 #include "util.h"
 
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <errno.h>
 #include <pthread.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <time.h>
 #include <unistd.h>
 
-static LogLevel g_log_level = LOG_LEVEL_INFO;
+LogLevel g_log_level = LOG_LEVEL_INFO;
 
 char log_level_str(LogLevel level) {
   switch (level) {
@@ -25,21 +29,48 @@ char log_level_str(LogLevel level) {
   }
 }
 
-void vlog(LogLevel level, void* cls, const char* fmt, ...) {
-  if (level > g_log_level) {
-    return;
-  }
-  char buf[2048];
-  va_list args;
-  va_start(args, fmt);
-  vsnprintf(buf, sizeof(buf), fmt, args);
-  va_end(args);
+// Records go from the logging thread to a writer thread through a bounded lock-free ring (Vyukov's
+// bounded queue, with a single consumer), so that no caller ever waits on stdout. The caller formats the
+// message into its slot; the writer adds the prefix and does the I/O. A full ring drops the record and
+// counts it, and the writer reports the count once it catches up.
+#define LOG_RING_SLOTS 512  // Power of two.
+// The size of the stack buffer messages used to be formatted into; TRACE lines carry whole payloads, so the
+// ring holds 1 MiB rather than cut them shorter.
+#define LOG_TEXT_MAX 2048
+// How long the idle writer sleeps before looking again, should a wake-up have been missed.
+#define LOG_IDLE_WAIT_NS 100000000
+
+typedef struct LogRecord {
+  // Slot `i` is free for the producer at position p (p % LOG_RING_SLOTS == i) once seq == p, and ready
+  // for the writer once seq == p + 1.
+  atomic_size_t seq;
+  LogLevel level;
+  uint64_t tid;
+  const struct EngClass* cls;
+  char text[LOG_TEXT_MAX];
+} LogRecord;
 
+static struct {
+  LogRecord slots[LOG_RING_SLOTS];
+  _Alignas(64) atomic_size_t head;  // Next position to claim.
+  _Alignas(64) atomic_size_t tail;  // Next position to write out; only the writer advances it.
+  atomic_uint_fast64_t dropped;     // Since the writer last reported.
+  atomic_uint_fast64_t nb_written;
+  atomic_uint_fast64_t nb_dropped;
+  atomic_int sleeping;
+  atomic_int stop;
+  atomic_int sync;  // No writer thread (it failed to start, or the process is exiting): write in place.
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t wake;
+} g_log = {.mutex = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER};
+static pthread_once_t g_log_once = PTHREAD_ONCE_INIT;
+
+static void log_emit(LogLevel level, const struct EngClass* ecls, uint64_t tid, const char* buf) {
   FILE* f = stdout;
   if (level == LOG_LEVEL_ERROR)
     f = stderr;
 
-  struct EngClass* ecls = cls == NULL ? NULL : *(struct EngClass**)cls;
   char l_prefix = log_level_str(level);
 
   const char* color = "";
@@ -60,16 +91,178 @@ void vlog(LogLevel level, void* cls, const char* fmt, ...) {
     default:
       break;
   }
-  uint64_t tid;
-  pthread_threadid_np(NULL, &tid);
   fprintf(f, "%s%c %d:%llu [%s @ %p]%s %s", color, l_prefix, getpid(), tid, ecls ? ecls->name : "null", (void*)ecls,
           reset, buf);
 }
 
+// Writes out every record that is ready. @returns how many there were.
+static size_t log_drain(void) {
+  size_t n = 0;
+  size_t tail = atomic_load_explicit(&g_log.tail, memory_order_relaxed);
+  for (;;) {
+    LogRecord* r = &g_log.slots[tail & (LOG_RING_SLOTS - 1)];
+    if (atomic_load_explicit(&r->seq, memory_order_acquire) != tail + 1)
+      break;
+    log_emit(r->level, r->cls, r->tid, r->text);
+    atomic_store_explicit(&r->seq, tail + LOG_RING_SLOTS, memory_order_release);
+    atomic_fetch_add_explicit(&g_log.nb_written, 1, memory_order_relaxed);
+    atomic_store_explicit(&g_log.tail, ++tail, memory_order_release);
+    ++n;
+  }
+  uint64_t dropped = atomic_exchange_explicit(&g_log.dropped, 0, memory_order_relaxed);
+  if (dropped) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "log ring full, dropped %llu messages\n", (unsigned long long)dropped);
+    log_emit(LOG_LEVEL_WARN, NULL, 0, buf);
+  }
+  if (n || dropped) {
+    fflush(stdout);
+    fflush(stderr);
+  }
+  return n;
+}
+
+static int log_ready(void) {
+  size_t tail = atomic_load_explicit(&g_log.tail, memory_order_relaxed);
+  return atomic_load_explicit(&g_log.slots[tail & (LOG_RING_SLOTS - 1)].seq, memory_order_acquire) == tail + 1;
+}
+
+static void* log_thread_run(void* arg) {
+  (void)arg;
+  while (!atomic_load(&g_log.stop)) {
+    if (log_drain())
+      continue;
+    pthread_mutex_lock(&g_log.mutex);
+    // Announce the sleep before the last look, so that a producer either sees it and signals or published
+    // its record before that look.
+    atomic_store(&g_log.sleeping, 1);
+    if (!log_ready() && !atomic_load(&g_log.stop)) {
+      struct timespec deadline;
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      deadline.tv_nsec += LOG_IDLE_WAIT_NS;
+      if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000;
+      }
+      pthread_cond_timedwait(&g_log.wake, &g_log.mutex, &deadline);
+    }
+    atomic_store(&g_log.sleeping, 0);
+    pthread_mutex_unlock(&g_log.mutex);
+  }
+  log_drain();
+  return NULL;
+}
+
+static void log_stop(void) {
+  atomic_store(&g_log.stop, 1);
+  pthread_mutex_lock(&g_log.mutex);
+  pthread_cond_signal(&g_log.wake);
+  pthread_mutex_unlock(&g_log.mutex);
+  pthread_join(g_log.thread, NULL);
+  // Whatever is logged from here on (other atexit handlers, threads still winding down) is written in place.
+  atomic_store(&g_log.sync, 1);
+  log_drain();
+}
+
+static void log_start(void) {
+  for (size_t i = 0; i < LOG_RING_SLOTS; ++i)
+    atomic_init(&g_log.slots[i].seq, i);
+  if (pthread_create(&g_log.thread, NULL, log_thread_run, NULL) != 0) {
+    atomic_store(&g_log.sync, 1);
+    return;
+  }
+  atexit(log_stop);
+}
+
+void vlog_write(LogLevel level, void* cls, const char* fmt, ...) {
+  pthread_once(&g_log_once, log_start);
+
+  struct EngClass* ecls = cls == NULL ? NULL : *(struct EngClass**)cls;
+  uint64_t tid;
+  pthread_threadid_np(NULL, &tid);
+  va_list args;
+  va_start(args, fmt);
+
+  if (atomic_load_explicit(&g_log.sync, memory_order_relaxed)) {
+    char buf[LOG_TEXT_MAX];
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    log_emit(level, ecls, tid, buf);
+    return;
+  }
+
+  // Claim a slot.
+  size_t pos = atomic_load_explicit(&g_log.head, memory_order_relaxed);
+  LogRecord* r;
+  for (;;) {
+    r = &g_log.slots[pos & (LOG_RING_SLOTS - 1)];
+    size_t seq = atomic_load_explicit(&r->seq, memory_order_acquire);
+    intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&g_log.head, &pos, pos + 1, memory_order_relaxed,
+                                                memory_order_relaxed))
+        break;
+    } else if (diff < 0) {
+      // The writer is a whole ring behind.
+      va_end(args);
+      atomic_fetch_add_explicit(&g_log.dropped, 1, memory_order_relaxed);
+      atomic_fetch_add_explicit(&g_log.nb_dropped, 1, memory_order_relaxed);
+      return;
+    } else {
+      pos = atomic_load_explicit(&g_log.head, memory_order_relaxed);
+    }
+  }
+
+  r->level = level;
+  r->cls = ecls;
+  r->tid = tid;
+  vsnprintf(r->text, sizeof(r->text), fmt, args);
+  va_end(args);
+  atomic_store_explicit(&r->seq, pos + 1, memory_order_release);
+
+  // Pairs with the writer's store to `sleeping` before its last look at the ring.
+  atomic_thread_fence(memory_order_seq_cst);
+  if (atomic_load_explicit(&g_log.sleeping, memory_order_relaxed))
+    pthread_cond_signal(&g_log.wake);
+}
+
+void vlog_flush(void) {
+  pthread_once(&g_log_once, log_start);
+  size_t head = atomic_load(&g_log.head);
+  while (!atomic_load(&g_log.sync) && atomic_load_explicit(&g_log.tail, memory_order_acquire) < head) {
+    pthread_cond_signal(&g_log.wake);
+    usleep(1000);
+  }
+  fflush(stdout);
+  fflush(stderr);
+}
+
+LogStats vlog_stats(void) {
+  return (LogStats){.nb_written = atomic_load(&g_log.nb_written), .nb_dropped = atomic_load(&g_log.nb_dropped)};
+}
+
 void vlog_s(int level, struct EngClass* cls, const char* msg) {
   vlog((LogLevel)level, &cls, "%s\n", msg);
 }
 
+int writev_all(int fd, struct iovec* iov, int iovcnt) {
+  while (iovcnt > 0) {
+    ssize_t n = writev(fd, iov, iovcnt);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    for (; iovcnt > 0 && (size_t)n >= iov->iov_len; ++iov, --iovcnt)
+      n -= (ssize_t)iov->iov_len;
+    if (iovcnt > 0) {
+      iov->iov_base = (char*)iov->iov_base + n;
+      iov->iov_len -= (size_t)n;
+    }
+  }
+  return 0;
+}
+
 void engine_set_log_level(int level) {
   g_log_level = (LogLevel)level;
 }
@@ -3,6 +3,8 @@
 #ifndef DAEMON_UTIL_H_
 #define DAEMON_UTIL_H_
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -18,8 +20,44 @@ void vlog_s(NsLogLevel level, struct EngClass* cls, const char* msg);
 #endif
 typedef enum { LOG_LEVEL_WARN = 0, LOG_LEVEL_ERROR = 1, LOG_LEVEL_INFO = 2, LOG_LEVEL_TRACE = 3 } LogLevel;
 
-// Log a message with the specified level
-void vlog(LogLevel level, void* cls, const char* fmt, ...);
+// Least severe level compiled in at all; calls above it vanish from the binary. Release builds set it to
+// LOG_LEVEL_INFO (see meson.build).
+#ifndef LOTAB_LOG_MIN_LEVEL
+#define LOTAB_LOG_MIN_LEVEL LOG_LEVEL_TRACE
+#endif
+
+// Runtime level, set with engine_set_log_level(). Read through vlog_enabled().
+extern LogLevel g_log_level;
+
+// Whether a message at `level` would be written. For guarding work done only to build log arguments.
+#define vlog_enabled(level) ((level) <= LOTAB_LOG_MIN_LEVEL && (level) <= g_log_level)
+
+// Log a message with the specified level. The level is checked at the call site, so the arguments of a
+// disabled message are never evaluated.
+#define vlog(level, cls, ...)                  \
+  do {                                         \
+    if (vlog_enabled(level))                   \
+      vlog_write((level), (cls), __VA_ARGS__); \
+  } while (0)
+
+// Writes unconditionally; use vlog(). The message is formatted on the calling thread and written out by a
+// background thread, so callers never wait on the output. Messages longer than 2 KiB are truncated, and
+// when logging outpaces the output they are dropped (and counted) rather than queued without bound.
+void vlog_write(LogLevel level, void* cls, const char* fmt, ...);
+// Waits until everything logged so far has been written out.
+void vlog_flush(void);
+
+typedef struct LogStats {
+  uint64_t nb_written;
+  uint64_t nb_dropped;
+} LogStats;
+LogStats vlog_stats(void);
+
+struct iovec;
+// Writes all of `iov` to `fd` as writev() would, carrying on after short writes and EINTR. Advances `iov`
+// as it goes. @returns 0 once everything is written, -1 with errno set on error.
+int writev_all(int fd, struct iovec* iov, int iovcnt);
+
 void engine_set_log_level(int level);
 int engine_get_log_level(void);
 
@@ -58,6 +58,8 @@ function sendAllTabs() {
             const reduced_tabs = await Promise.all(tabs.map(async t => ({
                 title: t.title,
                 id: t.id,
+                windowId: t.windowId,
+                index: t.index,
                 url: t.url,
                 active: t.active,
                 groupId: t.groupId,
@@ -164,6 +166,7 @@ function connectToDaemon() {
                     const createTitle = createData.title;
                     const createColor = createData.color;
                     const createTabIds = createData.tabIds;
+                    const createRequestId = createData.requestId;
 
                     if (createTabIds && createTabIds.length > 0) {
                         const cIds = createTabIds.map(id => parseInt(id)).filter(Number.isInteger);
@@ -180,6 +183,13 @@ function connectToDaemon() {
                                         console.error("CreateTabGroupRequest error (update):", chrome.runtime.lastError);
                                     }
                                     console.log(`Created group ${newGroupId} with title "${createTitle}"`);
+                                    // Echo the request id so the daemon binds its task to this group
+                                    if (Number.isInteger(createRequestId)) {
+                                        logEvent('Extension::WS::TabGroupCreateResponse', {
+                                            requestId: createRequestId,
+                                            group: group || { id: newGroupId, title: createTitle, color: createColor }
+                                        });
+                                    }
                                     sendAllTabs();
                                 });
                             }
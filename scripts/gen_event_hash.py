@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""Generates constant-time event-name lookups from an events .def file.
+
+  gen_event_hash.py <input.def> <output.h>
+
+Each channel becomes a `static inline` lookup function backed by a perfect hash: a seeded FNV-1a over the
+bytes after the prefix all of the channel's names share, whose top bits index a power-of-two table with
+no collisions. (The top bits, because the low bits of FNV only ever see the low bits of the seed.) A
+lookup is then one hash, one probe and one confirming compare.
+"""
+
+import os
+import sys
+
+FNV_PRIME = 16777619
+MAX_SEEDS = 1 << 16
+
+
+def fnv1a(seed, data):
+    h = seed
+    for b in data:
+        h ^= b
+        h = (h * FNV_PRIME) & 0xFFFFFFFF
+    return h
+
+
+def parse(path):
+    channels = []
+    with open(path, encoding="utf-8") as f:
+        for lineno, raw in enumerate(f, 1):
+            line = raw.split("#", 1)[0].split()
+            if not line:
+                continue
+            if line[0] == "channel":
+                if len(line) not in (4, 5) or (len(line) == 5 and line[4] != "define"):
+                    sys.exit(f"{path}:{lineno}: expected 'channel <function> <enum type> <unknown> [define]'")
+                channels.append({
+                    "function": line[1],
+                    "type": line[2],
+                    "unknown": line[3],
+                    "define": len(line) == 5,
+                    "events": [],
+                })
+            elif len(line) == 2 and channels:
+                channels[-1]["events"].append((line[0], line[1]))
+            else:
+                sys.exit(f"{path}:{lineno}: expected '<event name> <enum value>' after a channel line")
+    for ch in channels:
+        names = [name for name, _ in ch["events"]]
+        if not names:
+            sys.exit(f"{path}: channel {ch['function']} has no events")
+        if len(set(names)) != len(names):
+            sys.exit(f"{path}: channel {ch['function']} lists an event twice")
+    return channels
+
+
+def common_prefix_len(names):
+    first, last = min(names), max(names)
+    n = 0
+    while n < len(first) and n < len(last) and first[n] == last[n]:
+        n += 1
+    return n
+
+
+def slot_of(seed, shift, key):
+    return fnv1a(seed, key) >> shift
+
+
+def find_perfect_hash(keys):
+    bits = 1
+    while (1 << bits) < 2 * len(keys):
+        bits += 1
+    while True:
+        for seed in range(1, MAX_SEEDS):
+            seed = fnv1a(2166136261, seed.to_bytes(4, "little"))
+            if len({slot_of(seed, 32 - bits, k) for k in keys}) == len(keys):
+                return seed, bits
+        bits += 1
+
+
+def emit_channel(out, ch):
+    names = [name for name, _ in ch["events"]]
+    prefix = common_prefix_len(names)
+    # Keep at least one byte to hash so that a name equal to the prefix still gets a slot of its own.
+    prefix = min(prefix, min(len(n) for n in names) - 1)
+    seed, bits = find_perfect_hash([n[prefix:].encode() for n in names])
+    size = 1 << bits
+
+    if ch["define"]:
+        out.append("typedef enum {")
+        for _, value in ch["events"]:
+            out.append(f"  {value},")
+        out.append(f"  {ch['unknown']}")
+        out.append(f"}} {ch['type']};")
+        out.append("")
+
+    slots = sorted((slot_of(seed, 32 - bits, n[prefix:].encode()), n, v) for n, v in ch["events"])
+    out.append(f"// {len(names)} names in {size} slots; hashes the bytes after the {prefix}-byte shared prefix.")
+    out.append(f"static inline {ch['type']} {ch['function']}(const char* name) {{")
+    out.append("  static const struct {")
+    out.append("    const char* name;")
+    out.append("    uint32_t len;")
+    out.append(f"    {ch['type']} value;")
+    out.append(f"  }} slots[{size}] = {{")
+    for slot, name, value in slots:
+        out.append(f'      [{slot}] = {{"{name}", {len(name)}, {value}}},')
+    out.append("  };")
+    out.append("  size_t len = strlen(name);")
+    out.append(f"  if (len <= {prefix})")
+    out.append(f"    return {ch['unknown']};")
+    out.append(f"  uint32_t h = 0x{seed:08x}u;")
+    out.append(f"  for (size_t i = {prefix}; i < len; ++i) {{")
+    out.append("    h ^= (uint8_t)name[i];")
+    out.append(f"    h *= {FNV_PRIME}u;")
+    out.append("  }")
+    out.append(f"  uint32_t slot = h >> {32 - bits};")
+    out.append("  if (slots[slot].name && slots[slot].len == len && memcmp(slots[slot].name, name, len) == 0)")
+    out.append("    return slots[slot].value;")
+    out.append(f"  return {ch['unknown']};")
+    out.append("}")
+    out.append("")
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    src, dst = sys.argv[1], sys.argv[2]
+    guard = os.path.basename(dst).upper().replace(".", "_").replace("-", "_") + "_"
+    out = [
+        f"// Generated by scripts/gen_event_hash.py from {os.path.basename(src)}. Do not edit.",
+        f"#ifndef {guard}",
+        f"#define {guard}",
+        "",
+        "#include <stdint.h>",
+        "#include <string.h>",
+        "",
+    ]
+    for ch in parse(src):
+        emit_channel(out, ch)
+    out.append(f"#endif  // {guard}")
+    with open(dst, "w", encoding="utf-8") as f:
+        f.write("\n".join(out) + "\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+"""Turns a daemon flight-recorder dump (see daemon/trace.h) into a per-event latency breakdown.
+
+  trace_decode.py <dump> [--events]
+
+The daemon writes the dump on SIGUSR1 (`kill -USR1 <pid>`), on a crash and at shutdown, next to the daemon
+manifest or else to ~/.lotab/daemon.trace. Spans are rebuilt by pairing events recorded on the same
+thread:
+
+  ws gate      message received -> event type resolved and accepted or dropped
+  ws handle    accepted -> handler and the GUI updates it caused are done
+  ws total     received -> done
+  gui handle   GUI command received -> handled
+  hotkey       toggle received -> last UDS frame it sent (the ToggleGuiRequest)
+  ws outbox    message queued for the extension -> written to its socket (in queue order)
+
+--events also prints the raw timeline. Event names come from daemon/engine_events.def, whose order gives
+the enum values.
+"""
+
+import os
+import struct
+import sys
+from collections import defaultdict
+
+HEADER = struct.Struct("=8sIIIIQII")
+EVENT = struct.Struct("=QIHH")
+MAGIC = b"LOTABTRC"
+
+# TraceKind in daemon/trace.h.
+KINDS = {
+    1: "WS_RECEIVED",
+    2: "WS_DISPATCHED",
+    3: "WS_HANDLED",
+    4: "WS_DROPPED",
+    5: "WS_QUEUED",
+    6: "WS_SENT",
+    7: "GUI_RECEIVED",
+    8: "GUI_HANDLED",
+    9: "UDS_SENT",
+    10: "HOTKEY_TOGGLE",
+}
+
+DEF_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "daemon", "engine_events.def")
+
+
+def load_event_names(path):
+    """Maps each channel's lookup function to its event names, in enum order."""
+    names = defaultdict(list)
+    channel = None
+    try:
+        with open(path, encoding="utf-8") as f:
+            for raw in f:
+                line = raw.split("#", 1)[0].split()
+                if not line:
+                    continue
+                if line[0] == "channel":
+                    channel = line[1]
+                elif channel:
+                    names[channel].append(line[0].split("::")[-1])
+    except OSError:
+        pass
+    return names
+
+
+def label(names, channel, value):
+    table = names.get(channel, [])
+    return table[value] if value < len(table) else f"#{value}"
+
+
+def read_dump(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) < HEADER.size:
+        sys.exit(f"{path}: too short for a trace dump")
+    magic, version, event_size, numer, denom, nb_recorded, nb_events, pid = HEADER.unpack_from(data)
+    if magic != MAGIC or version != 1 or event_size != EVENT.size:
+        sys.exit(f"{path}: not a version 1 trace dump")
+    events = []
+    for i in range(nb_events):
+        off = HEADER.size + i * EVENT.size
+        if off + EVENT.size > len(data):
+            break
+        ticks, arg, kind, thread = EVENT.unpack_from(data, off)
+        if kind in KINDS:
+            events.append((ticks * numer / denom, KINDS[kind], arg, thread))
+    # Threads kept recording while the dump was written; order by time.
+    events.sort(key=lambda e: e[0])
+    return pid, nb_recorded, events
+
+
+def build_spans(events, names):
+    spans = defaultdict(list)
+    open_ws = {}  # thread -> (received ns, dispatched ns, type)
+    open_gui = {}
+    open_hotkey = {}  # thread -> (toggle ns, last UDS send ns)
+    outbox = []
+    for ns, kind, arg, thread in events:
+        if kind != "UDS_SENT" and thread in open_hotkey:
+            start, last = open_hotkey.pop(thread)
+            if last is not None:
+                spans["hotkey"].append(last - start)
+        if kind == "WS_RECEIVED":
+            open_ws[thread] = (ns, None, None)
+        elif kind in ("WS_DISPATCHED", "WS_DROPPED") and thread in open_ws:
+            received, _, _ = open_ws[thread]
+            name = label(names, "tab_event_lookup", arg)
+            spans[f"ws gate      {name}" + (" (dropped)" if kind == "WS_DROPPED" else "")].append(ns - received)
+            if kind == "WS_DISPATCHED":
+                open_ws[thread] = (received, ns, name)
+            else:
+                del open_ws[thread]
+        elif kind == "WS_HANDLED" and thread in open_ws:
+            received, dispatched, name = open_ws.pop(thread)
+            if dispatched is not None:
+                spans[f"ws handle    {name}"].append(ns - dispatched)
+                spans[f"ws total     {name}"].append(ns - received)
+        elif kind == "GUI_RECEIVED":
+            open_gui[thread] = ns
+        elif kind == "GUI_HANDLED" and thread in open_gui:
+            spans[f"gui handle   {label(names, 'gui_event_lookup', arg)}"].append(ns - open_gui.pop(thread))
+        elif kind == "HOTKEY_TOGGLE":
+            open_hotkey[thread] = (ns, None)
+        elif kind == "UDS_SENT" and thread in open_hotkey:
+            open_hotkey[thread] = (open_hotkey[thread][0], ns)
+        elif kind == "WS_QUEUED":
+            outbox.append(ns)
+        elif kind == "WS_SENT" and outbox:
+            spans["ws outbox"].append(ns - outbox.pop(0))
+    for start, last in open_hotkey.values():
+        if last is not None:
+            spans["hotkey"].append(last - start)
+    return spans
+
+
+def percentile(sorted_values, p):
+    return sorted_values[min(len(sorted_values) - 1, int(p / 100 * len(sorted_values)))]
+
+
+def main():
+    args = [a for a in sys.argv[1:] if not a.startswith("--")]
+    if len(args) != 1:
+        sys.exit(__doc__)
+    pid, nb_recorded, events = read_dump(args[0])
+    names = load_event_names(DEF_PATH)
+
+    print(f"pid {pid}: {len(events)} events of {nb_recorded} recorded")
+    if "--events" in sys.argv and events:
+        t0 = events[0][0]
+        for ns, kind, arg, thread in events:
+            print(f"{(ns - t0) / 1000:12.1f} us  t{thread:<3} {kind:<14} {arg}")
+        print()
+
+    spans = build_spans(events, names)
+    print(f"{'span':<48} {'count':>7} {'p50 us':>9} {'p90 us':>9} {'p99 us':>9} {'max us':>9} {'total ms':>9}")
+    for key in sorted(spans):
+        values = sorted(spans[key])
+        print(
+            f"{key:<48} {len(values):>7} {percentile(values, 50) / 1000:>9.1f} {percentile(values, 90) / 1000:>9.1f} "
+            f"{percentile(values, 99) / 1000:>9.1f} {values[-1] / 1000:>9.1f} {sum(values) / 1e6:>9.2f}"
+        )
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,94 @@
+#include "arena.h"
+
+#include <cJSON.h>
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Allocates about `bytes` in pieces the size cJSON asks for, checking none of them overlap.
+void Fill(Arena* a, size_t bytes) {
+  std::vector<std::pair<unsigned char*, size_t>> blocks;
+  for (size_t total = 0, i = 0; total < bytes; ++i) {
+    size_t size = 1 + (i * 37) % 200;
+    auto* p = static_cast<unsigned char*>(arena_alloc(a, size));
+    ASSERT_NE(p, nullptr);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % 16, 0u);
+    EXPECT_TRUE(arena_owns(a, p));
+    memset(p, (int)(i & 0xFF), size);
+    blocks.emplace_back(p, size);
+    total += size;
+  }
+  for (size_t i = 0; i < blocks.size(); ++i)
+    for (size_t j = 0; j < blocks[i].second; ++j)
+      ASSERT_EQ(blocks[i].first[j], (unsigned char)(i & 0xFF));
+}
+
+}  // namespace
+
+TEST(ArenaTest, SteadyStateStaysOffTheSystemAllocator) {
+  Arena a{};
+  for (size_t bytes : {1000, 500000, 3000000}) {
+    arena_enter(&a);
+    Fill(&a, bytes);
+    arena_leave(&a);
+    // The first message of a new size grows the arena; the same traffic afterwards allocates nothing.
+    uint64_t chunks = a.nb_chunk_allocs;
+    for (int round = 0; round < 3; ++round) {
+      arena_enter(&a);
+      Fill(&a, bytes);
+      arena_leave(&a);
+    }
+    EXPECT_EQ(a.nb_chunk_allocs, chunks) << bytes;
+    EXPECT_EQ(a.in_use, 0u);
+  }
+  arena_destroy(&a);
+  EXPECT_EQ(a.head, nullptr);
+}
+
+TEST(ArenaTest, HooksFollowTheThreadsArena) {
+  Arena a{};
+  // Outside a message the system allocator is used, and its memory may be released inside one.
+  void* outside = arena_malloc(32);
+  EXPECT_FALSE(arena_owns(&a, outside));
+
+  arena_enter(&a);
+  arena_enter(&a);  // Nested scopes share the outer one's lifetime.
+  void* inside = arena_malloc(32);
+  EXPECT_TRUE(arena_owns(&a, inside));
+  arena_free(inside);
+  arena_free(outside);
+  arena_leave(&a);
+  EXPECT_GT(a.in_use, 0u);
+  arena_leave(&a);
+  EXPECT_EQ(a.in_use, 0u);
+  arena_destroy(&a);
+}
+
+TEST(ArenaTest, BacksCJson) {
+  cJSON_Hooks hooks = {arena_malloc, arena_free};
+  cJSON_InitHooks(&hooks);
+  Arena a{};
+  const char* text = R"({"event":"GUI::UDS::CreateTask","data":{"name":"Reading","tabHandles":[1,2,3]}})";
+  uint64_t chunks = 0;
+  for (int round = 0; round < 3; ++round) {
+    arena_enter(&a);
+    cJSON* json = cJSON_Parse(text);
+    ASSERT_NE(json, nullptr);
+    char* printed = cJSON_PrintUnformatted(json);
+    EXPECT_STREQ(printed, text);
+    EXPECT_TRUE(arena_owns(&a, printed));
+    cJSON_free(printed);
+    cJSON_Delete(json);
+    arena_leave(&a);
+    if (round == 0)
+      chunks = a.nb_chunk_allocs;
+  }
+  EXPECT_EQ(a.nb_chunk_allocs, chunks);
+  arena_destroy(&a);
+  cJSON_InitHooks(nullptr);
+}
@@ -5,18 +5,29 @@
 struct MockData {
   int tabs_count;
   char* last_tab_title;
+  uint32_t last_tab_handle;
+  int64_t last_tab_id;
+  int64_t last_tab_task_id;
   int tasks_count;
   char* last_task_name;
   bool ui_toggled;
+  int tabs_calls;
+  int64_t tab_ids[8];
 };
 
 void on_tabs_update(void* user_data, const LotabTabList* tabs) {
   MockData* data = (MockData*)user_data;
   data->tabs_count = (int)tabs->count;
+  data->tabs_calls++;
+  for (size_t i = 0; i < tabs->count && i < 8; ++i)
+    data->tab_ids[i] = tabs->tabs[i].id;
   if (tabs->count > 0 && tabs->tabs[0].title) {
     if (data->last_tab_title)
       free(data->last_tab_title);
     data->last_tab_title = strdup(tabs->tabs[0].title);
+    data->last_tab_handle = tabs->tabs[0].handle;
+    data->last_tab_id = tabs->tabs[0].id;
+    data->last_tab_task_id = tabs->tabs[0].task_id;
   }
 }
 
@@ -62,13 +73,27 @@ TEST_F(ClientTest, ParseTabsUpdate) {
         "event": "Daemon::UDS::TabsUpdate",
                             "data": {
                               "tabs":
-                              [ { "id": 1, "title": "Google", "active": true }]
+                              [ { "h": 4194307, "id": 1, "title": "Google", "active": true }]
                             }
                           })json";
   lotab_client_process_message(ctx, json);
 
   EXPECT_EQ(data.tabs_count, 1);
   EXPECT_STREQ(data.last_tab_title, "Google");
+  EXPECT_EQ(data.last_tab_handle, 4194307u);
+}
+
+TEST_F(ClientTest, ParseTabsUpdateIdsExactly) {
+  // Ids past 2^53 do not survive a double.
+  const char* json = R"json({"event":"Daemon::UDS::TabsUpdate","data":{"tabs":[{"h":7,"id":9007199254740993,)json"
+                     R"json("title":"A \"quoted\" tab","task_id":-9223372036854775807}]}})json";
+  lotab_client_process_message(ctx, json);
+
+  EXPECT_EQ(data.tabs_count, 1);
+  EXPECT_EQ(data.last_tab_id, 9007199254740993);
+  EXPECT_EQ(data.last_tab_task_id, -9223372036854775807);
+  EXPECT_STREQ(data.last_tab_title, "A \"quoted\" tab");
+  EXPECT_EQ(data.last_tab_handle, 7u);
 }
 
 TEST_F(ClientTest, ParseTasksUpdate) {
@@ -85,6 +110,71 @@ TEST_F(ClientTest, ParseTasksUpdate) {
   EXPECT_STREQ(data.last_task_name, "Buy Milk");
 }
 
+TEST_F(ClientTest, ApplyTabsDelta) {
+  lotab_client_process_message(ctx, R"json({"event":"Daemon::UDS::TabsUpdate","data":{"version":3,"tabs":[)json"
+                                    R"json({"h":1,"id":10,"title":"A"},{"h":2,"id":20,"title":"B"},)json"
+                                    R"json({"h":3,"id":30,"title":"C"}]}})json");
+  ASSERT_EQ(data.tabs_count, 3);
+
+  // B is renamed and moves after C, A goes away and D opens in front.
+  lotab_client_process_message(ctx, R"json({"event":"Daemon::UDS::TabsDelta","data":{"base":3,"version":5,)json"
+                                    R"json("tabs":[{"h":4,"id":40,"title":"D"},)json"
+                                    R"json({"h":2,"id":20,"title":"B2","after":3}],)json"
+                                    R"json("removed":[1]}})json");
+  EXPECT_EQ(data.tabs_calls, 2);
+  ASSERT_EQ(data.tabs_count, 3);
+  EXPECT_EQ(data.tab_ids[0], 40);
+  EXPECT_EQ(data.tab_ids[1], 30);
+  EXPECT_EQ(data.tab_ids[2], 20);
+  EXPECT_STREQ(data.last_tab_title, "D");
+
+  // Deltas chain on the version each one leaves.
+  lotab_client_process_message(ctx, R"json({"event":"Daemon::UDS::TabsDelta","data":{"base":5,"version":6,)json"
+                                    R"json("tabs":[{"h":4,"id":40,"title":"D2"}]}})json");
+  EXPECT_EQ(data.tabs_calls, 3);
+  EXPECT_EQ(data.tabs_count, 3);
+  EXPECT_STREQ(data.last_tab_title, "D2");
+}
+
+TEST_F(ClientTest, DeltaAfterGapWaitsForSnapshot) {
+  lotab_client_process_message(ctx, R"json({"event":"Daemon::UDS::TabsUpdate","data":{"version":3,"tabs":[)json"
+                                    R"json({"h":1,"id":10,"title":"A"}]}})json");
+  ASSERT_EQ(data.tabs_calls, 1);
+
+  // Version 4 never arrived: neither this delta nor the next one applies.
+  lotab_client_process_message(ctx, R"json({"event":"Daemon::UDS::TabsDelta","data":{"base":4,"version":5,)json"
+                                    R"json("tabs":[{"h":2,"id":20,"title":"B"}]}})json");
+  lotab_client_process_message(ctx, R"json({"event":"Daemon::UDS::TabsDelta","data":{"base":5,"version":6,)json"
+                                    R"json("tabs":[{"h":3,"id":30,"title":"C"}]}})json");
+  EXPECT_EQ(data.tabs_calls, 1);
+  EXPECT_EQ(data.tabs_count, 1);
+
+  lotab_client_process_message(ctx, R"json({"event":"Daemon::UDS::TabsUpdate","data":{"version":6,"tabs":[)json"
+                                    R"json({"h":1,"id":10,"title":"A"},{"h":3,"id":30,"title":"C"}]}})json");
+  EXPECT_EQ(data.tabs_calls, 2);
+  EXPECT_EQ(data.tabs_count, 2);
+}
+
+TEST_F(ClientTest, DeltaThatDoesNotFitIsDropped) {
+  lotab_client_process_message(ctx, R"json({"event":"Daemon::UDS::TabsUpdate","data":{"version":3,"tabs":[)json"
+                                    R"json({"h":1,"id":10,"title":"A"}]}})json");
+  // Follows a tab the client does not have.
+  lotab_client_process_message(ctx, R"json({"event":"Daemon::UDS::TabsDelta","data":{"base":3,"version":4,)json"
+                                    R"json("tabs":[{"h":2,"id":20,"title":"B","after":9}]}})json");
+  EXPECT_EQ(data.tabs_calls, 1);
+  EXPECT_EQ(data.tabs_count, 1);
+}
+
+TEST_F(ClientTest, ApplyTasksDelta) {
+  lotab_client_process_message(ctx, R"json({"event":"Daemon::UDS::TasksUpdate","data":{"version":2,"tasks":[)json"
+                                    R"json({"id":101,"name":"Buy Milk"},{"id":102,"name":"Walk"}]}})json");
+  ASSERT_EQ(data.tasks_count, 2);
+  lotab_client_process_message(ctx, R"json({"event":"Daemon::UDS::TasksDelta","data":{"base":2,"version":3,)json"
+                                    R"json("tasks":[],"removed":[101]}})json");
+  EXPECT_EQ(data.tasks_count, 1);
+  EXPECT_STREQ(data.last_task_name, "Walk");
+}
+
 TEST_F(ClientTest, ParseUIToggle) {
   const char* json = R"json({
         "event": "Daemon::UDS::ToggleGuiRequest"
@@ -3,17 +3,26 @@
 #include <cJSON.h>
 #include <gtest/gtest.h>
 #include <stdio.h>
+#include <atomic>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <tuple>
+#include <vector>
 
+#include "arena.h"
 #include "test_util.h"
 
 extern "C" {
+#include <fcntl.h>
 #include <libwebsockets.h>
+#include <pthread.h>
+#include <signal.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <sys/un.h>
+#include <unistd.h>
 }
 
 class EngineTest : public ::testing::Test {
@@ -37,6 +46,7 @@ class EngineTest : public ::testing::Test {
   }
 
   std::string config_uds_path_;
+  std::string config_dir_;
 
   void SetUp() override {
     engine_set_log_level(LOG_LEVEL_TRACE);
@@ -55,6 +65,9 @@ class EngineTest : public ::testing::Test {
     if (!config_uds_path_.empty()) {
       create_info.uds_path = config_uds_path_.c_str();
     }
+    if (!config_dir_.empty()) {
+      create_info.config_path = config_dir_.c_str();
+    }
 
     int ret = engine_init(&ectx_, create_info);
     ASSERT_EQ(ret, 0);
@@ -77,19 +90,18 @@ class EngineTest : public ::testing::Test {
     }
   }
 
-  void FindActiveTab(EngineContext* ectx, TabInfo** out_tab) {
+  void FindActiveTab(EngineContext* ectx, uint64_t* out_tab_id) {
     ASSERT_NE(ectx, nullptr);
-    ASSERT_NE(out_tab, nullptr);
+    ASSERT_NE(out_tab_id, nullptr);
     ASSERT_NE(ectx->tab_state, nullptr);
 
-    *out_tab = nullptr;
-    TabInfo* current = ectx->tab_state->tabs;
-    while (current) {
-      if (current->active) {
-        *out_tab = current;
+    *out_tab_id = 0;
+    const TabState* ts = ectx->tab_state;
+    for (uint32_t slot = 0; slot < ts->nb_slots; ++slot) {
+      if (tab_slot_live(ts, slot) && (ts->flags[slot] & TAB_FLAG_ACTIVE)) {
+        *out_tab_id = ts->ids[slot];
         return;
       }
-      current = current->next;
     }
   }
 };
@@ -111,6 +123,26 @@ class WebsockedAndUdsStreamTest : public EngineTest {
   void TearDown() override {
     EngineTest::TearDown();
   }
+
+  // Connects `client` as an extension and waits for the daemon's first request to it.
+  void ConnectBrowser(TestWebSocketClient& client) {
+    client.Connect(GetPort());
+    ASSERT_TRUE(client.IsConnected());
+    ASSERT_TRUE(client.WaitForEvent("Daemon::WS::AllTabsInfoRequest", 2000));
+  }
+
+  // Polls `done` until it holds or about `timeout_ms` have passed. @returns its last value.
+  template <typename Pred>
+  bool WaitUntil(Pred done, int timeout_ms = 1000) {
+    for (int i = 0; i < timeout_ms / 5 && !done(); ++i)
+      usleep(5000);
+    return done();
+  }
+
+  void WaitForTabs(int nb_tabs) {
+    ASSERT_TRUE(WaitUntil([&] { return ectx_->tab_state->nb_tabs == nb_tabs; }));
+    ASSERT_EQ(ectx_->tab_state->nb_tabs, nb_tabs);
+  }
 };
 
 TEST_F(WebsockedAndUdsStreamTest, ConnectsToCustomUDS_And_WS) {
@@ -156,6 +188,264 @@ TEST_F(WebsockedAndUdsStreamTest, ConnectsToCustomUDS_And_WS) {
   EXPECT_NE(received_msg.find("New Tab via WS"), std::string::npos);
 }
 
+TEST_F(WebsockedAndUdsStreamTest, GuiCommandsRouteToOwningBrowser) {
+  ASSERT_TRUE(server_->Accept(2)) << "Daemon did not connect to custom UDS path";
+
+  TestWebSocketClient browser_a;
+  TestWebSocketClient browser_b;
+  for (auto [client, id, tab] : {std::tuple{&browser_a, "browser-a", 100}, std::tuple{&browser_b, "browser-b", 200}}) {
+    ASSERT_NO_FATAL_FAILURE(ConnectBrowser(*client));
+    client->Send(std::string(R"({"event": "Extension::WS::RegisterBrowser", "data": {"browserId": ")") + id +
+                 R"("}})");
+    client->Send(std::string(R"({"event": "Extension::WS::TabCreated", "data": {"id": )") + std::to_string(tab) +
+                 R"(, "title": "Tab"}, "browserId": ")" + id + R"("})");
+  }
+  // Browser B also has a tab 100; only its handle tells the two apart.
+  browser_b.Send(
+      R"({"event": "Extension::WS::TabCreated", "data": {"id": 100, "title": "B"}, "browserId": "browser-b"})");
+  ASSERT_TRUE(server_->WaitForEvent("Daemon::UDS::TabsUpdate", 2000));
+  ASSERT_NO_FATAL_FAILURE(WaitForTabs(3));
+
+  ASSERT_TRUE(server_->Send(R"({"event": "GUI::UDS::TabSelected", "data": {"tabId": 200}})"));
+  ASSERT_TRUE(browser_b.WaitForEvent("Daemon::WS::ActivateTabRequest", 2000));
+  EXPECT_FALSE(browser_a.WaitForEvent("Daemon::WS::ActivateTabRequest", 500));
+
+  TabHandle b_100 = tab_state_find_browser_tab(ectx_->tab_state, "browser-b", 100);
+  ASSERT_NE(b_100, TAB_HANDLE_INVALID);
+  ASSERT_TRUE(server_->Send(R"({"event": "GUI::UDS::TabSelected", "data": {"tabHandle": )" + std::to_string(b_100) +
+                            "}}"));
+  ASSERT_TRUE(browser_b.WaitForEvent("Daemon::WS::ActivateTabRequest", 2000));
+  EXPECT_FALSE(browser_a.WaitForEvent("Daemon::WS::ActivateTabRequest", 500));
+
+  // A request spanning both browsers is split between them.
+  ASSERT_TRUE(server_->Send(R"({"event": "GUI::UDS::CloseTabsRequest", "data": {"tabIds": [100, 200]}})"));
+  ASSERT_TRUE(browser_a.WaitForEvent("Daemon::WS::CloseTabsRequest", 2000));
+  ASSERT_TRUE(browser_b.WaitForEvent("Daemon::WS::CloseTabsRequest", 2000));
+
+  // Ids go through as written, even past 2^53 where a double would round them.
+  ASSERT_TRUE(server_->Send(R"({"event": "GUI::UDS::CloseTabsRequest", "data": {"tabIds": [9007199254740993]}})"));
+  std::string msg;
+  ASSERT_TRUE(browser_b.WaitForEvent("Daemon::WS::CloseTabsRequest", 2000, &msg));
+  EXPECT_NE(msg.find("[9007199254740993]"), std::string::npos) << msg;
+}
+
+TEST_F(WebsockedAndUdsStreamTest, CommandsForDisconnectedBrowserAreDropped) {
+  ASSERT_TRUE(server_->Accept(2));
+  TestWebSocketClient browser_a;
+  TestWebSocketClient browser_b;
+  // Browser A connects last, so it is the session browser-less messages go to while it is there.
+  for (auto [client, id] : {std::pair{&browser_b, "browser-b"}, std::pair{&browser_a, "browser-a"}}) {
+    ASSERT_NO_FATAL_FAILURE(ConnectBrowser(*client));
+    client->Send(std::string(R"({"event": "Extension::WS::RegisterBrowser", "data": {"browserId": ")") + id +
+                 R"("}})");
+    // The same tab id in both browsers.
+    client->Send(std::string(R"({"event": "Extension::WS::TabCreated", "data": {"id": 100, "title": "Tab"}, )") +
+                 R"("browserId": ")" + id + R"("})");
+  }
+  ASSERT_NO_FATAL_FAILURE(WaitForTabs(2));
+  TabHandle a_100 = tab_state_find_browser_tab(ectx_->tab_state, "browser-a", 100);
+  ASSERT_NE(a_100, TAB_HANDLE_INVALID);
+
+  // Browser A's session is gone once a message for no browser in particular reaches B.
+  browser_a.Disconnect();
+  bool a_gone = false;
+  for (int i = 0; i < 50 && !a_gone; ++i) {
+    ASSERT_TRUE(server_->Send(R"({"event": "GUI::UDS::CloseTabsRequest", "data": {"tabIds": [999]}})"));
+    a_gone = browser_b.WaitForEvent("Daemon::WS::CloseTabsRequest", 100);
+  }
+  ASSERT_TRUE(a_gone);
+
+  // Browser B's tab 100 is another tab: commands for browser A's must not reach it.
+  ASSERT_TRUE(server_->Send(R"({"event": "GUI::UDS::TabSelected", "data": {"tabHandle": )" + std::to_string(a_100) +
+                            "}}"));
+  ASSERT_TRUE(server_->Send(R"({"event": "GUI::UDS::AssociateTabs", "data": {"taskId": 7, "tabHandles": [)" +
+                            std::to_string(a_100) + "]}}"));
+  EXPECT_FALSE(browser_b.WaitForEvent("Daemon::WS::ActivateTabRequest", 500));
+  EXPECT_FALSE(browser_b.WaitForEvent("Daemon::WS::GroupTabs", 500));
+}
+
+TEST_F(WebsockedAndUdsStreamTest, CreateTaskWithoutLiveTabsIsClaimedByName) {
+  ASSERT_TRUE(server_->Accept(2));
+  TestWebSocketClient client;
+  ASSERT_NO_FATAL_FAILURE(ConnectBrowser(client));
+  // A tab closed while the switcher was open leaves the GUI holding a stale handle.
+  client.Send(R"({"event": "Extension::WS::TabCreated", "data": {"id": 5, "title": "Closed"}})");
+  ASSERT_NO_FATAL_FAILURE(WaitForTabs(1));
+  TabHandle stale = tab_state_find_tab(ectx_->tab_state, 5);
+  client.Send(R"({"event": "Extension::WS::TabRemoved", "data": {"tabId": 5}})");
+  ASSERT_NO_FATAL_FAILURE(WaitForTabs(0));
+
+  int64_t group_id = 30;
+  for (std::string tabs : {std::string(R"("associateTabIds": [])"),
+                           R"("associateTabHandles": [)" + std::to_string(stale) + "]"}) {
+    std::string name = "Task " + std::to_string(group_id);
+    ASSERT_TRUE(server_->Send(R"({"event": "GUI::UDS::CreateTask", "data": {"name": ")" + name + R"(", )" + tabs +
+                              "}}"));
+    ASSERT_TRUE(WaitUntil([&] { return ectx_->task_state->nb_tasks == group_id - 29; }));
+    // No tabs, no group: the extension ignores an empty CreateTabGroupRequest and would never answer it.
+    EXPECT_FALSE(client.WaitForEvent("Daemon::WS::CreateTabGroupRequest", 500)) << tabs;
+
+    // So the task still waits for a group of its name.
+    client.Send(R"({"event": "Extension::WS::TabGroupUpdated", "data": {"id": )" + std::to_string(group_id) +
+                R"(, "title": ")" + name + R"(", "color": "red"}})");
+    ASSERT_TRUE(WaitUntil([&] { return task_state_find_by_external_id(ectx_->task_state, group_id) != nullptr; }));
+    EXPECT_STREQ(task_state_find_by_external_id(ectx_->task_state, group_id)->task_name, name.c_str()) << tabs;
+    EXPECT_EQ(ectx_->task_state->nb_tasks, group_id - 29) << tabs;
+    ++group_id;
+  }
+}
+
+class CoalescingTest : public WebsockedAndUdsStreamTest {
+ protected:
+  void SetUp() override {
+    char tmp_dir[] = "/tmp/lotab_test_coalesce_XXXXXX";
+    ASSERT_NE(mkdtemp(tmp_dir), nullptr);
+    config_dir_ = tmp_dir;
+    FILE* fp = fopen((config_dir_ + "/config.toml").c_str(), "w");
+    ASSERT_NE(fp, nullptr);
+    // Long enough that a push held back by the window cannot be mistaken for an immediate one.
+    fprintf(fp, "UiToggleKeybind = \"CMD+SHIFT+J\"\nNotifyCoalesceMs = 1000\n");
+    fclose(fp);
+    WebsockedAndUdsStreamTest::SetUp();
+  }
+
+  void TearDown() override {
+    WebsockedAndUdsStreamTest::TearDown();
+    std::string cmd = "rm -rf " + config_dir_;
+    system(cmd.c_str());
+  }
+
+  void SendTab(TestWebSocketClient& client, int id, const std::string& title) {
+    client.Send(R"({"event": "Extension::WS::TabCreated", "data": {"id": )" + std::to_string(id) + R"(, "title": ")" +
+                title + R"("}})");
+  }
+};
+
+TEST_F(CoalescingTest, BurstIsPushedOncePerWindow) {
+  ASSERT_EQ(ectx_->notify_coalesce_ms, 1000u);
+  ASSERT_TRUE(server_->Accept(2));
+  TestWebSocketClient client;
+  ASSERT_NO_FATAL_FAILURE(ConnectBrowser(client));
+
+  // The first change after a quiet period goes out at once.
+  SendTab(client, 1, "First");
+  ASSERT_TRUE(server_->WaitForEvent("Daemon::UDS::TabsUpdate", 500));
+
+  // The burst after it is applied as it arrives but reaches the GUI as one snapshot.
+  for (int i = 2; i <= 30; ++i)
+    SendTab(client, i, "Burst " + std::to_string(i));
+  WaitForTabs(30);
+  std::string msg;
+  ASSERT_TRUE(server_->WaitForEvent("Daemon::UDS::TabsUpdate", 2000, &msg));
+  EXPECT_NE(msg.find("Burst 30"), std::string::npos) << msg;
+  EXPECT_FALSE(server_->WaitForEvent("Daemon::UDS::TabsUpdate", 1500));
+}
+
+TEST_F(CoalescingTest, HotkeyFlushesPendingPush) {
+  ASSERT_TRUE(server_->Accept(2));
+  TestWebSocketClient client;
+  ASSERT_NO_FATAL_FAILURE(ConnectBrowser(client));
+
+  SendTab(client, 1, "First");
+  ASSERT_TRUE(server_->WaitForEvent("Daemon::UDS::TabsUpdate", 500));
+  SendTab(client, 2, "Held back");
+  WaitForTabs(2);
+
+  engine_handle_event(ectx_, EVENT_HOTKEY_TOGGLE, nullptr, nullptr);
+  std::string msg;
+  ASSERT_TRUE(server_->WaitForEvent("Daemon::UDS::TabsDelta", 500, &msg));
+  EXPECT_NE(msg.find("Held back"), std::string::npos) << msg;
+  ASSERT_TRUE(server_->WaitForEvent("Daemon::UDS::ToggleGuiRequest", 500));
+  // The window's own push then has nothing new to send.
+  EXPECT_FALSE(server_->WaitForEvent("Daemon::UDS::TabsUpdate", 1500));
+  EXPECT_FALSE(server_->WaitForEvent("Daemon::UDS::TabsDelta", 100));
+}
+
+TEST_F(CoalescingTest, SmallChangeIsPushedAsDelta) {
+  ASSERT_TRUE(server_->Accept(2));
+  TestWebSocketClient client;
+  ASSERT_NO_FATAL_FAILURE(ConnectBrowser(client));
+
+  for (int i = 1; i <= 4; ++i)
+    SendTab(client, i, "Tab " + std::to_string(i));
+  std::string msg;
+  // The first tab goes out at once, the other three in the window's full push.
+  ASSERT_TRUE(server_->WaitForEvent("Daemon::UDS::TabsUpdate", 500));
+  ASSERT_TRUE(server_->WaitForEvent("Daemon::UDS::TabsUpdate", 2000, &msg));
+  ASSERT_NE(msg.find("Tab 4"), std::string::npos) << msg;
+
+  client.Send(R"({"event": "Extension::WS::TabUpdated", "data": {"tabId": 3, "changeInfo": {"title": "Renamed"}, )"
+              R"("tab": {"id": 3, "title": "Renamed"}}})");
+  ASSERT_TRUE(server_->WaitForEvent("Daemon::UDS::TabsDelta", 2000, &msg));
+  // Only the renamed tab travels, along with the base it applies to.
+  EXPECT_NE(msg.find("Renamed"), std::string::npos) << msg;
+  EXPECT_NE(msg.find("\"base\""), std::string::npos) << msg;
+  EXPECT_EQ(msg.find("Tab 1"), std::string::npos) << msg;
+  EXPECT_EQ(msg.find("Tab 4"), std::string::npos) << msg;
+}
+
+TEST_F(CoalescingTest, TaskChangeIsPushedAsDelta) {
+  ASSERT_TRUE(server_->Accept(2));
+  TestWebSocketClient client;
+  ASSERT_NO_FATAL_FAILURE(ConnectBrowser(client));
+
+  auto send_group = [&](int id, const std::string& title) {
+    client.Send(R"({"event": "Extension::WS::TabGroupUpdated", "data": {"id": )" + std::to_string(id) +
+                R"(, "title": ")" + title + R"(", "color": "blue"}})");
+  };
+  for (int i = 1; i <= 6; ++i)
+    send_group(i, "Group " + std::to_string(i));
+  std::string msg;
+  ASSERT_TRUE(server_->WaitForEvent("Daemon::UDS::TasksUpdate", 500));
+  ASSERT_TRUE(server_->WaitForEvent("Daemon::UDS::TasksUpdate", 2000, &msg));
+  ASSERT_NE(msg.find("Group 6"), std::string::npos) << msg;
+
+  send_group(3, "Renamed");
+  ASSERT_TRUE(server_->WaitForEvent("Daemon::UDS::TasksDelta", 2000, &msg));
+  EXPECT_NE(msg.find("Renamed"), std::string::npos) << msg;
+  EXPECT_EQ(msg.find("Group"), std::string::npos) << msg;
+}
+
+TEST_F(CoalescingTest, HotkeySendsOnlyToggleWhenGuiIsCurrent) {
+  ASSERT_TRUE(server_->Accept(2));
+  TestWebSocketClient client;
+  ASSERT_NO_FATAL_FAILURE(ConnectBrowser(client));
+  SendTab(client, 1, "Only");
+  ASSERT_TRUE(server_->WaitForEvent("Daemon::UDS::TabsUpdate", 500));
+
+  for (int i = 0; i < 3; ++i) {
+    engine_handle_event(ectx_, EVENT_HOTKEY_TOGGLE, nullptr, nullptr);
+    ASSERT_TRUE(server_->WaitForEvent("Daemon::UDS::ToggleGuiRequest", 500));
+  }
+  EXPECT_FALSE(server_->WaitForEvent("Daemon::UDS::TabsUpdate", 200));
+  EXPECT_FALSE(server_->WaitForEvent("Daemon::UDS::TabsDelta", 100));
+  EXPECT_FALSE(server_->WaitForEvent("Daemon::UDS::TasksUpdate", 100));
+}
+
+TEST_F(CoalescingTest, SnapshotRequestResendsUnchangedSnapshot) {
+  ASSERT_TRUE(server_->Accept(2));
+  TestWebSocketClient client;
+  ASSERT_NO_FATAL_FAILURE(ConnectBrowser(client));
+  SendTab(client, 1, "Kept");
+  std::string first;
+  ASSERT_TRUE(server_->WaitForEvent("Daemon::UDS::TabsUpdate", 500, &first));
+
+  // Nothing changed in between: the GUI gets the very snapshot it had, version included, so deltas carry
+  // on from it.
+  ASSERT_TRUE(server_->Send(R"({"event": "GUI::UDS::SnapshotRequest"})"));
+  std::string again;
+  ASSERT_TRUE(server_->WaitForEvent("Daemon::UDS::TabsUpdate", 2000, &again));
+  EXPECT_EQ(again, first);
+
+  // After a change it is built afresh.
+  SendTab(client, 2, "New");
+  ASSERT_TRUE(server_->WaitForEvent("Daemon::UDS::TabsDelta", 2000));
+  ASSERT_TRUE(server_->Send(R"({"event": "GUI::UDS::SnapshotRequest"})"));
+  ASSERT_TRUE(server_->WaitForEvent("Daemon::UDS::TabsUpdate", 2000, &again));
+  EXPECT_NE(again.find("New"), std::string::npos) << again;
+  EXPECT_NE(again.find("Kept"), std::string::npos) << again;
+}
+
 int EngineTest::next_port_ = 9002;
 std::mutex EngineTest::port_mtx_;
 
@@ -188,10 +478,9 @@ TEST_F(EngineTest, EngineInit) {
   ASSERT_NE(ectx_->tab_state, nullptr);
   EXPECT_EQ(ectx_->tab_state->nb_tabs, 2);
 
-  TabInfo* active_tab = nullptr;
-  FindActiveTab(ectx_, &active_tab);
-  ASSERT_NE(active_tab, nullptr);
-  EXPECT_EQ(active_tab->id, 101ul);
+  uint64_t active_tab_id = 0;
+  FindActiveTab(ectx_, &active_tab_id);
+  EXPECT_EQ(active_tab_id, 101ul);
 }
 
 TEST_F(EngineTest, TabRemoved) {
@@ -232,9 +521,8 @@ TEST_F(EngineTest, TabRemoved) {
 
   // 3. Verify Removal
   EXPECT_EQ(ectx_->tab_state->nb_tabs, 1);
-  TabInfo* current = ectx_->tab_state->tabs;
-  ASSERT_NE(current, nullptr);
-  EXPECT_EQ(current->id, 202ul);
+  EXPECT_EQ(tab_state_find_tab(ectx_->tab_state, 201), TAB_HANDLE_INVALID);
+  EXPECT_NE(tab_state_find_tab(ectx_->tab_state, 202), TAB_HANDLE_INVALID);
 }
 
 TEST_F(EngineTest, TabCreated) {
@@ -262,10 +550,9 @@ TEST_F(EngineTest, TabCreated) {
 
   ASSERT_NE(ectx_->tab_state, nullptr);
   EXPECT_EQ(ectx_->tab_state->nb_tabs, 1);
-  TabInfo* tab = ectx_->tab_state->tabs;
-  ASSERT_NE(tab, nullptr);
-  EXPECT_EQ(tab->id, 301ul);
-  EXPECT_STREQ(tab->title, "New Created Tab");
+  TabHandle h = tab_state_find_tab(ectx_->tab_state, 301);
+  ASSERT_NE(h, TAB_HANDLE_INVALID);
+  EXPECT_STREQ(ectx_->tab_state->titles[tab_handle_slot(h)], "New Created Tab");
 }
 
 TEST_F(EngineTest, TabUpdated) {
@@ -288,8 +575,9 @@ TEST_F(EngineTest, TabUpdated) {
 
   ASSERT_NE(ectx_->tab_state, nullptr);
   EXPECT_EQ(ectx_->tab_state->nb_tabs, 1);
-  TabInfo* tab = ectx_->tab_state->tabs;
-  EXPECT_STREQ(tab->title, "Old Title");
+  TabHandle h = tab_state_find_tab(ectx_->tab_state, 401);
+  ASSERT_NE(h, TAB_HANDLE_INVALID);
+  EXPECT_STREQ(ectx_->tab_state->titles[tab_handle_slot(h)], "Old Title");
 
   // 2. Send Update Event
   const char* update_event =
@@ -306,8 +594,8 @@ TEST_F(EngineTest, TabUpdated) {
 
   // 3. Verify Update
   EXPECT_EQ(ectx_->tab_state->nb_tabs, 1);
-  tab = ectx_->tab_state->tabs;
-  EXPECT_STREQ(tab->title, "New Title");
+  EXPECT_EQ(tab_state_resolve(ectx_->tab_state, h), h);
+  EXPECT_STREQ(ectx_->tab_state->titles[tab_handle_slot(h)], "New Title");
 }
 
 TEST_F(EngineTest, TabGroupSync) {
@@ -341,9 +629,470 @@ TEST_F(EngineTest, TabGroupSync) {
 
   // 2. Verify Tab is associated with the correct task_id
   ASSERT_NE(ectx_->tab_state, nullptr);
-  TabInfo* tab = tab_state_find_tab(ectx_->tab_state, 501);
-  ASSERT_NE(tab, nullptr);
-  EXPECT_EQ(tab->task_ext_id, (int64_t)task->external_id);
+  TabHandle h = tab_state_find_tab(ectx_->tab_state, 501);
+  ASSERT_NE(h, TAB_HANDLE_INVALID);
+  EXPECT_EQ(ectx_->tab_state->task_ids[tab_handle_slot(h)], (int64_t)task->external_id);
+}
+
+TEST_F(EngineTest, GroupCreateResponseBindsByRequestId) {
+  ASSERT_TRUE(ectx_ != nullptr);
+  TaskState* tks = ectx_->task_state;
+  TabState* ts = ectx_->tab_state;
+
+  TestWebSocketClient client;
+  client.Connect(GetPort());
+  ASSERT_TRUE(client.IsConnected());
+  ASSERT_TRUE(client.WaitForEvent("Daemon::WS::AllTabsInfoRequest", 2000));
+
+  // Two tasks of the same name, each waiting on its own CreateTabGroupRequest.
+  TaskInfo* first = task_state_add(tks, "Work", "grey", -1);
+  TaskInfo* second = task_state_add(tks, "Work", "grey", -1);
+  ASSERT_NE(first, nullptr);
+  ASSERT_NE(second, nullptr);
+  const int64_t first_id = first->external_id;
+  const int64_t second_id = second->external_id;
+  task_state_await_group(tks, first);
+  task_state_await_group(tks, second);
+  tab_state_add_tab(ts, "A", 601, first_id, nullptr);
+  tab_state_add_tab(ts, "B", 602, second_id, nullptr);
+
+  // The first group's own event arrives before its response and must not claim either task by title.
+  client.Send(R"pb({
+                "event": "Extension::WS::TabGroupUpdated",
+                "data": { "id": 20, "title": "Work", "color": "grey" }
+              })pb");
+  sleep(1);
+  TaskInfo* created = task_state_find_by_external_id(tks, 20);
+  ASSERT_NE(created, nullptr);
+  EXPECT_NE(created, first);
+  EXPECT_NE(created, second);
+  EXPECT_EQ(tks->nb_tasks, 3);
+
+  auto response = [](int64_t request_id, int64_t group_id, const char* color) {
+    return std::string(R"({"event": "Extension::WS::TabGroupCreateResponse", "data": {"requestId": )") +
+           std::to_string(request_id) + R"(, "group": {"id": )" + std::to_string(group_id) +
+           R"(, "title": "Work", "color": ")" + color + R"("}}})";
+  };
+  client.Send(response(first_id, 20, "blue"));
+  client.Send(response(second_id, 21, "red"));
+  sleep(1);
+
+  EXPECT_EQ(tks->nb_tasks, 2);
+  EXPECT_EQ(task_state_find_by_external_id(tks, 21), second);
+  TaskInfo* bound = task_state_find_by_external_id(tks, 20);
+  ASSERT_NE(bound, nullptr);
+  EXPECT_STREQ(bound->color, "blue");
+  EXPECT_EQ(ts->task_ids[tab_handle_slot(tab_state_find_tab(ts, 601))], 20);
+  EXPECT_EQ(ts->task_ids[tab_handle_slot(tab_state_find_tab(ts, 602))], 21);
+  EXPECT_EQ(tab_state_task_count(ts, first_id), 0u);
+  EXPECT_EQ(tab_state_task_count(ts, second_id), 0u);
+}
+
+TEST_F(EngineTest, AllTabsSnapshotDecodesFromText) {
+  ASSERT_NE(ectx_->tab_state, nullptr);
+  TabState* ts = ectx_->tab_state;
+
+  // Groups after tabs, the envelope's browserId after data, escapes and members the engine ignores:
+  // none of it depends on the order cJSON would have built the tree in.
+  const char* snapshot = R"({
+    "event": "Extension::WS::AllTabsInfoResponse",
+    "timestamp": "2026-01-01T00:00:00Z",
+    "data": {
+      "tabs": [
+        {"id": 7, "title": "Café \"menu\" 😀", "groupId": 3, "windowId": 1, "index": 1,
+         "favIconUrl": null, "extra": {"nested": [1, {"deep": true}]}},
+        {"id": 8, "title": "Plain", "groupId": -1, "windowId": 1, "index": 0},
+        {"id": 9, "title": "Elsewhere", "browserId": "browser-b", "windowId": 2, "index": 0}
+      ],
+      "groups": [{"id": 3, "title": "Reading", "color": "blue", "collapsed": false}]
+    },
+    "activeTabIds": [8],
+    "browserId": "browser-a"
+  })";
+  engine_handle_event(ectx_, EVENT_WS_MESSAGE_RECEIVED, (void*)snapshot, nullptr);
+
+  EXPECT_EQ(ts->nb_tabs, 3);
+  TabHandle cafe = tab_state_find_browser_tab(ts, "browser-a", 7);
+  TabHandle plain = tab_state_find_browser_tab(ts, "browser-a", 8);
+  TabHandle elsewhere = tab_state_find_browser_tab(ts, "browser-b", 9);
+  ASSERT_NE(cafe, TAB_HANDLE_INVALID);
+  ASSERT_NE(plain, TAB_HANDLE_INVALID);
+  ASSERT_NE(elsewhere, TAB_HANDLE_INVALID);
+  EXPECT_STREQ(ts->titles[tab_handle_slot(cafe)], "Caf\xc3\xa9 \"menu\" \xf0\x9f\x98\x80");
+  EXPECT_EQ(ts->task_ids[tab_handle_slot(cafe)], 3);
+  EXPECT_EQ(ts->task_ids[tab_handle_slot(plain)], -1);
+  EXPECT_EQ(tab_state_tab_index(ts, plain), 0u);
+  EXPECT_EQ(tab_state_tab_index(ts, cafe), 1u);
+  EXPECT_TRUE(ts->flags[tab_handle_slot(plain)] & TAB_FLAG_ACTIVE);
+  EXPECT_FALSE(ts->flags[tab_handle_slot(cafe)] & TAB_FLAG_ACTIVE);
+  TaskInfo* task = task_state_find_by_external_id(ectx_->task_state, 3);
+  ASSERT_NE(task, nullptr);
+  EXPECT_STREQ(task->task_name, "Reading");
+
+  // A truncated snapshot is dropped as a whole rather than half-applied.
+  const char* truncated = R"({"event": "Extension::WS::AllTabsInfoResponse", "data": {"tabs": [{"id": 10}, )";
+  uint64_t version = ts->version;
+  engine_handle_event(ectx_, EVENT_WS_MESSAGE_RECEIVED, (void*)truncated, nullptr);
+  EXPECT_EQ(ts->version, version);
+  EXPECT_EQ(ts->nb_tabs, 3);
+}
+
+namespace {
+
+std::atomic<size_t> g_cjson_allocs{0};
+
+// Counts cJSON's allocations on top of the engine's own hooks (see engine_init()).
+void* CountingMalloc(size_t size) {
+  g_cjson_allocs++;
+  return arena_malloc(size);
+}
+
+}  // namespace
+
+TEST_F(EngineTest, DroppedMessagesAreNotParsed) {
+  ASSERT_NE(ectx_->tab_state, nullptr);
+  TabState* ts = ectx_->tab_state;
+  char allowed_id[] = "browser-a";
+  ectx_->allowed_browser_id = allowed_id;
+  PerSessionData allowed{};
+  allowed.browser_id = allowed_id;
+  PerSessionData stranger{};
+  stranger.browser_id = const_cast<char*>("browser-b");
+
+  cJSON_Hooks hooks = {CountingMalloc, arena_free};
+  cJSON_InitHooks(&hooks);
+  // Everything after "event" is cut off: the engine must decide from the name and session alone.
+  auto send = [&](const char* event, PerSessionData* pss) {
+    std::string msg = std::string(R"({"event": ")") + event + R"(", "data": {"id": 5, "tit)";
+    engine_handle_event(ectx_, EVENT_WS_MESSAGE_RECEIVED, (void*)msg.c_str(), pss);
+  };
+  send("Extension::WS::TabCreated", &stranger);
+  send("Extension::WS::TabCreated", nullptr);
+  send("Extension::WS::TabHighlighted", &allowed);
+  send("Extension::WS::TabZoomChanged", &allowed);
+  send("Extension::WS::NoSuchEvent", &allowed);
+  EXPECT_EQ(g_cjson_allocs.load(), 0u);
+
+  // Wanted messages are still decoded.
+  const char* created = R"({"event": "Extension::WS::TabCreated", "data": {"id": 5, "title": "Kept"}})";
+  engine_handle_event(ectx_, EVENT_WS_MESSAGE_RECEIVED, (void*)created, &allowed);
+  // Back to what engine_init() installed, for the rest of the test and the engine's teardown.
+  cJSON_Hooks engine_hooks = {arena_malloc, arena_free};
+  cJSON_InitHooks(&engine_hooks);
+  EXPECT_GT(g_cjson_allocs.load(), 0u);
+  EXPECT_EQ(ts->nb_tabs, 1);
+  EXPECT_NE(tab_state_find_browser_tab(ts, "browser-a", 5), TAB_HANDLE_INVALID);
+  ectx_->allowed_browser_id = nullptr;
+}
+
+TEST_F(EngineTest, TabIndexSurvivesChurn) {
+  ASSERT_NE(ectx_->tab_state, nullptr);
+  TabState* ts = ectx_->tab_state;
+
+  const uint64_t kTabs = 5000;
+  for (uint64_t id = 1; id <= kTabs; ++id) {
+    tab_state_add_tab(ts, "Tab", id * 7, -1, nullptr);
+  }
+  EXPECT_EQ(ts->nb_tabs, (int)kTabs);
+
+  // Removing every third tab exercises backward-shift deletion across probe chains.
+  for (uint64_t id = 3; id <= kTabs; id += 3) {
+    tab_state_remove_tab(ts, id * 7, NULL);
+  }
+  for (uint64_t id = 1; id <= kTabs; ++id) {
+    TabHandle h = tab_state_find_tab(ts, id * 7);
+    if (id % 3 == 0) {
+      EXPECT_EQ(h, TAB_HANDLE_INVALID) << "id=" << id * 7;
+    } else {
+      ASSERT_NE(h, TAB_HANDLE_INVALID) << "id=" << id * 7;
+      EXPECT_EQ(ts->ids[tab_handle_slot(h)], id * 7);
+    }
+  }
+  EXPECT_EQ(tab_state_find_tab(ts, 1), TAB_HANDLE_INVALID);
+  EXPECT_EQ(ts->nb_tabs, (int)(kTabs - kTabs / 3));
+  EXPECT_EQ(ts->nb_slots, (uint32_t)kTabs);
+}
+
+TEST_F(EngineTest, TabHandlesGoStaleOnSlotReuse) {
+  ASSERT_NE(ectx_->tab_state, nullptr);
+  TabState* ts = ectx_->tab_state;
+
+  TabHandle first = tab_state_add_tab(ts, "First", 11, -1, nullptr);
+  ASSERT_NE(first, TAB_HANDLE_INVALID);
+  tab_state_remove_tab(ts, 11, NULL);
+  EXPECT_EQ(tab_state_resolve(ts, first), TAB_HANDLE_INVALID);
+
+  // The freed slot is recycled, but the old handle must not alias the new tab.
+  TabHandle second = tab_state_add_tab(ts, "Second", 12, -1, nullptr);
+  ASSERT_NE(second, TAB_HANDLE_INVALID);
+  EXPECT_EQ(tab_handle_slot(second), tab_handle_slot(first));
+  EXPECT_NE(second, first);
+  EXPECT_EQ(tab_state_resolve(ts, first), TAB_HANDLE_INVALID);
+  EXPECT_EQ(tab_state_resolve(ts, second), second);
+  EXPECT_EQ(ts->nb_slots, 1u);
+}
+
+TEST_F(EngineTest, TaskIndexTracksMembership) {
+  ASSERT_NE(ectx_->tab_state, nullptr);
+  TabState* ts = ectx_->tab_state;
+
+  for (uint64_t id = 1; id <= 30; ++id) {
+    tab_state_add_tab(ts, "Tab", id, (int64_t)(id % 3), nullptr);
+  }
+  EXPECT_EQ(tab_state_task_count(ts, 0), 10u);
+  EXPECT_EQ(tab_state_task_count(ts, 1), 10u);
+
+  tab_state_remove_tab(ts, 3, NULL);
+  tab_state_set_task(ts, tab_state_find_tab(ts, 6), 1);
+  tab_state_update_tab(ts, "Tab", 9, 7, nullptr);
+  EXPECT_EQ(tab_state_task_count(ts, 0), 7u);
+  EXPECT_EQ(tab_state_task_count(ts, 1), 11u);
+  EXPECT_EQ(tab_state_task_count(ts, 7), 1u);
+
+  // Claiming merges one member list into another without touching unrelated tabs.
+  tab_state_retarget_task(ts, 1, 2);
+  EXPECT_EQ(tab_state_task_count(ts, 1), 0u);
+  EXPECT_EQ(tab_state_task_count(ts, 2), 21u);
+  tab_state_retarget_task(ts, 7, 42);
+  EXPECT_EQ(tab_state_task_count(ts, 42), 1u);
+
+  // The index must agree with the task_ids column.
+  uint32_t per_task[3] = {0, 0, 0};
+  for (uint32_t slot = 0; slot < ts->nb_slots; ++slot) {
+    if (!tab_slot_live(ts, slot) || ts->task_ids[slot] == 42)
+      continue;
+    ASSERT_GE(ts->task_ids[slot], 0);
+    ASSERT_LT(ts->task_ids[slot], 3);
+    per_task[ts->task_ids[slot]]++;
+  }
+  EXPECT_EQ(per_task[0], tab_state_task_count(ts, 0));
+  EXPECT_EQ(per_task[1], tab_state_task_count(ts, 1));
+  EXPECT_EQ(per_task[2], tab_state_task_count(ts, 2));
+  EXPECT_EQ(ts->task_ids[tab_handle_slot(tab_state_find_tab(ts, 9))], 42);
+}
+
+TEST_F(EngineTest, TaskStateIndexesIdsAndPendingNames) {
+  ASSERT_NE(ectx_->task_state, nullptr);
+  TaskState* ts = ectx_->task_state;
+
+  // Local ids come from a counter and never collide with -1, the "no task" id of a tab.
+  TaskInfo* first = task_state_add(ts, "Work", "grey", -1);
+  TaskInfo* second = task_state_add(ts, "Work", "grey", -1);
+  TaskInfo* other = task_state_add(ts, "Play", "grey", -1);
+  ASSERT_NE(first, nullptr);
+  ASSERT_NE(second, nullptr);
+  ASSERT_NE(other, nullptr);
+  EXPECT_EQ(first->external_id, -2);
+  EXPECT_EQ(second->external_id, -3);
+  EXPECT_EQ(other->external_id, -4);
+
+  for (int64_t id = 100; id < 2100; ++id) {
+    task_state_add(ts, "Group", "blue", id);
+  }
+  EXPECT_EQ(ts->nb_tasks, 2003);
+  for (int64_t id = 100; id < 2100; id += 2) {
+    task_state_remove(ts, id);
+  }
+  for (int64_t id = 100; id < 2100; ++id) {
+    TaskInfo* t = task_state_find_by_external_id(ts, id);
+    if (id % 2 == 0) {
+      EXPECT_EQ(t, nullptr) << "id=" << id;
+    } else {
+      ASSERT_NE(t, nullptr) << "id=" << id;
+      EXPECT_EQ(t->external_id, id);
+    }
+  }
+  EXPECT_EQ(task_state_find_by_external_id(ts, -2), nullptr);
+
+  // Groups claim the newest unconfirmed task of their name, then the older one, then none.
+  EXPECT_EQ(task_state_incorporate_external_group(ts, 10, "Work", "red"), -3);
+  EXPECT_EQ(task_state_find_by_external_id(ts, 10), second);
+  task_state_remove(ts, -2);
+  EXPECT_EQ(task_state_incorporate_external_group(ts, 11, "Work", "red"), 0);
+  EXPECT_EQ(task_state_incorporate_external_group(ts, 12, "Play", "red"), -4);
+  EXPECT_EQ(task_state_find_by_external_id(ts, 12), other);
+  EXPECT_EQ(ts->nb_tasks, 1003);
+
+  int listed = 0;
+  for (TaskInfo* t = ts->tasks; t; t = t->next) {
+    EXPECT_EQ(task_state_find_by_external_id(ts, t->external_id), t);
+    listed++;
+  }
+  EXPECT_EQ(listed, ts->nb_tasks);
+}
+
+TEST_F(EngineTest, ActiveSetHasNoWindowCap) {
+  ASSERT_NE(ectx_->tab_state, nullptr);
+  TabState* ts = ectx_->tab_state;
+
+  // 200 windows with 2 tabs each; the first tab of every window is active.
+  std::string ids = "[";
+  for (uint64_t w = 0; w < 200; ++w) {
+    tab_state_add_tab(ts, "Tab", 1000 + 2 * w, -1, nullptr);
+    tab_state_add_tab(ts, "Tab", 1001 + 2 * w, -1, nullptr);
+    ids += (w ? "," : "") + std::to_string(1000 + 2 * w);
+  }
+  ids += "]";
+  auto apply = [&](const std::string& active_ids) {
+    cJSON* json = cJSON_Parse(("{\"activeTabIds\": " + active_ids + "}").c_str());
+    ASSERT_NE(json, nullptr);
+    tab_state_update_active(ts, json, nullptr);
+    cJSON_Delete(json);
+  };
+  auto count_active = [&]() {
+    uint32_t n = 0;
+    for (uint32_t slot = 0; slot < ts->nb_slots; ++slot) {
+      if (tab_slot_live(ts, slot) && (ts->flags[slot] & TAB_FLAG_ACTIVE))
+        n++;
+      EXPECT_EQ(ts->flags[slot] & TAB_FLAG_ACTIVE_MARK, 0u);
+    }
+    return n;
+  };
+
+  apply(ids);
+  EXPECT_EQ(count_active(), 200u);
+  EXPECT_EQ(ts->nb_active, 200u);
+
+  // Switching tabs in one window flips exactly two flags.
+  std::string switched = ids;
+  switched.replace(switched.find("1398"), 4, "1399");
+  apply(switched);
+  EXPECT_EQ(count_active(), 200u);
+  EXPECT_FALSE(ts->flags[tab_handle_slot(tab_state_find_tab(ts, 1398))] & TAB_FLAG_ACTIVE);
+  EXPECT_TRUE(ts->flags[tab_handle_slot(tab_state_find_tab(ts, 1399))] & TAB_FLAG_ACTIVE);
+
+  // Removed tabs drop out of the set; duplicates and unknown ids are ignored.
+  tab_state_remove_tab(ts, 1000, NULL);
+  apply("[1002, 1002, 999999]");
+  EXPECT_EQ(count_active(), 1u);
+  EXPECT_EQ(ts->nb_active, 1u);
+}
+
+TEST_F(EngineTest, ActiveTabIdsApplyToSendingSession) {
+  ASSERT_NE(ectx_->tab_state, nullptr);
+  TabState* ts = ectx_->tab_state;
+  TabHandle a = tab_state_add_tab(ts, "A", 100, -1, "browser-a");
+  TabHandle b = tab_state_add_tab(ts, "B", 100, -1, "browser-b");
+  PerSessionData session_a{};
+  session_a.browser_id = const_cast<char*>("browser-a");
+  PerSessionData session_b{};
+  session_b.browser_id = const_cast<char*>("browser-b");
+  auto is_active = [&](TabHandle h) { return (ts->flags[tab_handle_slot(h)] & TAB_FLAG_ACTIVE) != 0; };
+
+  // Until the extension has stored its id, the envelope's browserId is null: the session tells whose
+  // tab 100 is meant, and the other browser's active tab stays.
+  const char* activated =
+      R"({"event": "Extension::WS::TabActivated", "data": {"tabId": 100}, "browserId": null, "activeTabIds": [100]})";
+  engine_handle_event(ectx_, EVENT_WS_MESSAGE_RECEIVED, (void*)activated, &session_b);
+  EXPECT_TRUE(is_active(b));
+  EXPECT_FALSE(is_active(a));
+  engine_handle_event(ectx_, EVENT_WS_MESSAGE_RECEIVED, (void*)activated, &session_a);
+  EXPECT_TRUE(is_active(a));
+  EXPECT_TRUE(is_active(b));
+
+  // The same through the streaming snapshot decoder.
+  const char* snapshot = R"({"event": "Extension::WS::AllTabsInfoResponse", "data": {"tabs": [{"id": 100, )"
+                         R"("title": "B"}]}, "browserId": null, "activeTabIds": []})";
+  engine_handle_event(ectx_, EVENT_WS_MESSAGE_RECEIVED, (void*)snapshot, &session_b);
+  EXPECT_FALSE(is_active(b));
+  EXPECT_TRUE(is_active(a));
+}
+
+TEST_F(EngineTest, TabsAreKeyedByBrowser) {
+  ASSERT_NE(ectx_->tab_state, nullptr);
+  TabState* ts = ectx_->tab_state;
+
+  std::string browser = "browser-uuid-1";
+  TabHandle a = tab_state_add_tab(ts, "A", 21, -1, browser.c_str());
+  TabHandle b = tab_state_add_tab(ts, "B", 22, -1, std::string(browser).c_str());
+  ASSERT_NE(a, TAB_HANDLE_INVALID);
+  ASSERT_NE(b, TAB_HANDLE_INVALID);
+
+  // Both tabs share one registered browser, whose name is pooled once.
+  BrowserHandle first = ts->browsers[tab_handle_slot(a)];
+  EXPECT_NE(first, TAB_BROWSER_NONE);
+  EXPECT_EQ(ts->browsers[tab_handle_slot(b)], first);
+  EXPECT_STREQ(tab_state_browser_id(ts, first), "browser-uuid-1");
+  EXPECT_EQ(ts->strings.count, 1u);
+
+  // The same tab id in another browser is another tab.
+  TabHandle other = tab_state_add_tab(ts, "Other", 21, -1, "browser-uuid-2");
+  ASSERT_NE(other, TAB_HANDLE_INVALID);
+  EXPECT_NE(other, a);
+  EXPECT_EQ(ts->nb_tabs, 3);
+  EXPECT_EQ(tab_state_find_browser_tab(ts, "browser-uuid-1", 21), a);
+  EXPECT_EQ(tab_state_find_browser_tab(ts, "browser-uuid-2", 21), other);
+  EXPECT_EQ(tab_state_find_browser_tab(ts, "browser-uuid-2", 22), TAB_HANDLE_INVALID);
+
+  tab_state_update_tab(ts, "Other2", 21, -1, "browser-uuid-2");
+  EXPECT_STREQ(ts->titles[tab_handle_slot(a)], "A");
+  EXPECT_STREQ(ts->titles[tab_handle_slot(other)], "Other2");
+
+  tab_state_remove_tab(ts, 21, "browser-uuid-1");
+  EXPECT_EQ(tab_state_resolve(ts, a), TAB_HANDLE_INVALID);
+  EXPECT_EQ(tab_state_resolve(ts, other), other);
+
+  // A tab stored before its browser was known is adopted by the first browser to name it.
+  TabHandle orphan = tab_state_add_tab(ts, "Orphan", 30, -1, NULL);
+  EXPECT_EQ(ts->browsers[tab_handle_slot(orphan)], TAB_BROWSER_NONE);
+  tab_state_update_tab(ts, "Orphan", 30, -1, "browser-uuid-2");
+  EXPECT_EQ(ts->browsers[tab_handle_slot(orphan)], ts->browsers[tab_handle_slot(other)]);
+  EXPECT_EQ(tab_state_find_browser_tab(ts, "browser-uuid-2", 30), orphan);
+  EXPECT_EQ(ts->nb_tabs, 3);
+}
+
+TEST_F(EngineTest, TabPositionsFollowMoves) {
+  ASSERT_NE(ectx_->tab_state, nullptr);
+  TabState* ts = ectx_->tab_state;
+
+  auto order = [&]() {
+    std::vector<uint64_t> ids;
+    TabOrderCursor cur;
+    for (uint32_t slot = tab_state_order_begin(ts, &cur); slot != TAB_SLOT_NONE; slot = tab_state_order_next(ts, &cur))
+      ids.push_back(ts->ids[slot]);
+    return ids;
+  };
+
+  // Window 1 holds tabs 1..6 in order; inserting at an index shifts the tabs after it.
+  std::vector<TabHandle> tabs;
+  for (uint64_t id = 1; id <= 6; ++id) {
+    tabs.push_back(tab_state_add_tab(ts, "Tab", id, -1, "browser"));
+    tab_state_place_tab(ts, tabs.back(), 1, (uint32_t)id == 6 ? 0 : (uint32_t)id - 1);
+  }
+  EXPECT_EQ(order(), (std::vector<uint64_t>{6, 1, 2, 3, 4, 5}));
+  EXPECT_EQ(tab_state_tab_index(ts, tabs[2]), 3u);
+
+  // Drag tab 6 to the end, then tab 3 to the front.
+  tab_state_place_tab(ts, tabs[5], 1, 5);
+  tab_state_place_tab(ts, tabs[2], 1, 0);
+  EXPECT_EQ(order(), (std::vector<uint64_t>{3, 1, 2, 4, 5, 6}));
+
+  // Placing tabs where they already are, as every snapshot does, changes nothing.
+  uint64_t version = ts->version;
+  for (size_t i = 0; i < tabs.size(); ++i)
+    tab_state_place_tab(ts, tabs[i], 1, tab_state_tab_index(ts, tabs[i]));
+  EXPECT_EQ(ts->version, version);
+  EXPECT_EQ(order(), (std::vector<uint64_t>{3, 1, 2, 4, 5, 6}));
+
+  // Detach tab 4 into window 2; unplaced tabs come last.
+  tab_state_place_tab(ts, tabs[3], TAB_WINDOW_NONE, 0);
+  EXPECT_EQ(tab_state_tab_index(ts, tabs[3]), UINT32_MAX);
+  EXPECT_EQ(order(), (std::vector<uint64_t>{3, 1, 2, 5, 6, 4}));
+  tab_state_place_tab(ts, tabs[3], 2, 0);
+  EXPECT_EQ(order(), (std::vector<uint64_t>{3, 1, 2, 5, 6, 4}));
+  EXPECT_EQ(tab_state_tab_index(ts, tabs[3]), 0u);
+  EXPECT_EQ(ts->nb_windows, 2u);
+
+  // Removing a tab closes its gap; an emptied window is forgotten.
+  tab_state_remove_tab(ts, 1, "browser");
+  EXPECT_EQ(tab_state_tab_index(ts, tabs[1]), 1u);
+  tab_state_remove_tab(ts, 4, "browser");
+  EXPECT_EQ(ts->nb_windows, 1u);
+
+  // A replaced tab keeps its place under the new id.
+  tab_state_replace_tab_id(ts, "browser", 5, 50);
+  EXPECT_EQ(order(), (std::vector<uint64_t>{3, 2, 50, 6}));
+  EXPECT_EQ(tab_state_find_tab(ts, 5), TAB_HANDLE_INVALID);
 }
 
 TEST_F(EngineTest, ConfigCreated) {
@@ -367,8 +1116,14 @@ TEST_F(EngineTest, ConfigCreated) {
   std::string config_path = std::string(tmp_dir) + "/config.toml";
   struct stat st;
   EXPECT_EQ(stat(config_path.c_str(), &st), 0) << "Config file was not created at " << config_path;
+  EXPECT_EQ(ec->notify_coalesce_ms, 8u);
 
   engine_destroy(ec);
+  // The trace is dumped next to the config on shutdown; the fixture's engine, set up without paths,
+  // leaves the home directory alone.
+  std::string trace_path = std::string(tmp_dir) + "/daemon.trace";
+  EXPECT_EQ(stat(trace_path.c_str(), &st), 0) << "Trace was not dumped at " << trace_path;
+  EXPECT_FALSE(ectx_->trace_on_exit);
 
   // Cleanup
   std::string cmd = std::string("rm -rf ") + tmp_dir;
@@ -470,13 +1225,102 @@ TEST_F(EngineTest, BrowserRegistration) {
 
   ASSERT_NE(ectx_->tab_state, nullptr);
   EXPECT_EQ(ectx_->tab_state->nb_tabs, 1);
-  TabInfo* tab = ectx_->tab_state->tabs;
-  ASSERT_NE(tab, nullptr);
-  EXPECT_EQ(tab->id, 901ul);
-  EXPECT_STREQ(tab->browser_id, "test-uuid-1234");
+  TabHandle h = tab_state_find_tab(ectx_->tab_state, 901);
+  ASSERT_NE(h, TAB_HANDLE_INVALID);
+  const TabState* ts = ectx_->tab_state;
+  EXPECT_STREQ(tab_state_browser_id(ts, ts->browsers[tab_handle_slot(h)]), "test-uuid-1234");
+}
+
+TEST(LogTest, DisabledMessagesSkipTheirArguments) {
+  int prev = engine_get_log_level();
+  int evaluated = 0;
+  auto arg = [&] { return ++evaluated; };
+
+  engine_set_log_level(LOG_LEVEL_INFO);
+  vlog(LOG_LEVEL_TRACE, NULL, "trace %d\n", arg());
+  EXPECT_EQ(evaluated, 0);
+  EXPECT_FALSE(vlog_enabled(LOG_LEVEL_TRACE));
+
+  vlog(LOG_LEVEL_INFO, NULL, "info %d\n", arg());
+  EXPECT_EQ(evaluated, 1);
+
+  engine_set_log_level(prev);
+}
+
+TEST(LogTest, ConcurrentWritersAccountForEveryMessage) {
+  int prev = engine_get_log_level();
+  engine_set_log_level(LOG_LEVEL_TRACE);
+  vlog_flush();
+  int saved_stdout = dup(STDOUT_FILENO);
+  int null_fd = open("/dev/null", O_WRONLY);
+  ASSERT_GE(null_fd, 0);
+  dup2(null_fd, STDOUT_FILENO);
+
+  const int kThreads = 4;
+  const int kMessages = 20000;
+  LogStats before = vlog_stats();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([t] {
+      for (int i = 0; i < kMessages; ++i)
+        vlog(LOG_LEVEL_TRACE, NULL, "writer %d message %d\n", t, i);
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  vlog_flush();
+  LogStats after = vlog_stats();
+
+  dup2(saved_stdout, STDOUT_FILENO);
+  close(saved_stdout);
+  close(null_fd);
+  engine_set_log_level(prev);
+  // Every message is either written or counted as dropped (anything else logging meanwhile only adds).
+  EXPECT_GE((after.nb_written - before.nb_written) + (after.nb_dropped - before.nb_dropped),
+            (uint64_t)kThreads * kMessages);
+}
+
+TEST(WriteTest, WritevAllFinishesInterruptedWrites) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  int sndbuf = 4096;
+  setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+  // No SA_RESTART: a signal makes a blocked writev() return early, short or with EINTR.
+  struct sigaction sa = {}, old_sa;
+  sa.sa_handler = [](int) {};
+  sigemptyset(&sa.sa_mask);
+  ASSERT_EQ(sigaction(SIGUSR1, &sa, &old_sa), 0);
+
+  std::string head = "head";
+  std::string body(1 << 20, '\0');
+  for (size_t i = 0; i < body.size(); ++i)
+    body[i] = (char)('a' + i % 26);
+  const size_t total = head.size() + body.size();
+  pthread_t writer = pthread_self();
+  std::string received;
+  std::thread reader([&] {
+    char buf[1024];
+    while (received.size() < total) {
+      ssize_t n = read(fds[1], buf, sizeof(buf));
+      if (n <= 0)
+        break;
+      received.append(buf, (size_t)n);
+      pthread_kill(writer, SIGUSR1);
+    }
+  });
+
+  struct iovec iov[2] = {{.iov_base = head.data(), .iov_len = head.size()},
+                         {.iov_base = body.data(), .iov_len = body.size()}};
+  EXPECT_EQ(writev_all(fds[0], iov, 2), 0);
+  reader.join();
+  sigaction(SIGUSR1, &old_sa, NULL);
+  close(fds[0]);
+  close(fds[1]);
+  EXPECT_TRUE(received == head + body);
 }
 
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
 }
+
@@ -65,6 +65,7 @@ MATCHER_P(MatchesTabs, expected_tabs, "") {
 struct CallbackData {
   // Tabs Update
   int tabs_count = -1;
+  int tabs_updates = 0;
   char* last_tab_title = nullptr;
   char* active_tab_title = nullptr;
   std::vector<TabData> tabs;
@@ -88,6 +89,7 @@ class TestableClientDriver {
       auto* driver = static_cast<TestableClientDriver*>(user_data);
       std::lock_guard<std::mutex> lock(driver->mutex_);
       driver->data_.tabs_count = (int)tabs->count;
+      driver->data_.tabs_updates++;
       if (driver->data_.last_tab_title)
         free(driver->data_.last_tab_title);
       if (driver->data_.active_tab_title)
@@ -158,6 +160,11 @@ class TestableClientDriver {
     }
   }
 
+  int TabsUpdates() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return data_.tabs_updates;
+  }
+
   bool WaitForTabsUpdate(int expected_count, std::string expected_title, int timeout_ms = 1000) {
     std::unique_lock<std::mutex> lock(mutex_);
     return cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&]() {
@@ -296,6 +303,36 @@ TEST_F(IntegrationTest, ExtensionsTabUpdatePropagatesToClient) {
   ASSERT_TRUE(client_driver_->WaitForTabsUpdate(1, "Test Tab"));
 }
 
+TEST_F(IntegrationTest, UnchangedTabStateIsNotPushed) {
+  const char* ws_msg = R"json({
+        "event": "Extension::WS::TabUpdated",
+        "data": {
+            "tab": {
+                "id": 123,
+                "title": "Loading Tab"
+            }
+        }
+    })json";
+
+  engine_handle_event(ec_, EVENT_WS_MESSAGE_RECEIVED, (void*)ws_msg, nullptr);
+  ASSERT_TRUE(client_driver_->WaitForTabsUpdate(1, "Loading Tab"));
+  int pushes = client_driver_->TabsUpdates();
+
+  // A page load repeats TabUpdated with nothing new; none of these should reach the GUI.
+  for (int i = 0; i < 3; ++i) {
+    engine_handle_event(ec_, EVENT_WS_MESSAGE_RECEIVED, (void*)ws_msg, nullptr);
+  }
+
+  // The UDS stream is ordered, so once this tab shows up the repeats would have arrived too.
+  const char* create_msg = R"json({
+        "event": "Extension::WS::TabCreated",
+        "data": { "id": 124, "title": "Second Tab" }
+    })json";
+  engine_handle_event(ec_, EVENT_WS_MESSAGE_RECEIVED, (void*)create_msg, nullptr);
+  ASSERT_TRUE(client_driver_->WaitForTabsUpdate(2, "Second Tab"));
+  EXPECT_EQ(client_driver_->TabsUpdates(), pushes + 1);
+}
+
 TEST_F(IntegrationTest, HotkeyTogglePropagatesToClient) {
   ASSERT_FALSE(client_driver_->IsUIToggled());
   engine_handle_event(ec_, EVENT_HOTKEY_TOGGLE, nullptr, nullptr);
@@ -339,6 +376,90 @@ TEST_F(IntegrationTest, ExtensionsAllTabsPropagatesToClient) {
   ASSERT_TRUE(client_driver_->WaitForTabs({MakeTab(1, "Tab One", -1), MakeTab(2, "Tab Two", -1)}));
 }
 
+TEST_F(IntegrationTest, AllTabsSweepsClosedTabsOfSendingBrowser) {
+  const char* first_snapshot = R"json({
+        "event": "Extension::WS::AllTabsInfoResponse",
+        "data": {
+            "tabs": [
+                { "id": 1, "title": "One", "groupId": -1 },
+                { "id": 2, "title": "Two", "groupId": -1 },
+                { "id": 3, "title": "Three", "groupId": -1 }
+            ],
+            "groups": []
+        },
+        "browserId": "browser-a"
+    })json";
+  engine_handle_event(ec_, EVENT_WS_MESSAGE_RECEIVED, (void*)first_snapshot, nullptr);
+  ASSERT_TRUE(client_driver_->WaitForTabs({MakeTab(1, "One"), MakeTab(2, "Two"), MakeTab(3, "Three")}));
+
+  const char* other_browser = R"json({
+        "event": "Extension::WS::TabCreated",
+        "data": { "id": 50, "title": "Elsewhere", "browserId": "browser-b" }
+    })json";
+  engine_handle_event(ec_, EVENT_WS_MESSAGE_RECEIVED, (void*)other_browser, nullptr);
+  ASSERT_TRUE(client_driver_->WaitForTabsUpdate(4, "Elsewhere"));
+
+  // Tab 2 was closed while the daemon was not listening; the next snapshot must drop it, and only it.
+  const char* second_snapshot = R"json({
+        "event": "Extension::WS::AllTabsInfoResponse",
+        "data": {
+            "tabs": [
+                { "id": 1, "title": "One", "groupId": -1 },
+                { "id": 3, "title": "Three (renamed)", "groupId": -1 }
+            ],
+            "groups": []
+        },
+        "browserId": "browser-a"
+    })json";
+  engine_handle_event(ec_, EVENT_WS_MESSAGE_RECEIVED, (void*)second_snapshot, nullptr);
+  ASSERT_TRUE(client_driver_->WaitForTabs(
+      {MakeTab(1, "One"), MakeTab(3, "Three (renamed)"), MakeTab(50, "Elsewhere")}));
+}
+
+TEST_F(IntegrationTest, TabMovesReorderClientTabs) {
+  const char* snapshot = R"json({
+        "event": "Extension::WS::AllTabsInfoResponse",
+        "data": {
+            "tabs": [
+                { "id": 1, "title": "One", "windowId": 7, "index": 0 },
+                { "id": 2, "title": "Two", "windowId": 7, "index": 1 },
+                { "id": 3, "title": "Three", "windowId": 7, "index": 2 }
+            ],
+            "groups": []
+        }
+    })json";
+  engine_handle_event(ec_, EVENT_WS_MESSAGE_RECEIVED, (void*)snapshot, nullptr);
+  ASSERT_TRUE(client_driver_->WaitForTabs(
+      ::testing::ElementsAre(MakeTab(1, "One"), MakeTab(2, "Two"), MakeTab(3, "Three"))));
+
+  const char* move = R"json({
+        "event": "Extension::WS::TabMoved",
+        "data": { "tabId": 3, "moveInfo": { "windowId": 7, "fromIndex": 2, "toIndex": 0 } }
+    })json";
+  engine_handle_event(ec_, EVENT_WS_MESSAGE_RECEIVED, (void*)move, nullptr);
+  ASSERT_TRUE(client_driver_->WaitForTabs(
+      ::testing::ElementsAre(MakeTab(3, "Three"), MakeTab(1, "One"), MakeTab(2, "Two"))));
+
+  // Dragging tab 1 into a new window: detach, then attach.
+  const char* detach = R"json({
+        "event": "Extension::WS::TabDetached",
+        "data": { "tabId": 1, "detachInfo": { "oldWindowId": 7, "oldPosition": 1 } }
+    })json";
+  const char* attach = R"json({
+        "event": "Extension::WS::TabAttached",
+        "data": { "tabId": 1, "attachInfo": { "newWindowId": 8, "newPosition": 0 } }
+    })json";
+  const char* created = R"json({
+        "event": "Extension::WS::TabCreated",
+        "data": { "id": 4, "title": "Four", "windowId": 7, "index": 1 }
+    })json";
+  engine_handle_event(ec_, EVENT_WS_MESSAGE_RECEIVED, (void*)detach, nullptr);
+  engine_handle_event(ec_, EVENT_WS_MESSAGE_RECEIVED, (void*)attach, nullptr);
+  engine_handle_event(ec_, EVENT_WS_MESSAGE_RECEIVED, (void*)created, nullptr);
+  ASSERT_TRUE(client_driver_->WaitForTabs(
+      ::testing::ElementsAre(MakeTab(3, "Three"), MakeTab(4, "Four"), MakeTab(2, "Two"), MakeTab(1, "One"))));
+}
+
 TEST_F(IntegrationTest, TabGroupsPropagateToClient) {
   const char* ws_msg = R"json({
         "event": "Extension::WS::AllTabsInfoResponse",
@@ -0,0 +1,245 @@
+// Measures AllTabsInfoResponse ingest throughput: cJSON's tree parse against the jscan pull scanner, and
+// the cost of an id-heavy CloseTabsRequest through doubles against the exact integer path (json_id.h).
+//
+//   meson test --benchmark jscan_bench jscan_bench_scalar
+//
+// jscan_bench uses the vector string scan the daemon ships with; jscan_bench_scalar is the same scanner
+// built with JSCAN_NO_SIMD. Messages are shaped like the extension's (see sendAllTabs/logEvent in
+// extension/background.js): JSON.stringify output, so no whitespace, non-ASCII left as raw UTF-8 and
+// only quotes, backslashes and control characters escaped. Every figure is GB/s of message text.
+
+#include "jscan.h"
+#include "json_id.h"
+
+#include <cJSON.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Prevents the compiler from discarding the decode loops.
+volatile uint64_t g_sink;
+
+const char* const kWords[] = {"Inbox",    "Pull",     "request", "Docs",   "Design", "review",  "Dashboard",
+                              "Calendar", "Übersicht", "設定",    "résumé", "build",  "failing", "—"};
+const char* const kHosts[] = {"github.com", "mail.google.com", "docs.google.com", "en.wikipedia.org",
+                              "stackoverflow.com", "news.ycombinator.com"};
+
+std::string Title(std::mt19937& rng) {
+  std::string title;
+  size_t words = 2 + rng() % 9;
+  for (size_t i = 0; i < words; ++i) {
+    if (i)
+      title += ' ';
+    title += kWords[rng() % (sizeof(kWords) / sizeof(kWords[0]))];
+  }
+  // Roughly one title in eight quotes something, as issue and search-result titles tend to.
+  if (rng() % 8 == 0)
+    title += " \\\"quoted\\\"";
+  return title;
+}
+
+std::string Url(std::mt19937& rng) {
+  std::string url = "https://";
+  url += kHosts[rng() % (sizeof(kHosts) / sizeof(kHosts[0]))];
+  url += "/";
+  size_t len = 20 + rng() % 120;
+  static const char kPath[] = "abcdefghijklmnopqrstuvwxyz0123456789/-_?=&";
+  for (size_t i = 0; i < len; ++i)
+    url += kPath[rng() % (sizeof(kPath) - 1)];
+  return url;
+}
+
+std::string AllTabsMessage(size_t n) {
+  std::mt19937 rng(42);
+  const size_t groups = n / 20 + 1;
+  std::string msg =
+      R"({"event":"Extension::WS::AllTabsInfoResponse","timestamp":"2026-01-01T00:00:00.000Z")"
+      R"(,"data":{"tabs":[)";
+  for (size_t i = 0; i < n; ++i) {
+    char head[160];
+    snprintf(head, sizeof(head), R"(%s{"title":")", i ? "," : "");
+    msg += head;
+    msg += Title(rng);
+    snprintf(head, sizeof(head), R"(","id":%zu,"windowId":%zu,"index":%zu,"url":")", 1000000 + i, 1 + i / 200,
+             i % 200);
+    msg += head;
+    msg += Url(rng);
+    long group = rng() % 3 ? -1 : (long)(rng() % groups);
+    snprintf(head, sizeof(head), R"(","active":%s,"groupId":%ld,"browserId":"c0ffee00-1234-4cde-8f00-00000000beef"})",
+             i % 200 ? "false" : "true", group);
+    msg += head;
+  }
+  msg += R"(],"groups":[)";
+  for (size_t g = 0; g < groups; ++g) {
+    char item[128];
+    snprintf(item, sizeof(item), R"(%s{"id":%zu,"title":"Task %zu","color":"blue","collapsed":false})",
+             g ? "," : "", g, g);
+    msg += item;
+  }
+  msg += R"(]},"activeTabIds":[1000000],"browserId":"c0ffee00-1234-4cde-8f00-00000000beef"})";
+  return msg;
+}
+
+// What the engine's stream path does per tab: pick the fields out and copy the title unescaped.
+uint64_t DecodeTabs(const std::string& msg, char* title, size_t title_cap) {
+  JScan js;
+  JScanStr key, s;
+  double num;
+  uint64_t sum = 0;
+  jscan_init(&js, msg.data(), msg.size());
+  jscan_object_begin(&js);
+  while (jscan_object_next(&js, &key)) {
+    if (!jscan_key_is(&key, "data")) {
+      jscan_skip(&js);
+      continue;
+    }
+    jscan_object_begin(&js);
+    while (jscan_object_next(&js, &key)) {
+      if (!jscan_key_is(&key, "tabs")) {
+        jscan_skip(&js);
+        continue;
+      }
+      jscan_array_begin(&js);
+      while (jscan_array_next(&js)) {
+        jscan_object_begin(&js);
+        while (jscan_object_next(&js, &key)) {
+          if (jscan_key_is(&key, "title") && jscan_string(&js, &s)) {
+            sum += jscan_unescape(&s, title, title_cap);
+          } else if ((jscan_key_is(&key, "id") || jscan_key_is(&key, "windowId")) && jscan_number(&js, &num)) {
+            sum += (uint64_t)num;
+          } else {
+            jscan_skip(&js);
+          }
+        }
+      }
+    }
+  }
+  return js.error ? 0 : sum;
+}
+
+template <typename F>
+double GbPerSec(const std::string& msg, int rounds, F&& f) {
+  f();  // Warm caches and the allocator.
+  auto start = Clock::now();
+  for (int i = 0; i < rounds; ++i)
+    f();
+  double secs = std::chrono::duration<double>(Clock::now() - start).count();
+  return (double)msg.size() * rounds / secs / 1e9;
+}
+
+void RunScenario(size_t n) {
+  const std::string msg = AllTabsMessage(n);
+  const int rounds = (int)(200000000 / msg.size()) + 1;
+  std::vector<char> title(msg.size() + 1);
+
+  double cjson = GbPerSec(msg, rounds, [&] {
+    cJSON* root = cJSON_ParseWithLength(msg.data(), msg.size());
+    g_sink = g_sink + (root != nullptr);
+    cJSON_Delete(root);
+  });
+  double walk = GbPerSec(msg, rounds, [&] {
+    JScan js;
+    jscan_init(&js, msg.data(), msg.size());
+    g_sink = g_sink + (uint64_t)jscan_skip(&js);
+  });
+  double decode = GbPerSec(msg, rounds, [&] { g_sink = g_sink + DecodeTabs(msg, title.data(), title.size()); });
+
+  printf("%7zu tabs %9zu bytes | cJSON parse %6.3f GB/s | jscan walk %6.3f GB/s | jscan decode %6.3f GB/s\n", n,
+         msg.size(), cjson, walk, decode);
+}
+
+// Ids past 2^32, like the extension's on long-running profiles.
+std::vector<int64_t> TabIds(size_t n) {
+  std::vector<int64_t> ids(n);
+  for (size_t i = 0; i < n; ++i)
+    ids[i] = 4294967296 + 7919 * (int64_t)i;
+  return ids;
+}
+
+std::string CloseTabsMessage(const std::vector<int64_t>& ids, bool exact) {
+  cJSON* root = cJSON_CreateObject();
+  cJSON_AddStringToObject(root, "event", "Daemon::WS::CloseTabsRequest");
+  cJSON* data = cJSON_AddObjectToObject(root, "data");
+  cJSON* arr = cJSON_AddArrayToObject(data, "tabIds");
+  for (int64_t id : ids)
+    cJSON_AddItemToArray(arr, exact ? json_id_create(id) : cJSON_CreateNumber((double)id));
+  char* text = cJSON_PrintUnformatted(root);
+  std::string msg = text;
+  cJSON_free(text);
+  cJSON_Delete(root);
+  return msg;
+}
+
+uint64_t DecodeIds(const std::string& msg) {
+  JScan js;
+  JScanStr key;
+  int64_t id;
+  uint64_t sum = 0;
+  jscan_init(&js, msg.data(), msg.size());
+  jscan_object_begin(&js);
+  while (jscan_object_next(&js, &key)) {
+    if (!jscan_key_is(&key, "data")) {
+      jscan_skip(&js);
+      continue;
+    }
+    jscan_object_begin(&js);
+    while (jscan_object_next(&js, &key)) {
+      if (!jscan_key_is(&key, "tabIds")) {
+        jscan_skip(&js);
+        continue;
+      }
+      jscan_array_begin(&js);
+      while (jscan_array_next(&js) && jscan_int64(&js, &id))
+        sum += (uint64_t)id;
+    }
+  }
+  return js.error ? 0 : sum;
+}
+
+template <typename F>
+double MicrosPerOp(int rounds, F&& f) {
+  f();
+  auto start = Clock::now();
+  for (int i = 0; i < rounds; ++i)
+    f();
+  return std::chrono::duration<double, std::micro>(Clock::now() - start).count() / rounds;
+}
+
+void RunIdScenario(size_t n) {
+  const std::vector<int64_t> ids = TabIds(n);
+  const std::string msg = CloseTabsMessage(ids, true);
+  const int rounds = (int)(20000000 / msg.size()) + 1;
+
+  double enc_double = MicrosPerOp(rounds, [&] { g_sink = g_sink + CloseTabsMessage(ids, false).size(); });
+  double enc_exact = MicrosPerOp(rounds, [&] { g_sink = g_sink + CloseTabsMessage(ids, true).size(); });
+  double dec_double = MicrosPerOp(rounds, [&] {
+    cJSON* root = cJSON_ParseWithLength(msg.data(), msg.size());
+    cJSON* arr = cJSON_GetObjectItem(cJSON_GetObjectItem(root, "data"), "tabIds");
+    const cJSON* item;
+    cJSON_ArrayForEach(item, arr) g_sink = g_sink + (uint64_t)item->valuedouble;
+    cJSON_Delete(root);
+  });
+  double dec_exact = MicrosPerOp(rounds, [&] { g_sink = g_sink + DecodeIds(msg); });
+
+  printf("%7zu ids  %9zu bytes | encode %%g %8.2f us | encode exact %8.2f us | decode cJSON %8.2f us | decode jscan "
+         "%8.2f us\n",
+         n, msg.size(), enc_double, enc_exact, dec_double, dec_exact);
+}
+
+}  // namespace
+
+int main() {
+  printf("jscan string scan: %s\n", jscan_backend());
+  for (size_t n : {100, 1000, 10000})
+    RunScenario(n);
+  for (size_t n : {10, 500})
+    RunIdScenario(n);
+  return 0;
+}
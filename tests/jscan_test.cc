@@ -0,0 +1,161 @@
+#include "jscan.h"
+#include "jnum.h"
+
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+JScan Scan(const char* text) {
+  JScan js;
+  jscan_init(&js, text, strlen(text));
+  return js;
+}
+
+std::string Unescape(const JScanStr& s) {
+  std::string out(s.len + 1, '\0');
+  out.resize(jscan_unescape(&s, out.data(), out.size()));
+  return out;
+}
+
+bool Skips(const char* text) {
+  JScan js = Scan(text);
+  return jscan_skip(&js) && jscan_peek(&js) == JSCAN_NONE && !js.error;
+}
+
+}  // namespace
+
+TEST(JScanTest, WalksObjectsAndArrays) {
+  JScan js = Scan(R"( {"id": 12, "title": "Tab", "flags": [true, false, null], "pos": {"x": -1.5e1}} )");
+  JScanStr key;
+  double id = 0, x = 0;
+  std::string title;
+  std::vector<JScanType> flags;
+  ASSERT_TRUE(jscan_object_begin(&js));
+  while (jscan_object_next(&js, &key)) {
+    if (jscan_key_is(&key, "id")) {
+      ASSERT_TRUE(jscan_number(&js, &id));
+    } else if (jscan_key_is(&key, "title")) {
+      JScanStr s;
+      ASSERT_TRUE(jscan_string(&js, &s));
+      title = Unescape(s);
+    } else if (jscan_key_is(&key, "flags")) {
+      ASSERT_TRUE(jscan_array_begin(&js));
+      while (jscan_array_next(&js)) {
+        flags.push_back(jscan_peek(&js));
+        ASSERT_TRUE(jscan_skip(&js));
+      }
+    } else if (jscan_key_is(&key, "pos")) {
+      ASSERT_TRUE(jscan_object_begin(&js));
+      ASSERT_TRUE(jscan_object_next(&js, &key));
+      ASSERT_TRUE(jscan_number(&js, &x));
+      EXPECT_FALSE(jscan_object_next(&js, &key));
+    } else {
+      ADD_FAILURE() << "unexpected key";
+      jscan_skip(&js);
+    }
+  }
+  EXPECT_FALSE(js.error);
+  EXPECT_EQ(jscan_peek(&js), JSCAN_NONE);
+  EXPECT_EQ(id, 12);
+  EXPECT_EQ(x, -15);
+  EXPECT_EQ(title, "Tab");
+  EXPECT_EQ(flags, (std::vector<JScanType>{JSCAN_TRUE, JSCAN_FALSE, JSCAN_NULL}));
+}
+
+TEST(JScanTest, UnescapesStrings) {
+  JScan js = Scan(R"("a\"b\\c\/d\n\té€😀")");
+  JScanStr s;
+  ASSERT_TRUE(jscan_string(&js, &s));
+  EXPECT_TRUE(s.escaped);
+  EXPECT_EQ(Unescape(s), "a\"b\\c/d\n\t\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80");
+
+  // Truncation never splits the output buffer's terminator off.
+  char small[4];
+  EXPECT_EQ(jscan_unescape(&s, small, sizeof(small)), 3u);
+  EXPECT_STREQ(small, "a\"b");
+}
+
+TEST(JScanTest, ParsesNumbers) {
+  for (auto [text, value] : std::vector<std::pair<const char*, double>>{
+           {"0", 0}, {"-7", -7}, {"1234567890123", 1234567890123.0}, {"2.5", 2.5}, {"1e3", 1000}, {"-0.25E+1", -2.5}}) {
+    JScan js = Scan(text);
+    double d = 0;
+    EXPECT_TRUE(jscan_number(&js, &d)) << text;
+    EXPECT_EQ(d, value) << text;
+  }
+}
+
+TEST(JScanTest, ParsesIdsExactly) {
+  for (auto [text, value] : std::vector<std::pair<const char*, int64_t>>{
+           {"0", 0},
+           {"-7", -7},
+           {"9007199254740993", 9007199254740993},  // 2^53 + 1, which a double rounds.
+           {"9223372036854775807", INT64_MAX},
+           {"-9223372036854775808", INT64_MIN}}) {
+    JScan js = Scan(text);
+    int64_t id = 0;
+    EXPECT_TRUE(jscan_int64(&js, &id)) << text;
+    EXPECT_EQ(id, value) << text;
+
+    char buf[JNUM_INT64_LEN];
+    EXPECT_EQ(std::string(buf, jnum_format_int64(value, buf)), text);
+  }
+  // Not integers, or out of range: jnum rejects them and jscan_int64() falls back to the double.
+  for (const char* text : {"01", "1.5", "1e3", "9223372036854775808", "-"}) {
+    int64_t id;
+    EXPECT_EQ(jnum_parse_int64(text, text + strlen(text), &id), 0u) << text;
+  }
+  JScan js = Scan("[12.75, 1e3]");
+  int64_t id = 0;
+  ASSERT_TRUE(jscan_array_begin(&js) && jscan_array_next(&js));
+  EXPECT_TRUE(jscan_int64(&js, &id));
+  EXPECT_EQ(id, 12);
+  ASSERT_TRUE(jscan_array_next(&js));
+  EXPECT_TRUE(jscan_int64(&js, &id));
+  EXPECT_EQ(id, 1000);
+}
+
+TEST(JScanTest, RejectsMalformedText) {
+  EXPECT_TRUE(Skips(R"({"a": [1, {"b": []}, "c"], "d": {}})"));
+  EXPECT_TRUE(Skips("[]"));
+  for (const char* bad : {R"({"a": 1,})", "[1 2]", R"({"a" 1})", "[,1]", "[1,]", R"({"a": [})", "\"abc", "01", "-",
+                          "1.", "tru", R"({"a": "x)"}) {
+    EXPECT_FALSE(Skips(bad)) << bad;
+  }
+  std::string deep(300, '[');
+  EXPECT_FALSE(Skips(deep.c_str()));
+}
+
+TEST(JScanTest, FindsStringEndsAtEveryOffset) {
+  // Strings are searched in 16-byte blocks; put the byte that ends each run at every position of a few.
+  for (size_t n = 0; n < 40; ++n) {
+    const std::string body(n, 'x');
+    JScanStr s;
+
+    std::string plain = "\"" + body + "\"";
+    JScan js = Scan(plain.c_str());
+    ASSERT_TRUE(jscan_string(&js, &s)) << n;
+    EXPECT_EQ(s.len, n);
+    EXPECT_FALSE(s.escaped);
+
+    std::string escaped = "\"" + body + "\\\"" + body + "\"";
+    js = Scan(escaped.c_str());
+    ASSERT_TRUE(jscan_string(&js, &s)) << n;
+    EXPECT_TRUE(s.escaped);
+    EXPECT_EQ(Unescape(s), body + "\"" + body);
+    // Truncating inside either run keeps the prefix.
+    std::vector<char> small(n + 2);
+    EXPECT_EQ(jscan_unescape(&s, small.data(), small.size()), n + 1);
+    EXPECT_EQ(std::string(small.data()), body + "\"");
+
+    for (const std::string& bad : {"\"" + body + "\x01\"", "\"" + body, "\"" + body + "\\"}) {
+      js = Scan(bad.c_str());
+      EXPECT_FALSE(jscan_string(&js, &s)) << n;
+      EXPECT_TRUE(js.error);
+    }
+  }
+}
@@ -0,0 +1,170 @@
+#include "jwrite.h"
+#include "jscan.h"
+
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+namespace {
+
+std::string Json(JWrite* w) {
+  size_t len;
+  const char* text = jwrite_json(w, &len);
+  return std::string(text, len);
+}
+
+// The string value `text` holds, unescaped by the scanner.
+std::string ScanString(const std::string& text) {
+  JScan js;
+  jscan_init(&js, text.data(), text.size());
+  JScanStr s;
+  EXPECT_TRUE(jscan_string(&js, &s)) << text;
+  std::string out(s.len + 1, '\0');
+  out.resize(jscan_unescape(&s, out.data(), out.size()));
+  return out;
+}
+
+}  // namespace
+
+TEST(JWriteTest, WritesNestedValuesWithCommas) {
+  JWrite w;
+  jwrite_init(&w, 0);
+  jwrite_object_begin(&w);
+  jwrite_member_string(&w, "event", "Daemon::UDS::TabsUpdate");
+  jwrite_key(&w, "data");
+  jwrite_object_begin(&w);
+  jwrite_key(&w, "tabs");
+  jwrite_array_begin(&w);
+  for (int i = 1; i <= 2; ++i) {
+    jwrite_object_begin(&w);
+    jwrite_member_int64(&w, "id", i);
+    jwrite_member_bool(&w, "active", i == 1);
+    jwrite_object_end(&w);
+  }
+  jwrite_array_end(&w);
+  jwrite_key(&w, "empty");
+  jwrite_array_begin(&w);
+  jwrite_array_end(&w);
+  jwrite_key(&w, "none");
+  jwrite_null(&w);
+  jwrite_object_end(&w);
+  jwrite_object_end(&w);
+  EXPECT_FALSE(w.error);
+  EXPECT_EQ(Json(&w), R"({"event":"Daemon::UDS::TabsUpdate","data":{"tabs":[{"id":1,"active":true},)"
+                      R"({"id":2,"active":false}],"empty":[],"none":null}})");
+  jwrite_free(&w);
+}
+
+TEST(JWriteTest, WritesIdsExactly) {
+  JWrite w;
+  jwrite_init(&w, 0);
+  jwrite_array_begin(&w);
+  jwrite_int64(&w, 0);
+  jwrite_int64(&w, 9007199254740993);
+  jwrite_int64(&w, INT64_MIN);
+  jwrite_int64(&w, INT64_MAX);
+  jwrite_array_end(&w);
+  EXPECT_EQ(Json(&w), "[0,9007199254740993,-9223372036854775808,9223372036854775807]");
+  jwrite_free(&w);
+}
+
+TEST(JWriteTest, EscapesStrings) {
+  JWrite w;
+  jwrite_init(&w, 0);
+  jwrite_string(&w, "a \"quoted\" \\ tab\t\n\x01 caf\xc3\xa9");
+  EXPECT_EQ(Json(&w), "\"a \\\"quoted\\\" \\\\ tab\\t\\n\\u0001 caf\xc3\xa9\"");
+  jwrite_free(&w);
+}
+
+TEST(JWriteTest, EscapedStringsScanBackAtEveryOffset) {
+  // Each byte that needs escaping, at every position around the word-at-a-time runs.
+  const char specials[] = {'"', '\\', '\n', '\x1f', '\x7f', '\0'};
+  JWrite w;
+  jwrite_init(&w, 0);
+  for (char special : specials) {
+    for (size_t len = 1; len <= 40; ++len) {
+      for (size_t at = 0; at < len; ++at) {
+        std::string s(len, 'x');
+        s[at] = special;
+        jwrite_reset(&w);
+        jwrite_string_len(&w, s.data(), s.size());
+        ASSERT_EQ(ScanString(Json(&w)), s) << "len " << len << " at " << at;
+      }
+    }
+  }
+  jwrite_free(&w);
+}
+
+TEST(JWriteTest, FrameCarriesPayloadLength) {
+  JWrite w;
+  jwrite_init(&w, JWRITE_FRAME_HEAD);
+  jwrite_object_begin(&w);
+  jwrite_member_string(&w, "event", "GUI::UDS::TabSelected");
+  jwrite_object_end(&w);
+  size_t len;
+  const char* frame = jwrite_frame(&w, &len);
+  ASSERT_NE(frame, nullptr);
+  const char* json = R"({"event":"GUI::UDS::TabSelected"})";
+  ASSERT_EQ(len, JWRITE_FRAME_HEAD + strlen(json));
+  const unsigned char* header = (const unsigned char*)frame;
+  EXPECT_EQ(header[0] | header[1] << 8 | header[2] << 16 | header[3] << 24, (int)strlen(json));
+  EXPECT_EQ(std::string(frame + JWRITE_FRAME_HEAD, len - JWRITE_FRAME_HEAD), json);
+  jwrite_free(&w);
+}
+
+TEST(JWriteTest, ResetKeepsTheBuffer) {
+  JWrite w;
+  jwrite_init(&w, JWRITE_FRAME_HEAD);
+  std::string title(1000, 't');
+  jwrite_string(&w, title.c_str());
+  char* buf = w.buf;
+  size_t cap = w.cap;
+  jwrite_reset(&w);
+  jwrite_string(&w, "short");
+  EXPECT_EQ(w.buf, buf);
+  EXPECT_EQ(w.cap, cap);
+  EXPECT_EQ(Json(&w), "\"short\"");
+  jwrite_free(&w);
+}
+
+TEST(JWriteTest, RawMembersJoinAnObject) {
+  JWrite members;
+  jwrite_init(&members, 0);
+  jwrite_member_int64(&members, "requestId", 7);
+  jwrite_member_string(&members, "title", "Work");
+
+  JWrite w;
+  jwrite_init(&w, 0);
+  jwrite_object_begin(&w);
+  size_t len;
+  const char* text = jwrite_json(&members, &len);
+  jwrite_raw(&w, text, len);
+  jwrite_key(&w, "tabIds");
+  jwrite_array_begin(&w);
+  jwrite_int64(&w, 3);
+  jwrite_array_end(&w);
+  jwrite_object_end(&w);
+  EXPECT_EQ(Json(&w), R"({"requestId":7,"title":"Work","tabIds":[3]})");
+  jwrite_free(&w);
+  jwrite_free(&members);
+}
+
+TEST(JWriteTest, TakeHandsOverTheBuffer) {
+  JWrite w;
+  jwrite_init(&w, 16);
+  jwrite_string(&w, "queued");
+  size_t len;
+  char* buf = jwrite_take(&w, &len);
+  ASSERT_NE(buf, nullptr);
+  EXPECT_EQ(len, 8u);
+  EXPECT_STREQ(buf + 16, "\"queued\"");
+  EXPECT_EQ(w.buf, nullptr);
+  EXPECT_EQ(w.len, 16u);
+  free(buf);
+
+  jwrite_null(&w);
+  EXPECT_EQ(Json(&w), "null");
+  jwrite_free(&w);
+}
@@ -0,0 +1,201 @@
+// Compares the structure-of-arrays tab store against the malloc'd linked list it replaced.
+//
+//   meson test --benchmark tab_store_bench
+//
+// Each scenario runs at 1k/10k/100k tabs; costs are per tab walked, per active-set event, per add/remove or
+// per tab moved within its window.
+
+#include "engine.h"
+
+#include <cJSON.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// Mirror of the previous TabState layout: one heap node per tab, chained through `next`, with an id
+// index on the side (as the engine had before the tab store landed).
+struct LegacyTab {
+  uint64_t id;
+  char* title;
+  int active;
+  int64_t task_ext_id;
+  char* browser_id;
+  LegacyTab* next;
+};
+
+struct LegacyTabList {
+  LegacyTab* tabs = nullptr;
+  std::unordered_map<uint64_t, LegacyTab*> index;
+
+  ~LegacyTabList() {
+    while (tabs) {
+      LegacyTab* next = tabs->next;
+      free(tabs->title);
+      free(tabs->browser_id);
+      free(tabs);
+      tabs = next;
+    }
+  }
+
+  void Add(const char* title, uint64_t id, int64_t task_id) {
+    LegacyTab* t = static_cast<LegacyTab*>(calloc(1, sizeof(LegacyTab)));
+    t->id = id;
+    t->title = strdup(title);
+    t->task_ext_id = task_id;
+    t->next = tabs;
+    tabs = t;
+    index[id] = t;
+  }
+
+  void Remove(uint64_t id) {
+    auto it = index.find(id);
+    if (it == index.end())
+      return;
+    LegacyTab** link = &tabs;
+    while (*link != it->second)
+      link = &(*link)->next;
+    *link = it->second->next;
+    free(it->second->title);
+    free(it->second);
+    index.erase(it);
+  }
+};
+
+using Clock = std::chrono::steady_clock;
+
+double NsPer(Clock::time_point start, size_t ops) {
+  return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (double)ops;
+}
+
+// Prevents the compiler from discarding the iteration loops.
+volatile uint64_t g_sink;
+
+constexpr int kRounds = 20;
+
+void RunScenario(size_t n) {
+  std::mt19937_64 rng(n);
+  std::vector<uint64_t> ids(n);
+  for (size_t i = 0; i < n; ++i)
+    ids[i] = 1000 + i * 3;
+
+  LegacyTabList legacy;
+  TabState* store = tab_state_alloc();
+  for (size_t i = 0; i < n; ++i) {
+    legacy.Add("Some tab title", ids[i], (int64_t)(i % 16));
+    tab_state_add_tab(store, "Some tab title", ids[i], (int64_t)(i % 16), NULL);
+  }
+
+  // Iteration: the walk performed by every TabsUpdate snapshot.
+  auto start = Clock::now();
+  for (int r = 0; r < kRounds; ++r) {
+    uint64_t acc = 0;
+    for (LegacyTab* t = legacy.tabs; t; t = t->next)
+      acc += t->id + (uint64_t)t->task_ext_id + (uint64_t)t->active;
+    g_sink = acc;
+  }
+  double legacy_iter = NsPer(start, n * kRounds);
+
+  start = Clock::now();
+  for (int r = 0; r < kRounds; ++r) {
+    uint64_t acc = 0;
+    for (uint32_t slot = 0; slot < store->nb_slots; ++slot) {
+      if (store->flags[slot] & TAB_FLAG_LIVE)
+        acc += store->ids[slot] + (uint64_t)store->task_ids[slot] + (uint64_t)(store->flags[slot] & TAB_FLAG_ACTIVE);
+    }
+    g_sink = acc;
+  }
+  double store_iter = NsPer(start, n * kRounds);
+
+  // Active update: every extension event carries the active tab of each window (4 here); one of them
+  // changes per event. The legacy path copied the ids and ran the tab x id nested loop.
+  std::vector<cJSON*> events;
+  for (int r = 0; r < kRounds; ++r) {
+    std::string active = "{\"activeTabIds\": [";
+    for (int w = 0; w < 4; ++w)
+      active += (w ? "," : "") + std::to_string(w == 0 ? ids[rng() % n] : ids[w]);
+    events.push_back(cJSON_Parse((active + "]}").c_str()));
+  }
+  start = Clock::now();
+  for (cJSON* event : events) {
+    uint64_t active_ids[64];
+    int active_count = 0;
+    cJSON* item = NULL;
+    cJSON_ArrayForEach(item, cJSON_GetObjectItem(event, "activeTabIds")) {
+      if (active_count < 64)
+        active_ids[active_count++] = (uint64_t)item->valuedouble;
+    }
+    for (LegacyTab* t = legacy.tabs; t; t = t->next) {
+      t->active = 0;
+      for (int i = 0; i < active_count; i++) {
+        if (t->id == active_ids[i]) {
+          t->active = 1;
+          break;
+        }
+      }
+    }
+  }
+  double legacy_active = NsPer(start, kRounds);
+
+  start = Clock::now();
+  for (cJSON* event : events)
+    tab_state_update_active(store, event, nullptr);
+  double store_active = NsPer(start, kRounds);
+  for (cJSON* event : events)
+    cJSON_Delete(event);
+
+  // Churn: close and reopen a random tenth of the tabs, as a session restore or window close does.
+  const size_t churn = n / 10;
+  std::vector<uint64_t> victims(churn);
+  for (size_t i = 0; i < churn; ++i)
+    victims[i] = ids[rng() % n];
+
+  start = Clock::now();
+  for (uint64_t id : victims)
+    legacy.Remove(id);
+  for (uint64_t id : victims)
+    if (!legacy.index.count(id))
+      legacy.Add("Reopened tab", id, -1);
+  double legacy_churn = NsPer(start, churn * 2);
+
+  start = Clock::now();
+  for (uint64_t id : victims)
+    tab_state_remove_tab(store, id, NULL);
+  for (uint64_t id : victims)
+    tab_state_add_tab(store, "Reopened tab", id, -1, NULL);
+  double store_churn = NsPer(start, churn * 2);
+
+  // Move: drag a random tab to a random position of its window (the list had no notion of order).
+  std::vector<TabHandle> handles;
+  for (uint64_t id : ids)
+    handles.push_back(tab_state_find_tab(store, id));
+  for (size_t i = 0; i < n; ++i)
+    tab_state_place_tab(store, handles[i], 1, (uint32_t)i);
+  const size_t moves = 10000;
+  start = Clock::now();
+  for (size_t i = 0; i < moves; ++i)
+    tab_state_place_tab(store, handles[rng() % n], 1, (uint32_t)(rng() % n));
+  double store_move = NsPer(start, moves);
+
+  printf("%7zu tabs | iterate %8.2f -> %6.2f ns/tab | active %10.2f -> %6.2f ns/event | churn %10.2f -> %6.2f ns/op"
+         " | move %6.2f ns/op\n",
+         n, legacy_iter, store_iter, legacy_active, store_active, legacy_churn, store_churn, store_move);
+
+  tab_state_free(store);
+}
+
+}  // namespace
+
+int main() {
+  engine_set_log_level(LOG_LEVEL_ERROR);
+  printf("legacy list -> tab store\n");
+  for (size_t n : {1000, 10000, 100000})
+    RunScenario(n);
+  return 0;
+}
@@ -85,7 +85,7 @@ std::vector<std::string> TestWebSocketClient::GetReceivedMessages() {
   return msgs;
 }
 
-bool TestWebSocketClient::WaitForEvent(const std::string& event_type, int timeout_ms) {
+bool TestWebSocketClient::WaitForEvent(const std::string& event_type, int timeout_ms, std::string* out_msg) {
   int waited = 0;
   while (waited < timeout_ms) {
     {
@@ -102,6 +102,8 @@ bool TestWebSocketClient::WaitForEvent(const std::string& event_type, int timeou
         }
 
         if (match) {
+          if (out_msg)
+            *out_msg = *it;
           received_msgs_.erase(it);
           return true;
         } else {
@@ -23,7 +23,7 @@ class TestWebSocketClient {
   void Disconnect();
   void Send(const std::string& msg);
   std::vector<std::string> GetReceivedMessages();
-  bool WaitForEvent(const std::string& event_type, int timeout_ms);
+  bool WaitForEvent(const std::string& event_type, int timeout_ms, std::string* out_msg = nullptr);
   bool IsConnected() const;
 
  private:
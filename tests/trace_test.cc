@@ -0,0 +1,111 @@
+#include "trace.h"
+
+#include <gtest/gtest.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Dump {
+  TraceFileHeader header;
+  std::vector<TraceEvent> events;
+};
+
+bool ReadDump(const std::string& path, Dump* out) {
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f)
+    return false;
+  bool ok = fread(&out->header, sizeof(out->header), 1, f) == 1;
+  if (ok) {
+    out->events.resize(out->header.nb_events);
+    ok = fread(out->events.data(), sizeof(TraceEvent), out->events.size(), f) == out->events.size();
+  }
+  fclose(f);
+  return ok;
+}
+
+std::string DumpPath(const char* name) {
+  return testing::TempDir() + name;
+}
+
+}  // namespace
+
+TEST(TraceTest, DumpHoldsEventsOldestFirst) {
+  for (uint32_t i = 0; i < 10; ++i)
+    trace_record(TRACE_WS_RECEIVED, 1000 + i);
+  std::string path = DumpPath("trace_order.bin");
+  ASSERT_EQ(trace_dump(path.c_str()), 0);
+
+  Dump dump;
+  ASSERT_TRUE(ReadDump(path, &dump));
+  EXPECT_EQ(memcmp(dump.header.magic, TRACE_FILE_MAGIC, sizeof(dump.header.magic)), 0);
+  EXPECT_EQ(dump.header.version, (uint32_t)TRACE_FILE_VERSION);
+  EXPECT_EQ(dump.header.event_size, sizeof(TraceEvent));
+  ASSERT_GE(dump.events.size(), 10u);
+
+  const TraceEvent* last = &dump.events[dump.events.size() - 10];
+  for (uint32_t i = 0; i < 10; ++i) {
+    EXPECT_EQ(last[i].kind, TRACE_WS_RECEIVED);
+    EXPECT_EQ(last[i].arg, 1000 + i);
+    EXPECT_NE(last[i].thread, 0);
+    if (i) {
+      EXPECT_GE(last[i].ticks, last[i - 1].ticks);
+    }
+  }
+  remove(path.c_str());
+}
+
+TEST(TraceTest, DumpKeepsTheLatestRingfulAfterWrapping) {
+  for (uint32_t i = 0; i < TRACE_RING_EVENTS + 100; ++i)
+    trace_record(TRACE_UDS_SENT, i);
+  std::string path = DumpPath("trace_wrap.bin");
+  ASSERT_EQ(trace_dump(path.c_str()), 0);
+
+  Dump dump;
+  ASSERT_TRUE(ReadDump(path, &dump));
+  EXPECT_GT(dump.header.nb_recorded, (uint64_t)TRACE_RING_EVENTS);
+  ASSERT_EQ(dump.events.size(), (size_t)TRACE_RING_EVENTS);
+  for (uint32_t i = 0; i < TRACE_RING_EVENTS; ++i)
+    ASSERT_EQ(dump.events[i].arg, 100 + i) << i;
+  remove(path.c_str());
+}
+
+TEST(TraceTest, ThreadsAreNumberedApart) {
+  trace_record(TRACE_HOTKEY_TOGGLE, 1);
+  std::thread other([] { trace_record(TRACE_HOTKEY_TOGGLE, 2); });
+  other.join();
+  std::string path = DumpPath("trace_threads.bin");
+  ASSERT_EQ(trace_dump(path.c_str()), 0);
+
+  Dump dump;
+  ASSERT_TRUE(ReadDump(path, &dump));
+  ASSERT_GE(dump.events.size(), 2u);
+  const TraceEvent& a = dump.events[dump.events.size() - 2];
+  const TraceEvent& b = dump.events[dump.events.size() - 1];
+  EXPECT_EQ(a.arg, 1u);
+  EXPECT_EQ(b.arg, 2u);
+  EXPECT_NE(a.thread, b.thread);
+  remove(path.c_str());
+}
+
+TEST(TraceTest, Sigusr1DumpsToTheSetPath) {
+  std::string path = DumpPath("trace_signal.bin");
+  remove(path.c_str());
+  trace_set_dump_path(path.c_str());
+  trace_install_handlers();
+  trace_record(TRACE_GUI_RECEIVED, 7);
+  ASSERT_EQ(raise(SIGUSR1), 0);
+
+  Dump dump;
+  ASSERT_TRUE(ReadDump(path, &dump));
+  ASSERT_FALSE(dump.events.empty());
+  EXPECT_EQ(dump.events.back().kind, TRACE_GUI_RECEIVED);
+  EXPECT_EQ(dump.events.back().arg, 7u);
+  trace_set_dump_path(nullptr);
+  remove(path.c_str());
+}